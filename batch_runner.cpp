@@ -0,0 +1,332 @@
+#include <unistd.h>
+
+#include <cerrno>
+
+#include <QMetaEnum>
+#include <QDebug>
+
+#include "protocol.h"
+#include "batch_runner.h"
+
+namespace Modbus_Cli {
+
+Batch_Runner::Batch_Runner(const QString &conn_string, const Job &job, const QString &file_name, QObject *parent) :
+    QObject(parent),
+    _job(job),
+    _file_name(file_name),
+    _client(make_client(conn_string, job)),
+    _eof(false),
+    _line_number(0),
+    _next_seq(0),
+    _next_output(0),
+    _finished(false)
+{
+    _client->set_print_values(false);
+    _client->set_image(job._image);
+
+    connect(_client.get(), &Client::connected, this, &Batch_Runner::on_connected);
+    connect(_client.get(), &Client::data_received, this, &Batch_Runner::data_received);
+    connect(_client.get(), &Client::request_failed, this, &Batch_Runner::request_failed);
+    connect(_client.get(), &Client::finished, this, &Batch_Runner::request_finished);
+}
+
+bool Batch_Runner::start()
+{
+    bool opened;
+    if (_file_name == "-")
+        opened = _input.open(stdin, QIODevice::ReadOnly);
+    else
+    {
+        _input.setFileName(_file_name);
+        opened = _input.open(QIODevice::ReadOnly);
+    }
+
+    if (!opened)
+    {
+        qCritical().noquote() << "Can't open batch file" << _file_name << _input.errorString();
+        return false;
+    }
+
+    if (!_output.open(stdout, QIODevice::WriteOnly))
+    {
+        qCritical().noquote() << "Can't open stdout" << _output.errorString();
+        return false;
+    }
+
+    // Commands are read while connecting, they wait in the queue
+    _notifier.reset(new QSocketNotifier{_input.handle(), QSocketNotifier::Read});
+    connect(_notifier.get(), &QSocketNotifier::activated, this, &Batch_Runner::read_input);
+
+    _client->connect_device();
+    return true;
+}
+
+void Batch_Runner::on_connected()
+{
+    dispatch();
+}
+
+void Batch_Runner::read_input()
+{
+    // Not QFile::read(), it waits for the whole buffer on a pipe
+    char buffer[65536];
+    const ssize_t size = ::read(_input.handle(), buffer, sizeof(buffer));
+    if (size < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+
+    if (size <= 0)
+    {
+        _eof = true;
+        _notifier->setEnabled(false);
+        if (!_input_buffer.isEmpty())
+            parse_line(QString::fromUtf8(_input_buffer));
+        _input_buffer.clear();
+    }
+    else
+    {
+        _input_buffer.append(buffer, static_cast<int>(size));
+
+        int pos = 0;
+        for (int end = _input_buffer.indexOf('\n'); end != -1; end = _input_buffer.indexOf('\n', pos))
+        {
+            parse_line(QString::fromUtf8(_input_buffer.constData() + pos, end - pos));
+            pos = end + 1;
+        }
+        _input_buffer.remove(0, pos);
+
+        if (_waiting.size() >= max_backlog)
+            _notifier->setEnabled(false);
+    }
+
+    dispatch();
+    check_done();
+}
+
+void Batch_Runner::data_received(const Request &request, const QModbusDataUnit &unit, const QModbusResponse &response)
+{
+    if (!_in_flight.contains(request._id))
+        return;
+
+    const Command command = _in_flight.take(request._id);
+    QString text = QString("%1 ok").arg(command._line);
+    switch (request._kind)
+    {
+    case Request::READ:
+    case Request::READ_WRITE:
+    {
+        QStringList values;
+        for (quint16 value: unit.values())
+            values.push_back(QString::number(value));
+        text += " " + values.join(',');
+        break;
+    }
+    case Request::RAW:
+    {
+        QByteArray pdu;
+        pdu.append(static_cast<char>(response.functionCode()));
+        pdu.append(response.data());
+        text += " " + QString::fromLatin1(pdu.toHex());
+        break;
+    }
+    case Request::WRITE:
+        break;
+    }
+    add_result(command._seq, text);
+}
+
+void Batch_Runner::request_failed(const Request &request, QModbusDevice::Error error)
+{
+    if (!_in_flight.contains(request._id))
+        return;
+
+    const Command command = _in_flight.take(request._id);
+    add_result(command._seq, QString("%1 error %2").arg(command._line)
+               .arg(QMetaEnum::fromType<QModbusDevice::Error>().valueToKey(error)));
+}
+
+void Batch_Runner::request_finished()
+{
+    if (!_client->is_connected() && _client->pending_count() == 0)
+        fail_waiting("ConnectionError"); // Next command read reconnects
+    else
+        dispatch();
+    check_done();
+}
+
+void Batch_Runner::parse_line(const QString &line)
+{
+    ++_line_number;
+    const QString text = line.left(line.indexOf('#')).simplified();
+    if (text.isEmpty())
+        return;
+
+    Command command{_next_seq++, _line_number, Request::read(1, QModbusDataUnit::HoldingRegisters, 0, 0)};
+    QString error;
+    if (!parse_command(text.split(' '), command._request, error))
+    {
+        add_result(command._seq, QString("%1 error %2").arg(_line_number).arg(error));
+        return;
+    }
+
+    command._request._id = command._seq;
+    _waiting.enqueue(command);
+}
+
+/*static*/ bool Batch_Runner::parse_command(const QStringList &fields, Request &request, QString &error)
+{
+    const QString op = fields.at(0).toLower();
+    bool ok = fields.size() >= 3;
+    const int address = ok ? fields.at(1).toInt(&ok) : 0;
+    if (!ok || address < 0 || address > 255)
+    {
+        error = "bad address";
+        return false;
+    }
+
+    if (op == "raw")
+    {
+        const int func = fields.at(2).toInt(&ok, 16);
+        if (!ok || fields.size() > 4 || func <= 0 || func >= 0x80)
+        {
+            error = "bad raw command";
+            return false;
+        }
+        const QByteArray data = fields.size() == 4 ? QByteArray::fromHex(fields.at(3).toLatin1()) : QByteArray();
+        request = Request::raw(address, static_cast<QModbusPdu::FunctionCode>(func), data);
+        return true;
+    }
+
+    const QModbusDataUnit::RegisterType type = register_type_from_string(fields.at(2));
+    if (type <= QModbusDataUnit::Invalid || type > QModbusDataUnit::HoldingRegisters)
+    {
+        error = "bad register type";
+        return false;
+    }
+
+    const int start = fields.size() > 3 ? fields.at(3).toInt(&ok) : -1;
+    if (!ok || start < 0 || start > 0xFFFF)
+    {
+        error = "bad start address";
+        return false;
+    }
+
+    auto parse_values = [&ok](const QString& text)
+    {
+        QVector<quint16> values;
+        for (const QString& item: text.split(','))
+        {
+            const uint value = item.toUInt(&ok);
+            if (!ok || value > 0xFFFF)
+            {
+                ok = false;
+                break;
+            }
+            values.push_back(static_cast<quint16>(value));
+        }
+        return values;
+    };
+
+    if (op == "read" && fields.size() == 5)
+    {
+        const int count = fields.at(4).toInt(&ok);
+        ok = ok && count > 0 && address != 0;
+        request = Request::read(address, type, start, count);
+    }
+    else if (op == "write" && fields.size() == 5)
+        request = Request::write(address, type, start, parse_values(fields.at(4)));
+    else if (op == "readwrite" && fields.size() == 6)
+    {
+        const int count = fields.at(4).toInt(&ok);
+        const QVector<quint16> values = ok ? parse_values(fields.at(5)) : QVector<quint16>();
+        ok = ok && count > 0 && address != 0;
+        request = Request::read_write(address, type, start, count, values);
+    }
+    else
+    {
+        error = "unknown command";
+        return false;
+    }
+
+    if (!ok)
+        error = "bad count or values";
+    return ok;
+}
+
+void Batch_Runner::dispatch()
+{
+    if (_finished)
+        return;
+
+    if (!_client->is_connected())
+    {
+        if (!_waiting.isEmpty() && !_client->connect_device())
+            fail_waiting("ConnectionError");
+        return;
+    }
+
+    while (!_waiting.isEmpty() && _client->can_send())
+    {
+        // Keep input order where it matters: wait until overlapping writes are done
+        for (const Command& other: _in_flight)
+            if (conflicts(other._request, _waiting.head()._request))
+                return;
+
+        const Command command = _waiting.dequeue();
+        _in_flight.insert(command._seq, command);
+        _client->send(command._request);
+    }
+
+    if (!_eof && _waiting.size() < max_backlog)
+        _notifier->setEnabled(true);
+}
+
+void Batch_Runner::add_result(int seq, const QString &text)
+{
+    _results.insert(seq, text);
+
+    bool written = false;
+    while (_results.contains(_next_output))
+    {
+        _output.write(_results.take(_next_output++).toUtf8());
+        _output.write("\n", 1);
+        written = true;
+    }
+    if (written)
+        _output.flush();
+}
+
+void Batch_Runner::fail_waiting(const QString &reason)
+{
+    while (!_waiting.isEmpty())
+    {
+        const Command command = _waiting.dequeue();
+        add_result(command._seq, QString("%1 error %2").arg(command._line).arg(reason));
+    }
+}
+
+void Batch_Runner::check_done()
+{
+    if (_eof && !_finished && _waiting.isEmpty() && _in_flight.isEmpty())
+    {
+        _finished = true;
+        emit done();
+    }
+}
+
+/*static*/ bool Batch_Runner::conflicts(const Request &a, const Request &b)
+{
+    if (a._kind == Request::RAW || b._kind == Request::RAW)
+        return true;
+    if (a._kind == Request::READ && b._kind == Request::READ)
+        return false;
+    if (a._type != b._type)
+        return false;
+    if (a._server_address != b._server_address && a._server_address != 0 && b._server_address != 0)
+        return false;
+
+    const int a_end = a._start + std::max(a._count, a._values.size());
+    const int b_end = b._start + std::max(b._count, b._values.size());
+    return a._start < b_end && b._start < a_end;
+}
+
+} // namespace Modbus_Cli
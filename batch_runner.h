@@ -0,0 +1,84 @@
+#ifndef MODBUS_CLI_BATCH_RUNNER_H
+#define MODBUS_CLI_BATCH_RUNNER_H
+
+#include <memory>
+
+#include <QFile>
+#include <QMap>
+#include <QQueue>
+#include <QSocketNotifier>
+
+#include "session.h"
+
+namespace Modbus_Cli {
+
+/*
+ * Runs commands read from a file or stdin over one connection, one command per line:
+ *   read <address> <type> <start> <count>
+ *   write <address> <type> <start> <values>
+ *   readwrite <address> <type> <start> <count> <values>
+ *   raw <address> <function_hex> <data_hex>
+ * Values are comma separated, '#' starts a comment. For every command one line is written
+ * to stdout in input order: "<line> ok [values or response hex]" or "<line> error <reason>".
+ * Up to --window commands are in flight, a command waits while it overlaps a write in flight.
+ */
+class Batch_Runner : public QObject
+{
+    Q_OBJECT
+public:
+    /// file_name "-" is stdin
+    Batch_Runner(const QString& conn_string, const Job& job, const QString& file_name, QObject* parent = nullptr);
+
+    bool start();
+
+    /// Parses one command line split by spaces, error is set on failure
+    static bool parse_command(const QStringList& fields, Request& request, QString& error);
+    /// b can't be in flight together with a: one of them writes what the other touches
+    static bool conflicts(const Request& a, const Request& b);
+signals:
+    void done();
+private slots:
+    void on_connected();
+    void read_input();
+    void data_received(const Request& request, const QModbusDataUnit& unit, const QModbusResponse& response);
+    void request_failed(const Request& request, QModbusDevice::Error error);
+    void request_finished();
+private:
+    struct Command
+    {
+        int _seq;
+        int _line;
+        Request _request;
+    };
+
+    void parse_line(const QString& line);
+    void dispatch();
+    void add_result(int seq, const QString& text);
+    void fail_waiting(const QString& reason);
+    void check_done();
+
+    static const int max_backlog = 4096;
+
+    Job _job;
+    QString _file_name;
+    std::unique_ptr<Client> _client;
+
+    QFile _input;
+    std::unique_ptr<QSocketNotifier> _notifier;
+    QByteArray _input_buffer;
+    bool _eof;
+    int _line_number;
+
+    int _next_seq;
+    QQueue<Command> _waiting;
+    QHash<int, Command> _in_flight;
+
+    QFile _output;
+    QMap<int, QString> _results;    ///< Finished out of order, by seq
+    int _next_output;
+    bool _finished;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_BATCH_RUNNER_H
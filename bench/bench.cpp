@@ -0,0 +1,174 @@
+#include <QHostAddress>
+#include <QDebug>
+
+#include "stats.h"
+#include "sim/rtu_slave.h"
+#include "sim/tcp_slave.h"
+#include "bench.h"
+
+namespace Modbus_Bench {
+
+Sim_Thread::Sim_Thread(const Modbus_Sim::Sim_Config &config, bool rtu) :
+    _config(config),
+    _rtu(rtu),
+    _ok(false),
+    _tcp_port(0)
+{
+}
+
+bool Sim_Thread::start_and_wait()
+{
+    start();
+    _ready.acquire();
+    return _ok;
+}
+
+quint16 Sim_Thread::tcp_port() const
+{
+    return _tcp_port;
+}
+
+QString Sim_Thread::rtu_name() const
+{
+    return _rtu_name;
+}
+
+void Sim_Thread::run()
+{
+    Modbus_Sim::Simulator simulator{_config};
+    simulator.fill_with_addresses();
+
+    Modbus_Sim::Tcp_Slave tcp_slave{&simulator};
+    Modbus_Sim::Rtu_Slave rtu_slave{&simulator};
+
+    _ok = tcp_slave.listen(QHostAddress::LocalHost, 0);
+    _tcp_port = tcp_slave.port();
+    if (_ok && _rtu)
+    {
+        _ok = rtu_slave.open();
+        _rtu_name = rtu_slave.slave_name();
+    }
+    _ready.release();
+
+    if (_ok)
+        exec();
+}
+
+// --------------------
+
+Bench::Bench(const Bench_Config &config, const QString &conn_string, QObject *parent) :
+    QObject(parent),
+    _config(config),
+    _conn_string(conn_string),
+    _case(-1),
+    _sent(0),
+    _finished(0),
+    _failed(false)
+{
+    using Modbus_Cli::Request;
+    const QVector<quint16> values(config._count, 0x55AA);
+    const QByteArray raw_read = QByteArray::fromHex("0000") + QByteArray(1, '\0') + QByteArray(1, static_cast<char>(config._count));
+
+    for (int window: config._windows)
+    {
+        _cases.push_back(Case{"read", Request::read(1, QModbusDataUnit::HoldingRegisters, 0, config._count), window});
+        _cases.push_back(Case{"write", Request::write(1, QModbusDataUnit::HoldingRegisters, 1000, values), window});
+        _cases.push_back(Case{"readwrite", Request::read_write(1, QModbusDataUnit::HoldingRegisters, 2000, config._count, values), window});
+        _cases.push_back(Case{"raw", Request::raw(1, QModbusPdu::ReadHoldingRegisters, raw_read), window});
+    }
+}
+
+void Bench::start()
+{
+    qInfo().noquote() << QString("%1 %2 %3 %4 %5 %6 %7 %8")
+                         .arg("case", -10).arg("window", 6).arg("requests", 9).arg("req/s", 10)
+                         .arg("p50 ms", 8).arg("p99 ms", 8).arg("max ms", 8).arg("errors", 7);
+    next_case();
+}
+
+void Bench::on_connected()
+{
+    Modbus_Cli::Stats::local().reset();
+    _clock.start();
+    fill_window();
+}
+
+void Bench::on_finished()
+{
+    if (!_client->is_connected() && _client->pending_count() == 0 && _sent < _config._requests)
+    {
+        qCritical().noquote() << "Connection lost in case" << _cases.at(_case)._name;
+        _failed = true;
+        next_case();
+        return;
+    }
+
+    if (++_finished == _config._requests)
+    {
+        print_result();
+        next_case();
+    }
+    else
+        fill_window();
+}
+
+void Bench::next_case()
+{
+    if (_client)
+        _client.release()->deleteLater();
+
+    if (++_case >= _cases.size())
+    {
+        emit done(_failed ? 1 : 0);
+        return;
+    }
+
+    _sent = 0;
+    _finished = 0;
+
+    _client.reset(new Modbus_Cli::Client{_conn_string, 1000, 0, true});
+    _client->set_print_values(false);
+    _client->set_window(_cases.at(_case)._window);
+    connect(_client.get(), &Modbus_Cli::Client::connected, this, &Bench::on_connected);
+    connect(_client.get(), &Modbus_Cli::Client::finished, this, &Bench::on_finished);
+    if (!_client->connect_device())
+    {
+        _failed = true;
+        emit done(1);
+    }
+}
+
+void Bench::fill_window()
+{
+    const Case& item = _cases.at(_case);
+    while (_sent < _config._requests && _client->can_send())
+    {
+        ++_sent;
+        _client->send(item._request);
+    }
+}
+
+void Bench::print_result()
+{
+    const double seconds = _clock.nsecsElapsed() / 1e9;
+    const double rate = seconds > 0 ? _finished / seconds : 0.;
+    const Modbus_Cli::Stats& stats = Modbus_Cli::Stats::local();
+    const Modbus_Cli::Histogram& latency = stats.latency();
+    const Case& item = _cases.at(_case);
+
+    qInfo().noquote() << QString("%1 %2 %3 %4 %5 %6 %7 %8")
+                         .arg(item._name, -10).arg(_client->window(), 6).arg(_finished, 9)
+                         .arg(rate, 10, 'f', 1)
+                         .arg(latency.value_at_percentile(50) / 1000., 8, 'f', 3)
+                         .arg(latency.value_at_percentile(99) / 1000., 8, 'f', 3)
+                         .arg(latency.max() / 1000., 8, 'f', 3)
+                         .arg(stats.errors(), 7);
+
+    if (_config._min_rate > 0 && rate < _config._min_rate)
+    {
+        qCritical().noquote() << "Case" << item._name << "is slower than" << _config._min_rate << "req/s";
+        _failed = true;
+    }
+}
+
+} // namespace Modbus_Bench
@@ -0,0 +1,86 @@
+#ifndef MODBUS_BENCH_BENCH_H
+#define MODBUS_BENCH_BENCH_H
+
+#include <memory>
+
+#include <QElapsedTimer>
+#include <QThread>
+#include <QSemaphore>
+
+#include "client.h"
+#include "sim/simulator.h"
+
+namespace Modbus_Bench {
+
+/// Simulator with Modbus TCP and optional RTU slave running in its own thread
+class Sim_Thread : public QThread
+{
+    Q_OBJECT
+public:
+    Sim_Thread(const Modbus_Sim::Sim_Config& config, bool rtu);
+
+    /// Starts thread and waits until slaves are listening
+    bool start_and_wait();
+
+    quint16 tcp_port() const;
+    QString rtu_name() const;
+protected:
+    void run() override;
+private:
+    Modbus_Sim::Sim_Config _config;
+    bool _rtu;
+    bool _ok;
+    quint16 _tcp_port;
+    QString _rtu_name;
+    QSemaphore _ready;
+};
+
+struct Bench_Config
+{
+    int _requests;
+    int _count;
+    QVector<int> _windows;
+    double _min_rate;       ///< Fail if any case is slower, requests per second
+};
+
+/// Runs read, write, readwrite and raw requests through Client and prints rate and latency
+class Bench : public QObject
+{
+    Q_OBJECT
+public:
+    Bench(const Bench_Config& config, const QString& conn_string, QObject* parent = nullptr);
+
+    void start();
+signals:
+    void done(int exit_code);
+private slots:
+    void on_connected();
+    void on_finished();
+private:
+    struct Case
+    {
+        QString _name;
+        Modbus_Cli::Request _request;
+        int _window;
+    };
+
+    void next_case();
+    void fill_window();
+    void print_result();
+
+    Bench_Config _config;
+    QString _conn_string;
+
+    QVector<Case> _cases;
+    int _case;
+    int _sent;
+    int _finished;
+    bool _failed;
+
+    QElapsedTimer _clock;
+    std::unique_ptr<Modbus_Cli::Client> _client;
+};
+
+} // namespace Modbus_Bench
+
+#endif // MODBUS_BENCH_BENCH_H
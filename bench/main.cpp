@@ -0,0 +1,60 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+
+#include "bench.h"
+
+using namespace Modbus_Bench;
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Modbus Cli benchmark against local simulator");
+    parser.addHelpOption();
+    parser.addOptions({
+        { "requests", QCoreApplication::translate("main", "Requests per case. Default: 10000"), "requests", "10000"},
+        { "count", QCoreApplication::translate("main", "Registers per request. Default: 10"), "count", "10"},
+        { "window", QCoreApplication::translate("main", "Comma separated in flight windows. Default: 1,8"), "windows", "1,8"},
+        { "delay", QCoreApplication::translate("main", "Simulator response delay in milliseconds. Default: 0"), "ms", "0"},
+        { "jitter", QCoreApplication::translate("main", "Simulator response jitter in milliseconds. Default: 0"), "ms", "0"},
+        { "rtu", QCoreApplication::translate("main", "Use RTU over pseudo-terminal instead of Modbus TCP")},
+        { "baud", QCoreApplication::translate("main", "RTU baud rate. Default: 115200"), "baud", "115200"},
+        { "native", QCoreApplication::translate("main", "Use own transport: epoll engine for TCP, termios driver for RTU")},
+        { "min_rate", QCoreApplication::translate("main", "Exit with error if any case is slower, req/s. Default: 0"), "rate", "0"}
+    });
+    parser.process(a);
+
+    Bench_Config config;
+    config._requests = parser.value("requests").toInt();
+    config._count = parser.value("count").toInt();
+    config._min_rate = parser.value("min_rate").toDouble();
+    for (const QString& window: parser.value("window").split(','))
+        if (!window.isEmpty())
+            config._windows.push_back(window.toInt());
+
+    Modbus_Sim::Sim_Config sim_config;
+    sim_config._delay_ms = parser.value("delay").toInt();
+    sim_config._jitter_ms = parser.value("jitter").toInt();
+
+    const bool rtu = parser.isSet("rtu");
+    Sim_Thread sim_thread{sim_config, rtu};
+    if (!sim_thread.start_and_wait())
+        return 1;
+
+    QString conn_string = rtu ?
+                QString("rtu://%1?baudRate=%2").arg(sim_thread.rtu_name()).arg(parser.value("baud")) :
+                QString("mtcp://127.0.0.1:%1").arg(sim_thread.tcp_port());
+    if (parser.isSet("native"))
+        conn_string += rtu ? "&driver=native" : "?engine=epoll";
+
+    Bench bench{config, conn_string};
+    QObject::connect(&bench, &Bench::done, &a, &QCoreApplication::exit, Qt::QueuedConnection);
+    bench.start();
+
+    const int exit_code = a.exec();
+    sim_thread.quit();
+    sim_thread.wait();
+    return exit_code;
+}
@@ -0,0 +1,59 @@
+QT -= gui
+QT += serialport serialbus network
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = modbus_bench
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        ../bus_scheduler.cpp \
+        ../change_filter.cpp \
+        ../client.cpp \
+        ../config.cpp \
+        ../connection_metrics.cpp \
+        ../crc16.cpp \
+        ../device.cpp \
+        ../histogram.cpp \
+        ../output_writer.cpp \
+        ../protocol.cpp \
+        ../register_image.cpp \
+        ../rtu_master.cpp \
+        ../rtt_estimator.cpp \
+        ../stats.cpp \
+        ../tcp_master.cpp \
+        ../tcp_reactor.cpp \
+        ../traffic_capture.cpp \
+        ../value_decoder.cpp \
+        ../sim/rtu_slave.cpp \
+        ../sim/simulator.cpp \
+        ../sim/tcp_slave.cpp \
+        bench.cpp \
+        main.cpp
+
+HEADERS += \
+    ../bus_scheduler.h \
+    ../change_filter.h \
+    ../client.h \
+    ../config.h \
+    ../connection_metrics.h \
+    ../crc16.h \
+    ../device.h \
+    ../histogram.h \
+    ../output_writer.h \
+    ../protocol.h \
+    ../register_image.h \
+    ../request.h \
+    ../rtu_master.h \
+    ../rtt_estimator.h \
+    ../stats.h \
+    ../tcp_master.h \
+    ../tcp_reactor.h \
+    ../traffic_capture.h \
+    ../value_decoder.h \
+    ../sim/rtu_slave.h \
+    ../sim/simulator.h \
+    ../sim/tcp_slave.h \
+    bench.h
@@ -0,0 +1,276 @@
+#include <algorithm>
+
+#include <QtEndian>
+#include <QDebug>
+
+#include "protocol.h"
+#include "bulk_writer.h"
+
+namespace Modbus_Cli {
+
+Bulk_Writer::Bulk_Writer(const QString &conn_string, const Job &job, const QString &file_name, int server_address,
+                         QModbusDataUnit::RegisterType type, int start, bool compare, bool verify, QObject *parent) :
+    QObject(parent),
+    _job(job),
+    _file_name(file_name),
+    _server_address(server_address),
+    _type(type),
+    _start(start),
+    _compare(compare),
+    _verify(verify),
+    _client(make_client(conn_string, job)),
+    _binary(nullptr),
+    _count(0),
+    _chunk_size(max_write_count(type)),
+    _chunk_count(0),
+    _next_chunk(0),
+    _remaining(0),
+    _verifying(false),
+    _finished(false),
+    _written(0),
+    _equal(0),
+    _failed(0),
+    _mismatched(0)
+{
+    _client->set_print_values(false);
+
+    connect(_client.get(), &Client::connected, this, &Bulk_Writer::on_connected);
+    connect(_client.get(), &Client::data_received, this, &Bulk_Writer::data_received);
+    connect(_client.get(), &Client::request_failed, this, &Bulk_Writer::request_failed);
+    connect(_client.get(), &Client::finished, this, &Bulk_Writer::request_finished);
+}
+
+bool Bulk_Writer::start()
+{
+    if (!load())
+        return false;
+
+    _chunk_count = (_count + _chunk_size - 1) / _chunk_size;
+    _steps.fill(WRITE, _chunk_count);
+    _remaining = _chunk_count;
+    _elapsed.start();
+
+    if (!_client->connect_device())
+        finish();
+    return true;
+}
+
+void Bulk_Writer::on_connected()
+{
+    dispatch();
+}
+
+bool Bulk_Writer::load()
+{
+    _file.setFileName(_file_name);
+    if (!_file.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "Can't open" << _file_name << _file.errorString();
+        return false;
+    }
+
+    const qint64 size = _file.size();
+    const uchar* data = size > 0 ? _file.map(0, size) : nullptr;
+    if (size > 0 && !data)
+    {
+        qCritical().noquote() << "Can't map" << _file_name << _file.errorString();
+        return false;
+    }
+
+    if (_file_name.endsWith(".bin", Qt::CaseInsensitive))
+    {
+        if (size % 2)
+        {
+            qCritical().noquote() << "Odd size of binary file" << _file_name;
+            return false;
+        }
+        _binary = data;
+        _count = static_cast<int>(std::min<qint64>(size / 2, 0x10000 + 1));
+    }
+    else
+    {
+        if (!parse_text(reinterpret_cast<const char*>(data), size))
+            return false;
+        _count = _values.size();
+        _file.close();
+    }
+
+    if (_count == 0 || _start + _count > 0x10000)
+    {
+        qCritical().noquote() << _count << "values from" << _file_name << "don't fit from address" << _start;
+        return false;
+    }
+    return true;
+}
+
+bool Bulk_Writer::parse_text(const char *data, qint64 size)
+{
+    _values.reserve(static_cast<int>(std::min<qint64>(size / 2, 0x10000)));
+
+    quint32 value = 0;
+    bool in_number = false;
+    for (qint64 i = 0; i <= size; ++i)
+    {
+        const char c = i < size ? data[i] : ' ';
+        if (c >= '0' && c <= '9')
+        {
+            value = value * 10 + static_cast<quint32>(c - '0');
+            in_number = true;
+            if (value > 0xFFFF)
+            {
+                qCritical().noquote() << "Value over 65535 in" << _file_name << "at offset" << i;
+                return false;
+            }
+        }
+        else if (c == ',' || c == ';' || c == ' ' || c == '\t' || c == '\n' || c == '\r')
+        {
+            if (in_number)
+            {
+                if (_values.size() > 0xFFFF)
+                    break;
+                _values.push_back(static_cast<quint16>(value));
+            }
+            value = 0;
+            in_number = false;
+        }
+        else
+        {
+            qCritical().noquote() << "Unexpected character in" << _file_name << "at offset" << i;
+            return false;
+        }
+    }
+    return true;
+}
+
+QVector<quint16> Bulk_Writer::chunk_values(int chunk) const
+{
+    const int first = chunk * _chunk_size;
+    QVector<quint16> values(std::min(_chunk_size, _count - first));
+    for (int i = 0; i < values.size(); ++i)
+    {
+        const quint16 value = _binary ? qFromLittleEndian<quint16>(_binary + 2 * (first + i)) : _values.at(first + i);
+        values[i] = _type == QModbusDataUnit::Coils ? (value != 0) : value;
+    }
+    return values;
+}
+
+void Bulk_Writer::dispatch()
+{
+    while (!_finished && _client->is_connected() && _client->can_send())
+    {
+        if (!_to_write.isEmpty())
+            send_step(_to_write.dequeue(), WRITE);
+        else if (_next_chunk < _chunk_count)
+        {
+            const int chunk = _next_chunk++;
+            send_step(chunk, _verifying ? VERIFY : _compare ? COMPARE : WRITE);
+        }
+        else
+            break;
+    }
+}
+
+void Bulk_Writer::send_step(int chunk, Step step)
+{
+    const int start = _start + chunk * _chunk_size;
+    Request request = step == WRITE ?
+                Request::write(_server_address, _type, start, chunk_values(chunk)) :
+                Request::read(_server_address, _type, start, std::min(_chunk_size, _count - chunk * _chunk_size));
+    request._id = chunk;
+    _steps[chunk] = step;
+    _client->send(request);
+}
+
+void Bulk_Writer::data_received(const Request &request, const QModbusDataUnit &unit)
+{
+    const int chunk = request._id;
+    if (chunk < 0 || chunk >= _chunk_count)
+        return;
+
+    switch (_steps.at(chunk))
+    {
+    case COMPARE:
+        if (unit.values() == chunk_values(chunk))
+        {
+            ++_equal;
+            --_remaining;
+        }
+        else
+            _to_write.enqueue(chunk);
+        break;
+    case WRITE:
+        ++_written;
+        --_remaining;
+        break;
+    case VERIFY:
+    {
+        const QVector<quint16> expected = chunk_values(chunk);
+        const QVector<quint16> values = unit.values();
+        for (int i = 0; i < expected.size(); ++i)
+            if (i >= values.size() || values.at(i) != expected.at(i))
+            {
+                qCritical().noquote() << "Verify failed at address" << request._start + i << "device has"
+                                      << (i < values.size() ? QString::number(values.at(i)) : QString("nothing"))
+                                      << "file has" << expected.at(i);
+                ++_mismatched;
+                break;
+            }
+        --_remaining;
+        break;
+    }
+    }
+}
+
+void Bulk_Writer::request_failed(const Request &request, QModbusDevice::Error /*error*/)
+{
+    if (request._id < 0 || request._id >= _chunk_count)
+        return;
+
+    ++_failed;
+    --_remaining;
+}
+
+void Bulk_Writer::request_finished()
+{
+    if (_finished)
+        return;
+
+    if (!_client->is_connected())
+    {
+        if (_client->pending_count() == 0)
+        {
+            qCritical().noquote() << "Connection lost," << _remaining << "chunks not done";
+            finish();
+        }
+        return;
+    }
+
+    dispatch();
+    if (_remaining > 0 || _client->pending_count() > 0)
+        return;
+
+    if (_verify && !_verifying)
+    {
+        _verifying = true;
+        _next_chunk = 0;
+        _remaining = _chunk_count;
+        dispatch();
+    }
+    else
+        finish();
+}
+
+void Bulk_Writer::finish()
+{
+    if (_finished)
+        return;
+    _finished = true;
+
+    qInfo().noquote() << QString("Uploaded %1 values in %2 chunks: %3 written, %4 equal, %5 failed%6, %7 ms")
+                         .arg(_count).arg(_chunk_count).arg(_written).arg(_equal).arg(_failed)
+                         .arg(_verify ? QString(", %1 differ on verify").arg(_mismatched) : QString())
+                         .arg(_elapsed.elapsed());
+    emit done(_failed > 0 || _mismatched > 0 ? 1 : 0);
+}
+
+} // namespace Modbus_Cli
@@ -0,0 +1,84 @@
+#ifndef MODBUS_CLI_BULK_WRITER_H
+#define MODBUS_CLI_BULK_WRITER_H
+
+#include <memory>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QQueue>
+
+#include "session.h"
+
+namespace Modbus_Cli {
+
+/*
+ * Writes a register image from file to one device in chunks of the protocol maximum (123 registers or 1968 coils),
+ * up to --window chunks in flight. The file is memory-mapped:
+ *   text:  decimal values separated by commas, semicolons or whitespace
+ *   .bin:  little-endian u16 per register or coil
+ * With compare every chunk is read first and isn't written if the device already holds it.
+ * With verify all chunks are read back after they are written.
+ */
+class Bulk_Writer : public QObject
+{
+    Q_OBJECT
+public:
+    Bulk_Writer(const QString& conn_string, const Job& job, const QString& file_name, int server_address,
+                QModbusDataUnit::RegisterType type, int start, bool compare, bool verify, QObject* parent = nullptr);
+
+    bool start();
+signals:
+    /// exit_code is 1 if a chunk failed or differs on verify
+    void done(int exit_code);
+private slots:
+    void on_connected();
+    void data_received(const Request& request, const QModbusDataUnit& unit);
+    void request_failed(const Request& request, QModbusDevice::Error error);
+    void request_finished();
+private:
+    enum Step : quint8 {
+        COMPARE,
+        WRITE,
+        VERIFY
+    };
+
+    bool load();
+    bool parse_text(const char* data, qint64 size);
+    QVector<quint16> chunk_values(int chunk) const;
+    void dispatch();
+    void send_step(int chunk, Step step);
+    void finish();
+
+    Job _job;
+    QString _file_name;
+    int _server_address;
+    QModbusDataUnit::RegisterType _type;
+    int _start;
+    bool _compare;
+    bool _verify;
+    std::unique_ptr<Client> _client;
+
+    QFile _file;
+    const uchar* _binary;       ///< Mapped .bin file
+    QVector<quint16> _values;   ///< Parsed text file
+    int _count;
+    int _chunk_size;
+    int _chunk_count;
+
+    QVector<Step> _steps;       ///< Step in flight of every chunk
+    QQueue<int> _to_write;      ///< Compared and found different
+    int _next_chunk;
+    int _remaining;             ///< Chunks not finished in this pass
+    bool _verifying;
+    bool _finished;
+
+    int _written;
+    int _equal;
+    int _failed;
+    int _mismatched;
+    QElapsedTimer _elapsed;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_BULK_WRITER_H
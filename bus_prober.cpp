@@ -0,0 +1,208 @@
+#include <QUrl>
+#include <QUrlQuery>
+#include <QDebug>
+
+#include "client.h"
+#include "bus_prober.h"
+
+namespace Modbus_Cli {
+
+namespace {
+
+const int max_endpoints = 1 << 20;
+
+/// "5" or "1-254"
+bool parse_range(const QString& text, int max, int& first, int& last)
+{
+    const int sep = text.indexOf('-');
+    bool ok;
+    first = text.left(sep).toInt(&ok);
+    last = ok && sep != -1 ? text.mid(sep + 1).toInt(&ok) : first;
+    return ok && first >= 0 && first <= last && last <= max;
+}
+
+bool parse_parity(const QString& text, int& parity)
+{
+    static const char* const letters[] = { "N", nullptr, "E", "O", "S", "M" };  // QSerialPort::Parity values
+    for (int i = 0; i < 6; ++i)
+        if (letters[i] && text.toUpper() == letters[i])
+        {
+            parity = i;
+            return true;
+        }
+    return false;
+}
+
+} // namespace
+
+Bus_Prober::Bus_Prober(Client *client, const QVector<int> &addresses, const Request &probe, QObject *parent) :
+    QObject(parent),
+    _client(client),
+    _addresses(addresses),
+    _probe(probe),
+    _next(0),
+    _found(0),
+    _started(false),
+    _finished(false)
+{
+    _client->set_print_values(false);
+    connect(_client, &Client::data_received, this, &Bus_Prober::data_received);
+    connect(_client, &Client::request_failed, this, &Bus_Prober::request_failed);
+    connect(_client, &Client::finished, this, &Bus_Prober::request_finished);
+}
+
+void Bus_Prober::start()
+{
+    _started = true;
+    _elapsed.start();
+    probe_next();
+}
+
+void Bus_Prober::data_received(const Request &request)
+{
+    report(request._server_address, false);
+}
+
+void Bus_Prober::request_failed(const Request &request, QModbusDevice::Error error)
+{
+    if (error == QModbusDevice::ProtocolError)
+        report(request._server_address, true);
+}
+
+void Bus_Prober::request_finished()
+{
+    // Not connected: no device on the host, or the serial port is gone
+    if (!_client->is_connected())
+        finish();
+    else if (_started && _client->pending_count() == 0)
+        probe_next();
+}
+
+void Bus_Prober::probe_next()
+{
+    if (_finished)
+        return;
+
+    // One at a time, latency is the answer time alone
+    if (_next >= _addresses.size())
+    {
+        finish();
+        return;
+    }
+
+    Request request = _probe;
+    request._server_address = _addresses.at(_next++);
+    _client->send(request);
+}
+
+void Bus_Prober::report(int server_address, bool exception)
+{
+    ++_found;
+    qInfo().noquote() << QString("%1 slave %2 answered in %3 ms%4").arg(_client->conn_string()).arg(server_address)
+                         .arg(_client->last_latency_us() / 1000.0, 0, 'f', 3)
+                         .arg(exception ? " with exception" : "");
+}
+
+void Bus_Prober::finish()
+{
+    if (_finished)
+        return;
+    _finished = true;
+
+    if (_started)
+        qInfo().noquote() << QString("%1: %2 of %3 addresses answered in %4 ms").arg(_client->conn_string())
+                             .arg(_found).arg(_next).arg(_elapsed.elapsed());
+    emit done();
+}
+
+/*static*/ bool Bus_Prober::expand_endpoints(const QStringList &endpoints, const QString &serial_settings, QStringList &expanded)
+{
+    for (const QString& endpoint: endpoints)
+    {
+        const int scheme_end = endpoint.indexOf("://");
+        if (scheme_end == -1)
+        {
+            expanded.push_back(endpoint);
+            continue;
+        }
+
+        if (endpoint.startsWith("rtu", Qt::CaseInsensitive))
+        {
+            if (serial_settings.isEmpty())
+                expanded.push_back(endpoint);
+
+            for (const QString& setting: serial_settings.split(','))
+            {
+                if (setting.isEmpty())
+                    continue;
+                const QStringList parts = setting.split(':');
+                bool ok = parts.size() == 2;
+                const int baud_rate = ok ? parts.at(0).toInt(&ok) : 0;
+                int parity = 0;
+                if (!ok || baud_rate <= 0 || !parse_parity(parts.at(1), parity))
+                {
+                    qCritical().noquote() << "Bad serial setting" << setting << "expected baud:parity, e.g. 9600:N";
+                    return false;
+                }
+
+                QUrl url(endpoint);
+                QUrlQuery query(url);
+                query.removeAllQueryItems("baudRate");
+                query.removeAllQueryItems("parity");
+                query.addQueryItem("baudRate", QString::number(baud_rate));
+                query.addQueryItem("parity", QString::number(parity));
+                url.setQuery(query);
+                expanded.push_back(url.toString());
+            }
+            continue;
+        }
+
+        // scheme://host[:port][rest]
+        const int host_start = scheme_end + 3;
+        int host_end = host_start;
+        while (host_end < endpoint.size() && endpoint.at(host_end) != ':' && endpoint.at(host_end) != '/'
+               && endpoint.at(host_end) != '?')
+            ++host_end;
+        int port_end = host_end;
+        if (port_end < endpoint.size() && endpoint.at(port_end) == ':')
+            while (++port_end < endpoint.size() && endpoint.at(port_end) != '/' && endpoint.at(port_end) != '?') {}
+
+        const QString host = endpoint.mid(host_start, host_end - host_start);
+        const QString port = endpoint.mid(host_end + 1, port_end - host_end - 1);
+        const int octet_start = host.lastIndexOf('.') + 1;
+
+        int first_host = 0, last_host = 0, first_port = 0, last_port = 0;
+        const bool host_range = octet_start > 0 && host.indexOf('-', octet_start) != -1;
+        const bool port_range = port.contains('-');
+        if ((host_range && !parse_range(host.mid(octet_start), 255, first_host, last_host))
+                || (port_range && !parse_range(port, 0xFFFF, first_port, last_port)))
+        {
+            qCritical().noquote() << "Bad address range in" << endpoint;
+            return false;
+        }
+        if (!host_range && !port_range)
+        {
+            expanded.push_back(endpoint);
+            continue;
+        }
+
+        if (static_cast<qint64>(last_host - first_host + 1) * (last_port - first_port + 1) + expanded.size() > max_endpoints)
+        {
+            qCritical().noquote() << "Too many addresses in" << endpoint;
+            return false;
+        }
+
+        const QString prefix = endpoint.left(host_start) + host.left(octet_start);
+        const QString rest = endpoint.mid(port_end);
+        for (int h = first_host; h <= last_host; ++h)
+            for (int p = first_port; p <= last_port; ++p)
+            {
+                const QString host_text = host_range ? prefix + QString::number(h) : endpoint.left(host_end);
+                const QString port_text = port_range ? ":" + QString::number(p) : endpoint.mid(host_end, port_end - host_end);
+                expanded.push_back(host_text + port_text + rest);
+            }
+    }
+    return true;
+}
+
+} // namespace Modbus_Cli
@@ -0,0 +1,50 @@
+#ifndef MODBUS_CLI_BUS_PROBER_H
+#define MODBUS_CLI_BUS_PROBER_H
+
+#include <QElapsedTimer>
+#include <QModbusDevice>
+#include <QStringList>
+#include <QVector>
+
+#include "request.h"
+
+namespace Modbus_Cli {
+
+class Client;
+
+/// Finds slaves of one connection: every address gets one probe request, an answer or a Modbus exception is a responder
+class Bus_Prober : public QObject
+{
+    Q_OBJECT
+public:
+    Bus_Prober(Client* client, const QVector<int>& addresses, const Request& probe, QObject* parent = nullptr);
+
+    void start();
+
+    /// Expands host and port ranges "mtcp://10.0.0.1-254:502-503" (last octet only),
+    /// serial connections are repeated for every "baud:parity" of serial_settings, e.g. "9600:N,19200:E"
+    static bool expand_endpoints(const QStringList& endpoints, const QString& serial_settings, QStringList& expanded);
+signals:
+    void done();
+private slots:
+    void data_received(const Request& request);
+    void request_failed(const Request& request, QModbusDevice::Error error);
+    void request_finished();
+private:
+    void probe_next();
+    void report(int server_address, bool exception);
+    void finish();
+
+    Client* _client;
+    QVector<int> _addresses;
+    Request _probe;
+    int _next;
+    int _found;
+    bool _started;
+    bool _finished;
+    QElapsedTimer _elapsed;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_BUS_PROBER_H
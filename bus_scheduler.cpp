@@ -0,0 +1,124 @@
+#include <algorithm>
+
+#include "bus_scheduler.h"
+
+namespace Modbus_Cli {
+
+const int Bus_Scheduler::isolate_after;
+const int Bus_Scheduler::min_backoff_ms;
+const int Bus_Scheduler::max_backoff_ms;
+
+Bus_Scheduler::Bus_Scheduler() :
+    _seq(0)
+{
+}
+
+void Bus_Scheduler::push(const Request &request, int attempt)
+{
+    _heap.push_back(Entry{request, attempt, _seq++});
+    std::push_heap(_heap.begin(), _heap.end(), &Bus_Scheduler::later);
+}
+
+bool Bus_Scheduler::pop(Request &request, int &attempt)
+{
+    if (_heap.empty())
+        return false;
+
+    std::pop_heap(_heap.begin(), _heap.end(), &Bus_Scheduler::later);
+    request = _heap.back()._request;
+    attempt = _heap.back()._attempt;
+    _heap.pop_back();
+    return true;
+}
+
+int Bus_Scheduler::size() const
+{
+    return static_cast<int>(_heap.size());
+}
+
+bool Bus_Scheduler::is_empty() const
+{
+    return _heap.empty();
+}
+
+bool Bus_Scheduler::admit(int server_address, Clock::time_point now)
+{
+    if (server_address == 0 || !_slaves.contains(server_address))
+        return true;
+
+    Slave& slave = _slaves[server_address];
+    if (slave._failures < isolate_after)
+        return true;
+    if (slave._probing || now < slave._until)
+        return false;
+
+    slave._probing = true;
+    return true;
+}
+
+Bus_Scheduler::Health_Change Bus_Scheduler::report(int server_address, bool answered, Clock::time_point now)
+{
+    if (server_address == 0) // Broadcast is never answered
+        return NO_CHANGE;
+
+    if (answered)
+    {
+        if (!_slaves.contains(server_address))
+            return NO_CHANGE;
+        const bool was_isolated = _slaves.take(server_address)._failures >= isolate_after;
+        return was_isolated ? RECOVERED : NO_CHANGE;
+    }
+
+    if (!_slaves.contains(server_address))
+        _slaves.insert(server_address, Slave{0, 0, now, false});
+
+    Slave& slave = _slaves[server_address];
+    slave._probing = false;
+    if (++slave._failures < isolate_after)
+        return NO_CHANGE;
+
+    slave._backoff_ms = slave._backoff_ms == 0 ? min_backoff_ms : std::min(slave._backoff_ms * 2, max_backoff_ms);
+    slave._until = now + std::chrono::milliseconds(slave._backoff_ms);
+    return ISOLATED;
+}
+
+int Bus_Scheduler::backoff_ms(int server_address) const
+{
+    return _slaves.value(server_address, Slave{0, 0, Clock::time_point(), false})._backoff_ms;
+}
+
+bool Bus_Scheduler::is_isolated(int server_address) const
+{
+    return _slaves.contains(server_address) && _slaves.value(server_address)._failures >= isolate_after;
+}
+
+int Bus_Scheduler::isolated_count() const
+{
+    int count = 0;
+    for (const Slave& slave: _slaves)
+        if (slave._failures >= isolate_after)
+            ++count;
+    return count;
+}
+
+Bus_Scheduler::Clock::duration Bus_Scheduler::next_probe(Clock::time_point now) const
+{
+    Clock::duration next = Clock::duration::max();
+    for (const Slave& slave: _slaves)
+        if (slave._failures >= isolate_after && !slave._probing)
+            next = std::min(next, std::max(slave._until - now, Clock::duration::zero()));
+    return next == Clock::duration::max() ? Clock::duration::zero() : next;
+}
+
+/*static*/ bool Bus_Scheduler::later(const Entry &a, const Entry &b)
+{
+    if ((a._attempt > 0) != (b._attempt > 0))
+        return a._attempt == 0;
+    if (a._request._priority != b._request._priority)
+        return a._request._priority < b._request._priority;
+    if (a._request._deadline != b._request._deadline)
+        return a._request._deadline > b._request._deadline;
+    return a._seq > b._seq;
+}
+
+} // namespace Modbus_Cli
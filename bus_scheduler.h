@@ -0,0 +1,80 @@
+#ifndef MODBUS_CLI_BUS_SCHEDULER_H
+#define MODBUS_CLI_BUS_SCHEDULER_H
+
+#include <vector>
+
+#include <QHash>
+
+#include "request.h"
+
+namespace Modbus_Cli {
+
+/*
+ * Requests waiting for the line and health of the slaves on it.
+ * Retries go first, then higher priority, then earlier deadline, then arrival order.
+ * A slave that didn't answer isolate_after requests in a row is isolated: its requests
+ * are skipped for a back-off period, then one probe request is let through.
+ * Every failed probe doubles the back-off up to max_backoff_ms.
+ */
+class Bus_Scheduler
+{
+public:
+    using Clock = Request::Clock;
+
+    enum Health_Change {
+        NO_CHANGE,
+        ISOLATED,
+        RECOVERED
+    };
+
+    static const int isolate_after = 3;
+    static const int min_backoff_ms = 1000;
+    static const int max_backoff_ms = 60000;
+
+    Bus_Scheduler();
+
+    void push(const Request& request, int attempt = 0);
+    /// Takes the most urgent request. Returns false if there are none.
+    bool pop(Request& request, int& attempt);
+
+    int size() const;
+    bool is_empty() const;
+
+    /// Whether a request to the slave may go to the line now. Marks the probe of isolated slave as sent.
+    bool admit(int server_address, Clock::time_point now);
+    /// Result of a request to the slave: answered, even with exception, or timed out
+    Health_Change report(int server_address, bool answered, Clock::time_point now);
+    int backoff_ms(int server_address) const;
+    /// Isolated slave gets its probe without retries
+    bool is_isolated(int server_address) const;
+
+    int isolated_count() const;
+    /// Time until any isolated slave may be probed
+    Clock::duration next_probe(Clock::time_point now) const;
+private:
+    struct Entry
+    {
+        Request _request;
+        int _attempt;
+        quint64 _seq;
+    };
+
+    struct Slave
+    {
+        int _failures;
+        int _backoff_ms;
+        Clock::time_point _until;
+        bool _probing;
+    };
+
+    /// Heap order, true if a goes to the line after b
+    static bool later(const Entry& a, const Entry& b);
+
+    std::vector<Entry> _heap;
+    quint64 _seq;
+    QHash<int, Slave> _slaves;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_BUS_SCHEDULER_H
@@ -0,0 +1,311 @@
+#include <QMetaEnum>
+#include <QDebug>
+
+#include "batch_runner.h"
+#include "protocol.h"
+#include "cache_daemon.h"
+
+namespace Modbus_Cli {
+
+namespace {
+
+QString join_values(const QVector<quint16>& values, int from, int count)
+{
+    QStringList items;
+    for (int i = from; i < from + count && i < values.size(); ++i)
+        items.push_back(QString::number(values.at(i)));
+    return items.join(',');
+}
+
+QString error_text(QModbusDevice::Error error)
+{
+    return QString("error ") + QMetaEnum::fromType<QModbusDevice::Error>().valueToKey(error);
+}
+
+} // namespace
+
+Cache_Daemon::Cache_Daemon(const QString &conn_string, const Job &job, const QString &socket_path, qint64 max_age_ms,
+                           QObject *parent) :
+    QObject(parent),
+    _job(job),
+    _socket_path(socket_path),
+    _max_age_ms(max_age_ms),
+    _client(make_client(conn_string, job)),
+    _next_connection(0),
+    _next_id(0)
+{
+    _client->set_print_values(false);
+    _client->set_image(job._image);
+
+    connect(_client.get(), &Client::connected, this, &Cache_Daemon::on_connected);
+    connect(_client.get(), &Client::data_received, this, &Cache_Daemon::data_received);
+    connect(_client.get(), &Client::request_failed, this, &Cache_Daemon::request_failed);
+    connect(_client.get(), &Client::finished, this, &Cache_Daemon::request_finished);
+    connect(&_server, &QLocalServer::newConnection, this, &Cache_Daemon::new_connection);
+}
+
+bool Cache_Daemon::start()
+{
+    QLocalServer::removeServer(_socket_path); // Left by a previous run
+    if (!_server.listen(_socket_path))
+    {
+        qCritical().noquote() << "Can't listen on" << _socket_path << _server.errorString();
+        return false;
+    }
+
+    _client->connect_device();
+    return true;
+}
+
+void Cache_Daemon::new_connection()
+{
+    while (QLocalSocket* socket = _server.nextPendingConnection())
+    {
+        const quint64 id = _next_connection++;
+        _connections.insert(id, Connection{socket, QByteArray(), 0, 0, 0, QMap<int, QByteArray>()});
+
+        connect(socket, &QLocalSocket::readyRead, this, [this, id]() { read_socket(id); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, id]()
+        {
+            // Transactions it waits for go on, their answers are dropped
+            auto it = _connections.find(id);
+            if (it != _connections.end())
+            {
+                it.value()._socket->deleteLater();
+                _connections.erase(it);
+            }
+        });
+    }
+}
+
+void Cache_Daemon::on_connected()
+{
+    dispatch();
+}
+
+void Cache_Daemon::read_socket(quint64 connection_id)
+{
+    auto it = _connections.find(connection_id);
+    if (it == _connections.end())
+        return;
+
+    Connection& connection = it.value();
+    connection._buffer.append(connection._socket->readAll());
+
+    int pos = 0;
+    for (int end = connection._buffer.indexOf('\n'); end != -1; end = connection._buffer.indexOf('\n', pos))
+    {
+        handle_line(connection_id, connection, QString::fromUtf8(connection._buffer.constData() + pos, end - pos));
+        pos = end + 1;
+    }
+    connection._buffer.remove(0, pos);
+
+    dispatch();
+}
+
+void Cache_Daemon::handle_line(quint64 connection_id, Connection &connection, const QString &line)
+{
+    ++connection._line_number;
+    const QString text = line.left(line.indexOf('#')).simplified();
+    if (text.isEmpty())
+        return;
+
+    Waiter waiter{connection_id, connection._next_seq++, connection._line_number, 0, 0};
+    QStringList fields = text.split(' ');
+
+    bool ok = true;
+    qint64 max_age_ms = _max_age_ms;
+    if (fields.size() == 6 && fields.at(0).toLower() == "read")
+    {
+        max_age_ms = fields.takeLast().toLongLong(&ok);
+        ok = ok && max_age_ms >= 0;
+    }
+
+    Request request = Request::read(1, QModbusDataUnit::HoldingRegisters, 0, 0);
+    QString error = "bad max age";
+    if (!ok || !Batch_Runner::parse_command(fields, request, error))
+    {
+        answer(waiter, "error " + error);
+        return;
+    }
+
+    waiter._start = request._start;
+    waiter._count = request._count;
+    if (request._kind == Request::READ)
+        handle_read(request, waiter, max_age_ms);
+    else
+        _queue.push_back(Transaction{request, {waiter}});
+}
+
+void Cache_Daemon::handle_read(const Request &request, const Waiter &waiter, qint64 max_age_ms)
+{
+    const int end = request._start + request._count;
+    if (!write_pending(request))
+    {
+        QVector<quint16> values;
+        if (_cache.get(request._server_address, request._type, request._start, request._count, max_age_ms, values))
+        {
+            answer(waiter, "ok " + join_values(values, 0, values.size()));
+            return;
+        }
+
+        // Answer of a read in flight is newer than anything in the cache
+        for (auto it = _in_flight.begin(); it != _in_flight.end(); ++it)
+        {
+            const Request& other = it.value()._request;
+            if (other._kind == Request::READ && other._server_address == request._server_address && other._type == request._type
+                    && other._start <= request._start && end <= other._start + other._count)
+            {
+                it.value()._waiters.push_back(waiter);
+                return;
+            }
+        }
+    }
+
+    // Join an overlapping waiting read unless a write to the range is between them
+    const int limit = max_read_count(request._type);
+    for (int i = _queue.size() - 1; i >= 0; --i)
+    {
+        Request& other = _queue[i]._request;
+        if (other._kind == Request::READ && other._server_address == request._server_address && other._type == request._type)
+        {
+            const int other_end = other._start + other._count;
+            const int start = std::min(other._start, request._start);
+            const int count = std::max(other_end, end) - start;
+            if (request._start <= other_end && other._start <= end && count <= limit)
+            {
+                other._start = start;
+                other._count = count;
+                _queue[i]._waiters.push_back(waiter);
+                return;
+            }
+        }
+        else if (Batch_Runner::conflicts(other, request))
+            break;
+    }
+
+    _queue.push_back(Transaction{request, {waiter}});
+}
+
+bool Cache_Daemon::write_pending(const Request &read) const
+{
+    for (const Transaction& transaction: _queue)
+        if (transaction._request._kind != Request::READ && Batch_Runner::conflicts(transaction._request, read))
+            return true;
+    for (const Transaction& transaction: _in_flight)
+        if (transaction._request._kind != Request::READ && Batch_Runner::conflicts(transaction._request, read))
+            return true;
+    return false;
+}
+
+void Cache_Daemon::dispatch()
+{
+    if (!_client->is_connected())
+    {
+        if (!_queue.isEmpty() && !_client->connect_device())
+            fail_queue("error ConnectionError");
+        return;
+    }
+
+    while (!_queue.isEmpty() && _client->can_send())
+    {
+        for (const Transaction& other: _in_flight)
+            if (Batch_Runner::conflicts(other._request, _queue.first()._request))
+                return;
+
+        Transaction transaction = _queue.takeFirst();
+        transaction._request._id = _next_id++;
+        _in_flight.insert(transaction._request._id, transaction);
+        _client->send(transaction._request);
+    }
+}
+
+void Cache_Daemon::data_received(const Request &request, const QModbusDataUnit &unit, const QModbusResponse &response)
+{
+    auto it = _in_flight.find(request._id);
+    if (it == _in_flight.end())
+        return;
+
+    const Transaction transaction = it.value();
+    _in_flight.erase(it);
+
+    switch (request._kind)
+    {
+    case Request::READ:
+        _cache.put(request._server_address, request._type, unit.startAddress(), unit.values());
+        for (const Waiter& waiter: transaction._waiters)
+            answer(waiter, "ok " + join_values(unit.values(), waiter._start - unit.startAddress(), waiter._count));
+        break;
+    case Request::READ_WRITE:
+        _cache.invalidate(request._server_address, request._type, request._start, request._values.size());
+        _cache.put(request._server_address, request._type, unit.startAddress(), unit.values());
+        for (const Waiter& waiter: transaction._waiters)
+            answer(waiter, "ok " + join_values(unit.values(), 0, unit.valueCount()));
+        break;
+    case Request::WRITE:
+        _cache.invalidate(request._server_address, request._type, request._start, request._values.size());
+        for (const Waiter& waiter: transaction._waiters)
+            answer(waiter, "ok");
+        break;
+    case Request::RAW:
+    {
+        // Can't tell what it changed
+        _cache.clear();
+        QByteArray pdu;
+        pdu.append(static_cast<char>(response.functionCode()));
+        pdu.append(response.data());
+        for (const Waiter& waiter: transaction._waiters)
+            answer(waiter, "ok " + QString::fromLatin1(pdu.toHex()));
+        break;
+    }
+    }
+}
+
+void Cache_Daemon::request_failed(const Request &request, QModbusDevice::Error error)
+{
+    auto it = _in_flight.find(request._id);
+    if (it == _in_flight.end())
+        return;
+
+    const Transaction transaction = it.value();
+    _in_flight.erase(it);
+
+    if (request._kind == Request::RAW)
+        _cache.clear();
+    else if (request._kind != Request::READ)
+        _cache.invalidate(request._server_address, request._type, request._start, request._values.size());
+
+    for (const Waiter& waiter: transaction._waiters)
+        answer(waiter, error_text(error));
+}
+
+void Cache_Daemon::request_finished()
+{
+    if (!_client->is_connected() && _client->pending_count() == 0)
+        fail_queue("error ConnectionError"); // Next command reconnects
+    else
+        dispatch();
+}
+
+void Cache_Daemon::answer(const Waiter &waiter, const QString &text)
+{
+    auto it = _connections.find(waiter._connection);
+    if (it == _connections.end())
+        return;
+
+    Connection& connection = it.value();
+    connection._results.insert(waiter._seq, QString("%1 %2\n").arg(waiter._line).arg(text).toUtf8());
+    while (connection._results.contains(connection._next_output))
+        connection._socket->write(connection._results.take(connection._next_output++));
+}
+
+void Cache_Daemon::fail_queue(const QString &reason)
+{
+    const QList<Transaction> queue = _queue;
+    _queue.clear();
+    for (const Transaction& transaction: queue)
+        for (const Waiter& waiter: transaction._waiters)
+            answer(waiter, reason);
+}
+
+} // namespace Modbus_Cli
@@ -0,0 +1,91 @@
+#ifndef MODBUS_CLI_CACHE_DAEMON_H
+#define MODBUS_CLI_CACHE_DAEMON_H
+
+#include <memory>
+
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QList>
+#include <QMap>
+
+#include "register_cache.h"
+#include "session.h"
+
+namespace Modbus_Cli {
+
+/*
+ * Owns the device connection and serves batch mode commands (see Batch_Runner) from local socket clients.
+ * A read may end with max age in ms: "read <address> <type> <start> <count> [max_age]".
+ * It is answered from the cache if every register was read not earlier than that,
+ * otherwise it joins a read in flight or waiting that covers it, or is merged with a waiting read
+ * of the same slave and type. Writes invalidate the cache and are never reordered with reads they overlap.
+ * Every client gets one answer line per command in its order: "<line> ok [values]" or "<line> error <reason>".
+ */
+class Cache_Daemon : public QObject
+{
+    Q_OBJECT
+public:
+    Cache_Daemon(const QString& conn_string, const Job& job, const QString& socket_path, qint64 max_age_ms,
+                 QObject* parent = nullptr);
+
+    bool start();
+private slots:
+    void new_connection();
+    void on_connected();
+    void data_received(const Request& request, const QModbusDataUnit& unit, const QModbusResponse& response);
+    void request_failed(const Request& request, QModbusDevice::Error error);
+    void request_finished();
+private:
+    struct Connection
+    {
+        QLocalSocket* _socket;
+        QByteArray _buffer;
+        int _line_number;
+        int _next_seq;
+        int _next_output;
+        QMap<int, QByteArray> _results;     ///< Finished out of order, by seq
+    };
+
+    struct Waiter
+    {
+        quint64 _connection;
+        int _seq;
+        int _line;
+        int _start;         ///< Wanted part of the transaction read
+        int _count;
+    };
+
+    /// One device request and everyone waiting for it
+    struct Transaction
+    {
+        Request _request;
+        QVector<Waiter> _waiters;
+    };
+
+    void read_socket(quint64 connection_id);
+    void handle_line(quint64 connection_id, Connection& connection, const QString& line);
+    void handle_read(const Request& request, const Waiter& waiter, qint64 max_age_ms);
+    /// Write in flight or waiting that touches the read range
+    bool write_pending(const Request& read) const;
+    void dispatch();
+    void answer(const Waiter& waiter, const QString& text);
+    void fail_queue(const QString& reason);
+
+    Job _job;
+    QString _socket_path;
+    qint64 _max_age_ms;
+    std::unique_ptr<Client> _client;
+    QLocalServer _server;
+    Register_Cache _cache;
+
+    QHash<quint64, Connection> _connections;
+    quint64 _next_connection;
+
+    QList<Transaction> _queue;
+    QHash<int, Transaction> _in_flight;
+    int _next_id;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_CACHE_DAEMON_H
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "change_filter.h"
+
+namespace Modbus_Cli {
+
+Change_Filter::Change_Filter(int deadband, int keyframe_ms) :
+    _deadband(std::max(deadband, 0)),
+    _keyframe_ms(keyframe_ms)
+{
+    _clock.start();
+}
+
+void Change_Filter::filter(int server_address, QModbusDataUnit::RegisterType type, int start,
+                           const quint16 *values, int count, int deadband, const Emit &emit_run, int slot)
+{
+    if (count <= 0)
+        return;
+
+    const quint64 key = (static_cast<quint64>(server_address & 0xFF) << 40) | (static_cast<quint64>(type & 0xFF) << 32)
+            | (slot >= 0 ? static_cast<quint64>(1) << 48 | static_cast<quint64>(slot)
+                         : (static_cast<quint64>(start & 0xFFFF) << 16) | static_cast<quint64>(count & 0xFFFF));
+    if (!_blocks.contains(key))
+    {
+        _blocks.insert(key, Block{static_cast<int>(_image.size()), false, 0});
+        _image.resize(_image.size() + static_cast<size_t>(count));
+    }
+
+    Block& block = _blocks[key];
+    quint16* last = _image.data() + block._offset;
+    const qint64 now = _clock.elapsed();
+
+    if (!block._valid || (_keyframe_ms > 0 && now >= block._keyframe_at))
+    {
+        std::copy(values, values + count, last);
+        block._valid = true;
+        block._keyframe_at = now + _keyframe_ms;
+        emit_run(start, values, count);
+        return;
+    }
+
+    if (deadband < 0)
+        deadband = _deadband;
+
+    // Mostly nothing changes, memcmp is the fastest way to find that out
+    if (deadband == 0 && memcmp(last, values, static_cast<size_t>(count) * sizeof(quint16)) == 0)
+        return;
+
+    int run_begin = -1;
+    for (int i = 0; i < count; )
+    {
+        if (deadband == 0 && run_begin == -1 && i + 4 <= count)
+        {
+            // Skip four equal values with one compare
+            quint64 old_word, new_word;
+            memcpy(&old_word, last + i, sizeof(old_word));
+            memcpy(&new_word, values + i, sizeof(new_word));
+            if (old_word == new_word)
+            {
+                i += 4;
+                continue;
+            }
+        }
+
+        // The image keeps the last reported value, so a slow drift is reported once it exceeds deadband
+        const bool changed = deadband == 0 ? values[i] != last[i]
+                                           : std::abs(static_cast<int>(values[i]) - static_cast<int>(last[i])) > deadband;
+        if (changed)
+        {
+            last[i] = values[i];
+            if (run_begin == -1)
+                run_begin = i;
+        }
+        else if (run_begin != -1)
+        {
+            emit_run(start + run_begin, values + run_begin, i - run_begin);
+            run_begin = -1;
+        }
+        ++i;
+    }
+
+    if (run_begin != -1)
+        emit_run(start + run_begin, values + run_begin, count - run_begin);
+}
+
+} // namespace Modbus_Cli
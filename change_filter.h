@@ -0,0 +1,48 @@
+#ifndef MODBUS_CLI_CHANGE_FILTER_H
+#define MODBUS_CLI_CHANGE_FILTER_H
+
+#include <functional>
+#include <vector>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QModbusDataUnit>
+
+namespace Modbus_Cli {
+
+/*
+ * Report by exception. Keeps the last reported values of every polled block of one endpoint
+ * in one contiguous image and passes on only registers that changed by more than deadband.
+ * With keyframe_ms > 0 every block is reported in full once per keyframe_ms.
+ */
+class Change_Filter
+{
+public:
+    /// Run of changed registers: first address, values and their count
+    using Emit = std::function<void(int start, const quint16* values, int count)>;
+
+    Change_Filter(int deadband, int keyframe_ms);
+
+    /// Calls emit_run for every run of changed values. Negative deadband means the default one.
+    /// A range whose start varies passes a fixed slot, its values are compared with the last ones of the slot.
+    void filter(int server_address, QModbusDataUnit::RegisterType type, int start,
+                const quint16* values, int count, int deadband, const Emit& emit_run, int slot = -1);
+private:
+    struct Block
+    {
+        int _offset;            ///< Position in _image
+        bool _valid;
+        qint64 _keyframe_at;
+    };
+
+    int _deadband;
+    int _keyframe_ms;
+
+    QHash<quint64, Block> _blocks;
+    std::vector<quint16> _image;
+    QElapsedTimer _clock;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_CHANGE_FILTER_H
@@ -1,4 +1,4 @@
-
+#include <algorithm>
 
 #include <QThread>
 #include <QModbusRtuSerialMaster>
@@ -6,29 +6,90 @@
 #include <QDebug>
 #include <QMetaEnum>
 
+#include "protocol.h"
+#include "stats.h"
+#include "rtu_master.h"
+#include "tcp_master.h"
 #include "client.h"
 
 namespace Modbus_Cli {
 
+namespace {
+
+Device* make_device(const Das::Modbus::Config& config)
+{
+    if (!config._tcp._address.isEmpty())
+    {
+        if (config._tcp._epoll_engine)
+            return new Tcp_Master(config);
+        return new Qt_Device(new QModbusTcpClient, config);
+    }
+    if (config._rtu._native_driver)
+        return new Rtu_Master(config);
+    return new Qt_Device(new QModbusRtuSerialMaster, config);
+}
+
+} // namespace
+
+const int Client::min_reconnect_ms;
+
 Client::Client(const QString &conn_string, int timeout, int number_of_retries, bool quiet) :
 	_quiet(quiet),
-	_config(conn_string, timeout, number_of_retries)
+    _print_values(true),
+    _conn_string(conn_string),
+    _writer(nullptr),
+    _image(nullptr),
+    _decoder(nullptr),
+    _capture(nullptr),
+    _capture_endpoint(0),
+    _next_transaction(0),
+	_config(conn_string, timeout, number_of_retries),
+    _metrics(conn_string),
+    _frame_overhead(_config._tcp._address.isEmpty() ? 3 : 7),
+    _connect_attempts(0),
+    _dev_name(conn_string),
+    _reconnect_max_ms(0),
+    _reconnect_delay_ms(0),
+    _standby_delay_ms(0),
+    _window(1),
+    _adaptive_timeout(false),
+    _min_timeout(0),
+    _last_latency_us(0),
+    _next_split(0),
+    _skipped(0),
+    _consecutive_skips(0)
 {
-    if (_config._tcp._address.isEmpty())
-        _dev = std::make_shared<QModbusRtuSerialMaster>();
-    else
-        _dev = std::make_shared<QModbusTcpClient>();
+    _dev.reset(make_device(_config));
+    connect(_dev.get(), &Device::error_occurred, this, &Client::error_occurred);
+    connect(_dev.get(), &Device::state_changed, this, &Client::state_changed);
 
-    connect(_dev.get(), &QModbusClient::errorOccurred, this, &Client::error_occurred);
-    connect(_dev.get(), &QModbusClient::stateChanged, this, &Client::state_changed);
+    connect(&_line_timer, &QTimer::timeout, this, &Client::dispatch_next);
+    _line_timer.setSingleShot(true);
 
     connect(&_timer, &QTimer::timeout, this, &Client::timeout);
     _timer.setSingleShot(true);
     _timer.setInterval(10000);
+
+    connect(&_reconnect_timer, &QTimer::timeout, this, &Client::reconnect);
+    _reconnect_timer.setSingleShot(true);
+    connect(&_standby_timer, &QTimer::timeout, this, &Client::connect_standby);
+    _standby_timer.setSingleShot(true);
+}
+
+Client::~Client()
+{
+    // Devices report state while they are destroyed, after the members they would touch
+    _dev->disconnect(this);
+    if (_standby)
+        _standby->disconnect(this);
 }
 
 bool Client::connect_device()
 {
+    if (is_resilient() && _reconnect_timer.isActive())
+        return true; // Attempt is scheduled, connected() follows
+    connect_standby();
+
     if (_dev->state() != QModbusClient::UnconnectedState)
     {
         if (_dev->state() == QModbusClient::ConnectedState)
@@ -39,7 +100,9 @@ bool Client::connect_device()
 	if (!_quiet)
     {
         auto dbg = qInfo().noquote() << "Connecting to modbus device:";
-        if (_config._tcp._address.isEmpty())
+        if (_dev_name != _conn_string)
+            dbg << _dev_name;
+        else if (_config._tcp._address.isEmpty())
         {
             dbg << _config._rtu._name
                 << "Speed:" << _config._rtu._baud_rate
@@ -52,69 +115,403 @@ bool Client::connect_device()
             dbg.nospace() << _config._tcp._address << ':' << _config._tcp._port;
     }
 
-    Das::Modbus::Config::set(_config, _dev.get());
+    if (_connect_attempts++ > 0)
+        _metrics.add_reconnect();
     _timer.start();
-    return _dev->connectDevice();
+    if (_dev->connect_device())
+        return true;
+    if (!is_resilient())
+        return false;
+
+    _timer.stop();
+    if (!_quiet)
+        critical() << "Can't connect:" << _dev->error_string();
+    link_lost();
+    return true;
+}
+
+bool Client::is_connected() const
+{
+    return _dev->state() == QModbusClient::ConnectedState;
+}
+
+void Client::set_print_values(bool print_values)
+{
+    _print_values = print_values;
+}
+
+const QString &Client::conn_string() const
+{
+    return _conn_string;
+}
+
+void Client::set_writer(Output_Writer *writer)
+{
+    _writer = writer;
+}
+
+Output_Writer *Client::writer() const
+{
+    return _writer;
+}
+
+void Client::set_image(Register_Image *image)
+{
+    _image = image;
+}
+
+void Client::set_capture(Traffic_Capture *capture)
+{
+    _capture = capture;
+    if (_capture)
+        _capture_endpoint = _capture->add_endpoint(_conn_string);
+}
+
+void Client::set_decoder(const Value_Decoder *decoder)
+{
+    _decoder = decoder;
+}
+
+const Value_Decoder *Client::decoder() const
+{
+    return _decoder;
+}
+
+void Client::set_adaptive_timeout(int min_timeout_ms)
+{
+    _adaptive_timeout = true;
+    _min_timeout = min_timeout_ms;
+}
+
+void Client::set_change_filter(int deadband, int keyframe_ms)
+{
+    _change_filter.reset(new Change_Filter{deadband, keyframe_ms});
+}
+
+Change_Filter *Client::change_filter() const
+{
+    return _change_filter.get();
+}
+
+void Client::set_tag(const QString &tag)
+{
+    _tag = tag;
+}
+
+const QString &Client::tag() const
+{
+    return _tag;
+}
+
+void Client::set_window(int window)
+{
+    _window = _config._tcp._address.isEmpty() ? 1 : std::max(window, 1);
+}
+
+int Client::window() const
+{
+    return _window;
+}
+
+bool Client::can_send() const
+{
+    return pending_count() < _window;
+}
+
+int Client::pending_count() const
+{
+    return _in_flight.size() + _scheduler.size() + _skipped;
+}
+
+qint64 Client::last_latency_us() const
+{
+    return _last_latency_us;
+}
+
+void Client::set_connect_timeout(int timeout_ms)
+{
+    _timer.setInterval(timeout_ms);
+}
+
+void Client::set_reconnect(int max_delay_ms)
+{
+    _reconnect_max_ms = max_delay_ms;
+    _reconnect_delay_ms = _standby_delay_ms = std::min(min_reconnect_ms, max_delay_ms);
+}
+
+void Client::set_standby(const QString &conn_string)
+{
+    if (_standby)
+        _standby->disconnect(this);
+    _standby_name = conn_string;
+    _standby.reset(make_device(Das::Modbus::Config{conn_string, _config._modbus_timeout, _config._modbus_number_of_retries}));
+    connect(_standby.get(), &Device::error_occurred, this, &Client::error_occurred);
+    connect(_standby.get(), &Device::state_changed, this, &Client::state_changed);
+}
+
+Connection_Metrics &Client::metrics()
+{
+    return _metrics;
+}
+
+void Client::send(const Request &request)
+{
+    const QVector<Request> parts = split_request(request);
+    if (parts.isEmpty())
+        _scheduler.push(request);
+    else
+    {
+        const int split_id = _next_split++;
+        QVector<quint16> values(request._kind == Request::WRITE ? 0 : request._count);
+        _splits.insert(split_id, Split{request, values, {}, parts.size(), 0, QModbusDevice::NoError});
+
+        // Pushed in address order and dispatched back to back, as far as the window allows
+        for (Request part: parts)
+        {
+            part._part = split_id;
+            _scheduler.push(part);
+        }
+    }
+    dispatch_next();
 }
 
 void Client::read(int address, QModbusDataUnit::RegisterType type, int start_address, int count)
 {
-    QModbusDataUnit data(type, start_address, count);
-    QModbusReply* reply = _dev->sendReadRequest(data, address);
-    process_reply(reply);
+    send(Request::read(address, type, start_address, count));
 }
 
 void Client::write(int address, QModbusPdu::FunctionCode func, const QByteArray &data)
 {
-    QModbusRequest request{func, data};
-    QModbusReply* reply = _dev->sendRawRequest(request, address);
-    process_reply(reply);
+    send(Request::raw(address, func, data));
 }
 
 void Client::write(int address, QModbusDataUnit::RegisterType type, int start_address, const QVector<quint16> &values)
 {
-	if (!_quiet)
-		qDebug() << "Write:" << values;
-    QModbusDataUnit data(type, start_address, values);
-    QModbusReply* reply = _dev->sendWriteRequest(data, address);
-    process_reply(reply);
+    send(Request::write(address, type, start_address, values));
 }
 
 void Client::readwrite(int address, QModbusDataUnit::RegisterType type, int start_address, int count, const QVector<quint16> &values)
 {
-	if (!_quiet)
-		qDebug() << "Write:" << values;
-    QModbusDataUnit read_data(type, start_address, count);
-    QModbusDataUnit write_data(type, start_address, values);
-    QModbusReply* reply = _dev->sendReadWriteRequest(read_data, write_data, address);
-    process_reply(reply);
+    send(Request::read_write(address, type, start_address, count, values));
+}
+
+void Client::dispatch_next()
+{
+    // Kept while reconnecting
+    while (_in_flight.size() < _window && !_scheduler.is_empty() && (!is_resilient() || is_connected()))
+    {
+        const auto now = std::chrono::steady_clock::now();
+        if (now < _line_free_at)
+        {
+            if (!_line_timer.isActive())
+                _line_timer.start(static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(_line_free_at - now).count()) + 1);
+            break;
+        }
+
+        Request request;
+        int attempt;
+        _scheduler.pop(request, attempt);
+        if (_scheduler.admit(request._server_address, now))
+            dispatch(request, attempt);
+        else
+            skip(request);
+    }
+    _metrics.set_queue_depth(pending_count());
+}
+
+void Client::dispatch(const Request &request, int attempt)
+{
+    _consecutive_skips = 0;
+    if (attempt == 0)
+        Stats::local().add_request();
+    else
+        Stats::local().add_retry();
+    _metrics.add_request(_frame_overhead + request_pdu_size(request), attempt != 0);
+
+    const In_Flight item{request, attempt, std::chrono::steady_clock::now(), _next_transaction++};
+    if (_capture)
+    {
+        const QByteArray pdu = encode_request(request);
+        _capture->add(_capture_endpoint, Traffic_Capture::REQUEST, item._transaction, request._server_address,
+                      pdu.constData(), pdu.size());
+    }
+
+    if (!_quiet && (request._kind == Request::WRITE || request._kind == Request::READ_WRITE))
+        qDebug() << "Write:" << request._values;
+
+    process_reply(_dev->send(request, request_timeout(request._server_address)), item);
+}
+
+void Client::skip(const Request &request)
+{
+    // Failure is delivered from event loop, so callers refilling the window don't recurse.
+    // When nothing but isolated slaves is polled, wait for the first probe instead of spinning.
+    ++_skipped;
+    int delay_ms = 0;
+    if (++_consecutive_skips > _scheduler.isolated_count())
+        delay_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                        _scheduler.next_probe(std::chrono::steady_clock::now())).count());
+
+    QTimer::singleShot(delay_ms, this, [this, request]()
+    {
+        --_skipped;
+        _metrics.set_queue_depth(pending_count());
+        Stats::local().add_error();
+        _metrics.add_error();
+        deliver_failure(request, QModbusDevice::TimeoutError);
+        emit finished();
+    });
+}
+
+int Client::request_timeout(int server_address)
+{
+    return _adaptive_timeout && server_address != 0 ? rtt(server_address).timeout_ms() : _config._modbus_timeout;
+}
+
+Rtt_Estimator &Client::rtt(int server_address)
+{
+    if (!_rtt.contains(server_address))
+        _rtt.insert(server_address, Rtt_Estimator{_min_timeout, _config._modbus_timeout});
+    return _rtt[server_address];
+}
+
+void Client::report_health(int server_address, bool answered)
+{
+    const auto now = std::chrono::steady_clock::now();
+    switch (_scheduler.report(server_address, answered, now))
+    {
+    case Bus_Scheduler::ISOLATED:
+        if (!_quiet)
+            critical() << "Slave" << server_address << "isolated for" << _scheduler.backoff_ms(server_address) << "ms";
+        break;
+    case Bus_Scheduler::RECOVERED:
+        if (!_quiet)
+            critical() << "Slave" << server_address << "answers again";
+        break;
+    case Bus_Scheduler::NO_CHANGE:
+        break;
+    }
 }
 
 void Client::timeout()
 {
 	if (!_quiet)
-		qCritical() << "Connection timeout";
-    emit finished();
+		critical() << "Connection timeout";
+    if (is_resilient())
+    {
+        _dev->disconnect_device();
+        link_lost();
+    }
+    else
+        emit finished();
 }
 
 void Client::error_occurred(QModbusDevice::Error e)
 {
+    if (_standby && sender() == _standby.get())
+    {
+        if (e == QModbusDevice::ConnectionError)
+        {
+            _standby->disconnect_device();
+            schedule_standby();
+        }
+        return;
+    }
+
 	if (!_quiet)
-		qCritical().noquote() << "Occurred:" << e << _dev->errorString();
+		critical() << "Occurred:" << e << _dev->error_string();
     if (e == QModbusDevice::ConnectionError)
     {
-        _dev->disconnectDevice();
-        emit finished();
+        _dev->disconnect_device();
+        if (is_resilient())
+            link_lost();
+        else
+            emit finished();
     }
 }
 
 void Client::state_changed(QModbusDevice::State state)
 {
+    if (_standby && sender() == _standby.get())
+    {
+        if (state == QModbusDevice::ConnectedState)
+            _standby_delay_ms = std::min(min_reconnect_ms, _reconnect_max_ms);
+        else if (state == QModbusDevice::UnconnectedState)
+            schedule_standby();
+        return;
+    }
+
+    _metrics.set_connected(state == QModbusDevice::ConnectedState);
     if (state == QModbusDevice::ConnectedState)
     {
         _timer.stop();
+        _reconnect_delay_ms = std::min(min_reconnect_ms, _reconnect_max_ms);
+        emit connected();
+        dispatch_next();
+    }
+    else if (state == QModbusDevice::UnconnectedState && is_resilient())
+        link_lost();
+}
+
+void Client::link_lost()
+{
+    // Both error and state change report the loss, the second one finds it handled
+    if (_reconnect_timer.isActive() || is_connected())
+        return;
+
+    if (_standby && _standby->state() == QModbusDevice::ConnectedState)
+    {
+        // Standby takes over at once, the lost connection becomes the standby
+        _timer.stop();
+        _dev.swap(_standby);
+        _dev_name.swap(_standby_name);
+        if (!_quiet)
+            critical() << "Switched to" << _dev_name;
+        _metrics.add_reconnect();
+        _metrics.set_connected(true);
+        if (_standby->state() != QModbusDevice::UnconnectedState)
+            _standby->disconnect_device();
+        schedule_standby();
         emit connected();
+        dispatch_next();
+        return;
     }
+
+    _metrics.set_connected(false);
+    if (!_quiet)
+        critical() << "Reconnecting in" << _reconnect_delay_ms << "ms";
+    _reconnect_timer.start(_reconnect_delay_ms);
+    _reconnect_delay_ms = std::min(_reconnect_delay_ms * 2, _reconnect_max_ms);
+}
+
+void Client::reconnect()
+{
+    if (_dev->state() != QModbusDevice::UnconnectedState)
+        _dev->disconnect_device();
+    if (_dev->state() != QModbusDevice::UnconnectedState)
+        link_lost(); // Still closing
+    else
+        connect_device();
+}
+
+void Client::schedule_standby()
+{
+    if (!_standby || _standby_timer.isActive() || _standby->state() != QModbusDevice::UnconnectedState)
+        return;
+    _standby_timer.start(_standby_delay_ms);
+    _standby_delay_ms = std::min(_standby_delay_ms * 2, _reconnect_max_ms);
+}
+
+void Client::connect_standby()
+{
+    if (_standby && _standby->state() == QModbusDevice::UnconnectedState && !_standby_timer.isActive()
+        && !_standby->connect_device())
+        schedule_standby();
+}
+
+bool Client::is_resilient() const
+{
+    return _reconnect_max_ms > 0;
 }
 
 void Client::reply_finished_slot()
@@ -122,48 +519,316 @@ void Client::reply_finished_slot()
     reply_finished(qobject_cast<QModbusReply*>(sender()));
 }
 
-void Client::process_reply(QModbusReply *reply)
+void Client::process_reply(QModbusReply *reply, const In_Flight &item)
 {
     if (reply)
     {
+        _in_flight.insert(reply, item);
         if (reply->isFinished())
             reply_finished(reply);
         else
             connect(reply, &QModbusReply::finished, this, &Client::reply_finished_slot);
     }
-	else if (!_quiet)
-        qCritical().noquote() << tr("Reply error: ") + _dev->errorString();
+    else
+    {
+        if (!_quiet)
+            critical() << tr("Reply error: ") + _dev->error_string();
+        Stats::local().add_error();
+        _metrics.add_error();
+        capture_outcome(item, nullptr);
+        deliver_failure(item._request, _dev->error());
+        emit finished();
+    }
+}
+
+void Client::capture_outcome(const In_Flight &item, QModbusReply *reply)
+{
+    if (!_capture)
+        return;
+
+    const int unit = item._request._server_address;
+    if (reply && (reply->error() == QModbusDevice::NoError || reply->error() == QModbusDevice::ProtocolError))
+    {
+        const QModbusResponse response = reply->rawResult();
+        QByteArray pdu;
+        pdu.reserve(response.size());
+        pdu.append(static_cast<char>(response.functionCode() | (response.isException() ? 0x80 : 0)));
+        pdu.append(response.data());
+        _capture->add(_capture_endpoint, Traffic_Capture::RESPONSE, item._transaction, unit, pdu.constData(), pdu.size());
+    }
+    else
+        _capture->add(_capture_endpoint, reply && reply->error() == QModbusDevice::TimeoutError ? Traffic_Capture::TIMEOUT
+                                                                                               : Traffic_Capture::ERROR,
+                      item._transaction, unit);
 }
 
 void Client::reply_finished(QModbusReply *reply)
 {
+    const In_Flight item = _in_flight.take(reply);
+    const Request& request = item._request;
+    Stats& stats = Stats::local();
+    capture_outcome(item, reply);
+
+    // Lost with the connection before the answer came: sent again when it is back
+    if (is_resilient() && (reply->error() == QModbusDevice::ReplyAbortedError
+                           || reply->error() == QModbusDevice::ConnectionError || reply->error() == QModbusDevice::WriteError))
+    {
+        reply->deleteLater();
+        _scheduler.push(request, item._attempt);
+        dispatch_next();
+        return;
+    }
+
+    if (reply->error() == QModbusDevice::TimeoutError)
+    {
+        stats.add_timeout();
+        _metrics.add_timeout();
+        if (_adaptive_timeout && request._server_address != 0)
+            rtt(request._server_address).backoff();
+
+        // Serial line: a late answer may still come, keep the line silent for a while
+        if (_config._tcp._address.isEmpty())
+            _line_free_at = std::chrono::steady_clock::now() + _config._line_use_timeout;
+
+        if (item._attempt < _config._modbus_number_of_retries && is_connected()
+            && !_scheduler.is_isolated(request._server_address))
+        {
+            reply->deleteLater();
+            _scheduler.push(request, item._attempt + 1);
+            dispatch_next();
+            return;
+        }
+        report_health(request._server_address, false);
+    }
+    else if (reply->error() == QModbusDevice::NoError || reply->error() == QModbusDevice::ProtocolError)
+    {
+        report_health(request._server_address, true);
+
+        const auto latency = std::chrono::steady_clock::now() - item._sent_at;
+        const qint64 latency_us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+        _last_latency_us = latency_us;
+        stats.add_response(latency_us);
+        _metrics.add_response(_frame_overhead + reply->rawResult().size(), latency_us);
+
+        // Karn's rule: answer to a retried request may belong to any of its attempts
+        if (_adaptive_timeout && item._attempt == 0 && request._server_address != 0)
+            rtt(request._server_address).add_sample(latency_us);
+        if (reply->error() == QModbusDevice::ProtocolError)
+        {
+            stats.add_exception(reply->rawResult().exceptionCode());
+            _metrics.add_exception(reply->rawResult().exceptionCode());
+        }
+    }
+
     if (reply->error() != QModbusDevice::NoError)
     {
+        stats.add_error();
+        _metrics.add_error();
 		if (!_quiet)
-			qCritical().noquote() << "Reply error:" << reply->error() << reply->errorString()
-								  << (reply->error() == QModbusDevice::ProtocolError ?
-                                      tr("Mobus exception: 0x%1").arg(reply->rawResult().exceptionCode(), -1, 16) :
-                                      tr("code: 0x%1").arg(reply->error(), -1, 16));
+			critical() << "Reply error:" << reply->error() << reply->errorString()
+                       << (reply->error() == QModbusDevice::ProtocolError ?
+                               tr("Mobus exception: 0x%1").arg(reply->rawResult().exceptionCode(), -1, 16) :
+                               tr("code: 0x%1").arg(reply->error(), -1, 16));
+        deliver_failure(request, reply->error(),
+                        reply->error() == QModbusDevice::ProtocolError ? reply->rawResult().exceptionCode() : 0);
+    }
+    else
+        deliver_data(request, reply->result(), reply->rawResult());
+
+    reply->deleteLater();
+
+    dispatch_next();
+
+    emit finished();
+}
+
+void Client::deliver_data(const Request &request, const QModbusDataUnit &unit, const QModbusResponse &response)
+{
+    publish_image(request, &unit, QModbusDevice::NoError, 0);
+    if (request._part >= 0)
+    {
+        part_finished(request, &unit, QModbusDevice::NoError);
+        return;
     }
+
+    emit data_received(request, unit, response);
+    if (_print_values)
+        print_values(request._server_address, unit, response);
+}
+
+void Client::deliver_failure(const Request &request, QModbusDevice::Error error, int exception_code)
+{
+    publish_image(request, nullptr, error, exception_code);
+    if (request._part >= 0)
+        part_finished(request, nullptr, error);
     else
+        emit request_failed(request, error, exception_code);
+}
+
+void Client::publish_image(const Request &request, const QModbusDataUnit *unit, QModbusDevice::Error error, int exception_code)
+{
+    if (!_image || request._kind != Request::READ || request._server_address == 0)
+        return;
+
+    // Parts of split reads are blocks of their own, reads with a slot keep one block wherever they start
+    const bool relative = request._slot >= 0;
+    const quint64 key = static_cast<quint64>(request._server_address) << 48 | static_cast<quint64>(request._type) << 32
+            | (relative ? static_cast<quint64>(1) << 47 | static_cast<quint64>(request._slot)
+                        : static_cast<quint64>(request._start) << 16 | static_cast<quint64>(request._count));
+    int block = _image_blocks.value(key, -2);
+    if (block == -2)
+    {
+        block = _image->block(_conn_string, request._server_address, request._type, request._start, request._count, relative);
+        _image_blocks.insert(key, block);
+    }
+    if (block < 0)
+        return;
+
+    if (unit)
     {
-        const QModbusDataUnit unit = reply->result();
+        const QVector<quint16> values = unit->values();
+        _image->publish(block, request._start, values.constData(), values.size());
+    }
+    else
+        _image->publish_failure(block, error == QModbusDevice::TimeoutError ? Register_Image::QUALITY_TIMEOUT :
+                                       error == QModbusDevice::ProtocolError ? Register_Image::QUALITY_EXCEPTION :
+                                                                                Register_Image::QUALITY_ERROR,
+                                exception_code);
+}
 
-		if (unit.valueCount() == 1 && _quiet)
-			qInfo() << unit.value(0);
-		else
-		{
-			for (uint i = 0; i < unit.valueCount(); ++i)
-				qInfo() << (unit.startAddress() + i) << "=" << unit.value(i);
+void Client::part_finished(const Request &part, const QModbusDataUnit *unit, QModbusDevice::Error error)
+{
+    if (!_splits.contains(part._part))
+        return;
 
-			QModbusResponse response = reply->rawResult();
-			qDebug() << "Raw response:" << response.data().toHex().toUpper();
-		}
+    Split& split = _splits[part._part];
+    if (unit)
+    {
+        if (part._kind == Request::READ)
+        {
+            const QVector<quint16> values = unit->values();
+            const int offset = part._start - split._request._start;
+            for (int i = 0; i < values.size() && offset + i < split._values.size(); ++i)
+                split._values[offset + i] = values.at(i);
+            split._received.push_back(part);
+        }
+    }
+    else
+    {
+        ++split._failed;
+        split._error = error;
+        if (!_quiet)
+            critical() << "Part failed:" << (part._kind == Request::READ ? "read" : "write")
+                       << part._start << "count" << part._count << "error" << error;
     }
 
-    reply->deleteLater();
+    if (--split._pending > 0)
+        return;
 
-    emit finished();
+    const Split done = _splits.take(part._part);
+    const Request& request = done._request;
+    if (done._failed == 0)
+    {
+        const QModbusDataUnit result(request._type, request._start,
+                                     request._kind == Request::WRITE ? request._values : done._values);
+        emit data_received(request, result, QModbusResponse());
+        if (_print_values)
+            print_values(request._server_address, result, QModbusResponse());
+        return;
+    }
+
+    // Values of the parts that were read are still good
+    if (_print_values)
+        for (const Request& received: done._received)
+            print_values(request._server_address,
+                         QModbusDataUnit(request._type, received._start,
+                                         done._values.mid(received._start - request._start, received._count)),
+                         QModbusResponse());
+
+    if (!_quiet)
+        critical() << "Request failed in" << done._failed << (done._failed == 1 ? "part" : "parts");
+    emit request_failed(request, done._error, 0);
+}
+
+QDebug Client::critical() const
+{
+    QDebug dbg = qCritical().noquote();
+    if (!_tag.isEmpty())
+        dbg << _tag;
+    return dbg;
+}
+
+void Client::print_values(int server_address, const QModbusDataUnit &unit, const QModbusResponse &response) const
+{
+    const QVector<quint16> values = unit.values();
+    auto output_run = [this, server_address, &unit, &values](int start, const quint16* data, int count)
+    {
+        if (_decoder)
+            output_decoded(server_address, unit.registerType(), unit.startAddress(), values.constData(), values.size(),
+                           start, count);
+        else
+            print_run(server_address, unit.registerType(), start, data, count);
+    };
+
+    if (_change_filter)
+        _change_filter->filter(server_address, unit.registerType(), unit.startAddress(), values.constData(), values.size(), -1,
+                               output_run);
+    else
+        output_run(unit.startAddress(), values.constData(), values.size());
+
+    if (!_writer && !(values.size() == 1 && _quiet) && response.isValid())
+        qDebug() << "Raw response:" << response.data().toHex().toUpper();
+}
+
+void Client::output_decoded(int server_address, QModbusDataUnit::RegisterType type, int start, const quint16 *values, int count,
+                            int run_start, int run_count) const
+{
+    if (_writer && _writer->format() == Output_Writer::BINARY)
+    {
+        _writer->write(_conn_string, server_address, type, run_start, values + (run_start - start), run_count);
+        return;
+    }
+
+    _decoder->decode(server_address, type, start, values, count, run_start, run_count,
+                     [this, server_address, type](const Value_Decoder::Value_Field& field, const char* text, int size)
+    {
+        if (_writer)
+            _writer->write_value(_conn_string, server_address, type, field._address, field._name, text, size,
+                                 field._type == Value_Decoder::STRING);
+        else
+        {
+            QDebug info = qInfo().noquote();
+            if (!_tag.isEmpty())
+                info << _tag;
+            info << field._address;
+            if (!field._name.isEmpty())
+                info << field._name;
+            info << "=" << QString::fromUtf8(text, size);
+        }
+    });
+}
+
+void Client::print_run(int server_address, QModbusDataUnit::RegisterType type, int start, const quint16 *values, int count) const
+{
+    if (_writer)
+        _writer->write(_conn_string, server_address, type, start, values, count);
+    else if (count == 1 && _quiet)
+    {
+        if (_tag.isEmpty())
+            qInfo() << values[0];
+        else
+            qInfo().noquote() << _tag << values[0];
+    }
+    else
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            if (_tag.isEmpty())
+                qInfo() << (start + i) << "=" << values[i];
+            else
+                qInfo().noquote() << _tag << (start + i) << "=" << values[i];
+        }
+    }
 }
 
 } // namespace Modbus_Cli
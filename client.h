@@ -2,11 +2,24 @@
 #define MODBUS_CLI_CLIENT_H
 
 #include <memory>
+#include <chrono>
 
 #include <QModbusClient>
 #include <QTimer>
+#include <QHash>
+#include <QDebug>
 
+#include "bus_scheduler.h"
+#include "change_filter.h"
 #include "config.h"
+#include "connection_metrics.h"
+#include "device.h"
+#include "output_writer.h"
+#include "register_image.h"
+#include "request.h"
+#include "rtt_estimator.h"
+#include "traffic_capture.h"
+#include "value_decoder.h"
 
 namespace Modbus_Cli {
 
@@ -14,8 +27,65 @@ class Client : public QObject
 {
     Q_OBJECT
 public:
+    static const int min_reconnect_ms = 50;
+
 	Client(const QString& conn_string, int timeout, int number_of_retries, bool quiet);
+    ~Client();
     bool connect_device();
+    bool is_connected() const;
+
+    void set_print_values(bool print_values);
+
+    const QString& conn_string() const;
+
+    /// Values go to writer instead of log if it is set
+    void set_writer(Output_Writer* writer);
+    Output_Writer* writer() const;
+    /// Every read block is published to image, also with print_values off
+    void set_image(Register_Image* image);
+    /// Every request and its outcome is logged to capture
+    void set_capture(Traffic_Capture* capture);
+    /// Values are output as typed fields of the decoder instead of registers
+    void set_decoder(const Value_Decoder* decoder);
+    const Value_Decoder* decoder() const;
+    /// Outputs decoded fields with registers in the run, values is the whole block read
+    void output_decoded(int server_address, QModbusDataUnit::RegisterType type, int start, const quint16* values, int count,
+                        int run_start, int run_count) const;
+
+    /// Timeout of every slave follows its round trip time, from min_timeout_ms to the configured timeout
+    void set_adaptive_timeout(int min_timeout_ms);
+
+    /// Output only values changed by more than deadband, every block in full once per keyframe_ms
+    void set_change_filter(int deadband, int keyframe_ms);
+    Change_Filter* change_filter() const;
+
+    /// Prefix for output lines, used to tell devices apart
+    void set_tag(const QString& tag);
+    const QString& tag() const;
+
+    /// Maximum number of outstanding requests. Used for Modbus TCP only, RTU is always 1.
+    void set_window(int window);
+    int window() const;
+    bool can_send() const;
+    /// In flight and queued requests count
+    int pending_count() const;
+    /// Round trip of the last answered request
+    qint64 last_latency_us() const;
+    /// Connection attempt fails after it, 10 s by default
+    void set_connect_timeout(int timeout_ms);
+    Connection_Metrics& metrics();
+
+    /// Keeps the connection: a lost or failed one is retried after min_reconnect_ms, doubling up to max_delay_ms,
+    /// requests wait meanwhile and those lost in flight are sent again. finished() is not emitted for connection errors.
+    void set_reconnect(int max_delay_ms);
+    /// Second connection to the same devices, e.g. a redundant gateway, kept open to take over at once
+    /// when the active one fails. Used with set_reconnect().
+    void set_standby(const QString& conn_string);
+
+    /// Dispatched at once if the window allows, otherwise queued by priority and deadline.
+    /// Requests to an isolated slave fail without going to the line.
+    /// Requests over protocol limits are sent in parts and reported as one.
+    void send(const Request& request);
 
     void read(int address, QModbusDataUnit::RegisterType type, int start_address, int count);
 
@@ -25,19 +95,102 @@ public:
     void readwrite(int address, QModbusDataUnit::RegisterType type, int start_address, int count, const QVector<quint16>& values);
 signals:
     void connected();
+    /// Response is invalid for results assembled from parts
+    void data_received(const Request& request, const QModbusDataUnit& unit, const QModbusResponse& response);
+    /// exception_code is the Modbus exception of ProtocolError, 0 otherwise or for split requests
+    void request_failed(const Request& request, QModbusDevice::Error error, int exception_code);
     void finished();
 private slots:
     void timeout();
     void error_occurred(QModbusDevice::Error e);
     void state_changed(QModbusDevice::State state);
     void reply_finished_slot();
+    void dispatch_next();
+    void reconnect();
+    void connect_standby();
 private:
-    void process_reply(QModbusReply* reply);
+    struct In_Flight
+    {
+        Request _request;
+        int _attempt;
+        std::chrono::steady_clock::time_point _sent_at;
+        quint32 _transaction;       ///< Capture transaction
+    };
+
+    /// Oversized request in progress
+    struct Split
+    {
+        Request _request;
+        QVector<quint16> _values;       ///< Read values in address order
+        QVector<Request> _received;     ///< Read parts that succeeded
+        int _pending;
+        int _failed;
+        QModbusDevice::Error _error;
+    };
+
+    void dispatch(const Request& request, int attempt = 0);
+    void deliver_data(const Request& request, const QModbusDataUnit& unit, const QModbusResponse& response);
+    void deliver_failure(const Request& request, QModbusDevice::Error error, int exception_code = 0);
+    void publish_image(const Request& request, const QModbusDataUnit* unit, QModbusDevice::Error error, int exception_code);
+    void part_finished(const Request& part, const QModbusDataUnit* unit, QModbusDevice::Error error);
+    void skip(const Request& request);
+    /// Active connection is gone: switch to the standby or reconnect later
+    void link_lost();
+    void schedule_standby();
+    bool is_resilient() const;
+    void report_health(int server_address, bool answered);
+    int request_timeout(int server_address);
+    Rtt_Estimator& rtt(int server_address);
+    void process_reply(QModbusReply* reply, const In_Flight& item);
+    void capture_outcome(const In_Flight& item, QModbusReply* reply);
     void reply_finished(QModbusReply* reply);
+    QDebug critical() const;
+    void print_values(int server_address, const QModbusDataUnit& unit, const QModbusResponse& response) const;
+    void print_run(int server_address, QModbusDataUnit::RegisterType type, int start, const quint16* values, int count) const;
 
 	bool _quiet;
+    bool _print_values;
+    QString _conn_string;
+    Output_Writer* _writer;
+    Register_Image* _image;
+    QHash<quint64, int> _image_blocks;  ///< Image block of every read range or slot, -1 if it didn't fit
+    const Value_Decoder* _decoder;
+    Traffic_Capture* _capture;
+    int _capture_endpoint;
+    quint32 _next_transaction;
+    std::unique_ptr<Change_Filter> _change_filter;
+    QString _tag;
     Das::Modbus::Config _config;
-    std::shared_ptr<QModbusClient> _dev;
+    std::unique_ptr<Device> _dev;
+    Connection_Metrics _metrics;
+    int _frame_overhead;        ///< ADU bytes around PDU
+    int _connect_attempts;
+
+    QString _dev_name;          ///< Connection string of _dev, differs from _conn_string after a switch to standby
+    std::unique_ptr<Device> _standby;
+    QString _standby_name;
+    int _reconnect_max_ms;      ///< 0 if connection errors are reported instead
+    int _reconnect_delay_ms;
+    int _standby_delay_ms;
+    QTimer _reconnect_timer;
+    QTimer _standby_timer;
+
+    int _window;
+    QHash<QModbusReply*, In_Flight> _in_flight;
+    bool _adaptive_timeout;
+    int _min_timeout;
+    qint64 _last_latency_us;
+    QHash<int, Rtt_Estimator> _rtt;
+
+    Bus_Scheduler _scheduler;
+    QHash<int, Split> _splits;
+    int _next_split;
+    int _skipped;               ///< Failures of skipped requests not delivered yet
+    int _consecutive_skips;
+
+    /// Nothing is sent before this time. After a timeout a late answer may still be on the line.
+    std::chrono::steady_clock::time_point _line_free_at;
+    QTimer _line_timer;
 
     QTimer _timer;
 };
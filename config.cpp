@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include <QModbusRtuSerialMaster>
 #include <QModbusTcpClient>
 #include <QSerialPortInfo>
@@ -39,12 +41,12 @@ Rtu_Config::Rtu_Config(const QString &port_name, QSerialPort::BaudRate speed, QS
                        QSerialPort::Parity parity, QSerialPort::StopBits stop_bits, QSerialPort::FlowControl flow_control,
                        int frame_delay_mcs) :
     _name{port_name}, _baud_rate{speed}, _data_bits{bits_num}, _parity{parity}, _stop_bits{stop_bits},
-    _flow_control{flow_control}, _frame_delay_microseconds{frame_delay_mcs}
+    _flow_control{flow_control}, _frame_delay_microseconds{frame_delay_mcs}, _native_driver{false}
 {
 }
 
 Rtu_Config::Rtu_Config(const QString &address, int frame_delay_mcs) : // rtu:///dev/ttyUSB0?baudRate=4200&stopBit=1
-    _frame_delay_microseconds(frame_delay_mcs)
+    _frame_delay_microseconds(frame_delay_mcs), _native_driver(false)
 {
     QUrl url{address};
     if (!url.isValid() || url.scheme().toLower() != "rtu")
@@ -58,6 +60,8 @@ Rtu_Config::Rtu_Config(const QString &address, int frame_delay_mcs) : // rtu:///
     _parity = get_query_value(q, "parity", QSerialPort::NoParity);
     _stop_bits = get_query_value(q, "stopBits", QSerialPort::OneStop);
     _flow_control = get_query_value(q, "flowControl", QSerialPort::NoFlowControl);
+    _frame_delay_microseconds = get_query_value(q, "frameDelay", _frame_delay_microseconds);
+    _native_driver = q.queryItemValue("driver").toLower() == "native";
 }
 
 /*static*/ QStringList Rtu_Config::available_ports()
@@ -82,7 +86,8 @@ Rtu_Config::Rtu_Config(const QString &address, int frame_delay_mcs) : // rtu:///
 
 // --------------------
 
-Tcp_Config::Tcp_Config(const QString &address)
+Tcp_Config::Tcp_Config(const QString &address) :
+    _port(0), _epoll_engine(false), _keepalive_s(0)
 {
     QUrl url{address};
     if (!url.isValid() || url.scheme().toLower() != "mtcp")
@@ -90,6 +95,9 @@ Tcp_Config::Tcp_Config(const QString &address)
 
     _address = url.host();
     _port = url.port();
+    const QUrlQuery query{url};
+    _epoll_engine = query.queryItemValue("engine").toLower() == "epoll";
+    _keepalive_s = std::max(query.queryItemValue("keepalive").toInt(), 0);
 
     if (_address == "example.com")
         _address.clear();
@@ -103,6 +111,8 @@ Tcp_Config::Tcp_Config(const QString &address)
 
 // --------------------
 
+const int Config::default_turnaround_ms;
+
 Config::Config(const QString &address, const QString& port_name, QSerialPort::BaudRate speed, QSerialPort::DataBits bits_num, QSerialPort::Parity parity,
                QSerialPort::StopBits stop_bits, QSerialPort::FlowControl flow_control, int modbus_timeout, int modbus_number_of_retries,
                int frame_delay_microseconds, int line_use_timeout) :
@@ -111,7 +121,8 @@ Config::Config(const QString &address, const QString& port_name, QSerialPort::Ba
 
     _modbus_timeout(modbus_timeout),
     _modbus_number_of_retries(modbus_number_of_retries),
-    _line_use_timeout(line_use_timeout)
+    _line_use_timeout(line_use_timeout),
+    _turnaround(default_turnaround_ms)
 {
 }
 
@@ -120,7 +131,8 @@ Config::Config(const QString &address, int modbus_timeout, int modbus_number_of_
     _tcp{address}, _rtu{address, frame_delay_microseconds},
     _modbus_timeout(modbus_timeout),
     _modbus_number_of_retries(modbus_number_of_retries),
-    _line_use_timeout(line_use_timeout)
+    _line_use_timeout(get_query_value(QUrlQuery{QUrl{address}}, "lineUseTimeout", line_use_timeout)),
+    _turnaround(get_query_value(QUrlQuery{QUrl{address}}, "lineUseTimeout", default_turnaround_ms))
 {
 }
 
@@ -128,7 +140,10 @@ Config::Config(const QString &address, int modbus_timeout, int modbus_number_of_
 {
     auto rtu = qobject_cast<QModbusRtuSerialMaster*>(device);
     if (rtu)
+    {
         Rtu_Config::set(config._rtu, rtu);
+        rtu->setTurnaroundDelay(static_cast<int>(config._turnaround.count()));
+    }
     else
     {
         auto tcp = qobject_cast<QModbusTcpClient*>(device);
@@ -30,6 +30,7 @@ struct Rtu_Config
     QSerialPort::FlowControl _flow_control;   ///< Управление потоком. По умолчанию нет
 
     int _frame_delay_microseconds;
+    bool _native_driver;    ///< Собственный драйвер на termios вместо QModbusRtuSerialMaster. driver=native
 
     /*static QString firstPort() {
         return QSerialPortInfo::availablePorts().count() ? QSerialPortInfo::availablePorts().first().portName() : QString();
@@ -49,6 +50,8 @@ struct Tcp_Config
 
     QString _address;
     quint16 _port;
+    bool _epoll_engine;     ///< Собственный движок на epoll вместо QModbusTcpClient. engine=epoll
+    int _keepalive_s;       ///< Обрыв соединения замечается через столько секунд тишины, 0 - по умолчанию ОС. keepalive=2
 };
 
 struct Config {
@@ -69,12 +72,15 @@ struct Config {
 
     static void set(const Config& config, QModbusClient* device);
 
+    static const int default_turnaround_ms = 100;
+
     Tcp_Config _tcp;
     Rtu_Config _rtu;
 
     int _modbus_timeout;
     int _modbus_number_of_retries;
-    std::chrono::milliseconds _line_use_timeout;
+    std::chrono::milliseconds _line_use_timeout;   ///< Тишина на линии после таймаута. lineUseTimeout=50
+    std::chrono::milliseconds _turnaround;         ///< Тишина после широковещательной записи: lineUseTimeout, если задан, иначе 100 как в Qt
 };
 
 } // namespace Modbus
@@ -0,0 +1,181 @@
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+#include "stats.h"
+#include "connection_metrics.h"
+
+namespace Modbus_Cli {
+
+namespace {
+
+struct Registry
+{
+    std::mutex _mutex;
+    std::vector<const Connection_Metrics*> _live;
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+QByteArray make_label(const QString& endpoint)
+{
+    QByteArray value = endpoint.toUtf8();
+    value.replace("\\", "\\\\").replace("\"", "\\\"").replace("\n", "\\n");
+    return "endpoint=\"" + value + '"';
+}
+
+void append_header(QByteArray& out, const char* name, const char* type, const char* help)
+{
+    out.append("# HELP ").append(name).append(' ').append(help).append('\n');
+    out.append("# TYPE ").append(name).append(' ').append(type).append('\n');
+}
+
+void append_sample(QByteArray& out, const char* name, const QByteArray& labels, const QByteArray& value)
+{
+    out.append(name).append('{').append(labels).append("} ").append(value).append('\n');
+}
+
+} // namespace
+
+const quint64 Connection_Metrics::bucket_bounds_us[bucket_count - 1] = {
+    500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 200000, 500000, 1000000, 2000000, 5000000
+};
+
+Connection_Metrics::Connection_Metrics(const QString &endpoint) :
+    _label(make_label(endpoint)),
+    _requests{0}, _retries{0}, _responses{0}, _timeouts{0}, _errors{0},
+    _bytes_out{0}, _bytes_in{0}, _reconnects{0}, _queue_depth{0}, _connected{0}, _latency_sum_us{0},
+    _missed{0}, _overruns{0}
+{
+    for (std::atomic<quint64>& counter: _buckets)
+        counter.store(0, std::memory_order_relaxed);
+    for (std::atomic<quint64>& counter: _exceptions)
+        counter.store(0, std::memory_order_relaxed);
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg._mutex);
+    reg._live.push_back(this);
+}
+
+Connection_Metrics::~Connection_Metrics()
+{
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg._mutex);
+    reg._live.erase(std::remove(reg._live.begin(), reg._live.end(), this), reg._live.end());
+}
+
+void Connection_Metrics::add_request(int bytes, bool retry)
+{
+    add(retry ? _retries : _requests);
+    add(_bytes_out, bytes);
+}
+
+void Connection_Metrics::add_response(int bytes, quint64 latency_us)
+{
+    add(_responses);
+    add(_bytes_in, bytes);
+    add(_latency_sum_us, latency_us);
+    const quint64* bound = std::lower_bound(bucket_bounds_us, bucket_bounds_us + bucket_count - 1, latency_us);
+    add(_buckets[bound - bucket_bounds_us]);
+}
+
+void Connection_Metrics::add_timeout() { add(_timeouts); }
+void Connection_Metrics::add_error() { add(_errors); }
+void Connection_Metrics::add_reconnect() { add(_reconnects); }
+
+void Connection_Metrics::add_missed(quint64 count) { add(_missed, count); }
+void Connection_Metrics::add_overrun() { add(_overruns); }
+
+void Connection_Metrics::add_exception(int code)
+{
+    add(_exceptions[code & 0xFF]);
+}
+
+void Connection_Metrics::set_queue_depth(int depth)
+{
+    _queue_depth.store(depth, std::memory_order_relaxed);
+}
+
+void Connection_Metrics::set_connected(bool connected)
+{
+    _connected.store(connected ? 1 : 0, std::memory_order_relaxed);
+}
+
+/*static*/ QByteArray Connection_Metrics::exposition()
+{
+    struct Counter
+    {
+        const char* _name;
+        const char* _type;
+        const char* _help;
+        std::atomic<quint64> Connection_Metrics::* _member;
+    };
+    static const Counter counters[] = {
+        { "modbus_requests_total", "counter", "Requests sent, retries excluded", &Connection_Metrics::_requests },
+        { "modbus_retries_total", "counter", "Requests sent again after a response timeout", &Connection_Metrics::_retries },
+        { "modbus_responses_total", "counter", "Replies received, exceptions included", &Connection_Metrics::_responses },
+        { "modbus_timeouts_total", "counter", "Response timeouts", &Connection_Metrics::_timeouts },
+        { "modbus_errors_total", "counter", "Requests failed for any reason", &Connection_Metrics::_errors },
+        { "modbus_sent_bytes_total", "counter", "ADU bytes sent", &Connection_Metrics::_bytes_out },
+        { "modbus_received_bytes_total", "counter", "ADU bytes received", &Connection_Metrics::_bytes_in },
+        { "modbus_reconnects_total", "counter", "Connection attempts after the first one", &Connection_Metrics::_reconnects },
+        { "modbus_scan_missed_total", "counter", "Scan cycles skipped because the previous read still ran", &Connection_Metrics::_missed },
+        { "modbus_scan_overruns_total", "counter", "Scan reads finished after the next cycle was due", &Connection_Metrics::_overruns },
+        { "modbus_queue_depth", "gauge", "Requests in flight and waiting", &Connection_Metrics::_queue_depth },
+        { "modbus_connected", "gauge", "1 if the device is connected", &Connection_Metrics::_connected }
+    };
+
+    QByteArray out;
+    append_header(out, "modbus_uptime_seconds", "gauge", "Seconds since program start");
+    out.append("modbus_uptime_seconds ").append(QByteArray::number(Stats::uptime_seconds(), 'f', 3)).append('\n');
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg._mutex);
+
+    for (const Counter& counter: counters)
+    {
+        append_header(out, counter._name, counter._type, counter._help);
+        for (const Connection_Metrics* metrics: reg._live)
+            append_sample(out, counter._name, metrics->_label, QByteArray::number(get(metrics->*counter._member)));
+    }
+
+    append_header(out, "modbus_exceptions_total", "counter", "Modbus exception replies by exception code");
+    for (const Connection_Metrics* metrics: reg._live)
+        for (int code = 0; code < exception_count; ++code)
+            if (const quint64 count = get(metrics->_exceptions[code]))
+                append_sample(out, "modbus_exceptions_total", metrics->_label + ",code=\"" + QByteArray::number(code) + '"',
+                              QByteArray::number(count));
+
+    append_header(out, "modbus_latency_seconds", "histogram", "Time from request to reply");
+    for (const Connection_Metrics* metrics: reg._live)
+    {
+        quint64 cumulative = 0;
+        for (int i = 0; i < bucket_count; ++i)
+        {
+            cumulative += get(metrics->_buckets[i]);
+            const QByteArray le = i < bucket_count - 1 ? QByteArray::number(bucket_bounds_us[i] / 1e6, 'g', 6) : "+Inf";
+            append_sample(out, "modbus_latency_seconds_bucket", metrics->_label + ",le=\"" + le + '"',
+                          QByteArray::number(cumulative));
+        }
+        append_sample(out, "modbus_latency_seconds_sum", metrics->_label,
+                      QByteArray::number(get(metrics->_latency_sum_us) / 1e6, 'f', 6));
+        append_sample(out, "modbus_latency_seconds_count", metrics->_label, QByteArray::number(cumulative));
+    }
+    return out;
+}
+
+/*static*/ void Connection_Metrics::add(std::atomic<quint64> &counter, quint64 value)
+{
+    counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+/*static*/ quint64 Connection_Metrics::get(const std::atomic<quint64> &counter)
+{
+    return counter.load(std::memory_order_relaxed);
+}
+
+} // namespace Modbus_Cli
@@ -0,0 +1,71 @@
+#ifndef MODBUS_CLI_CONNECTION_METRICS_H
+#define MODBUS_CLI_CONNECTION_METRICS_H
+
+#include <atomic>
+
+#include <QByteArray>
+#include <QString>
+
+namespace Modbus_Cli {
+
+/*
+ * Counters of one device connection, updated by its Client only and read from any thread.
+ * Every update is one relaxed atomic add, so they stay on in the hot path.
+ * Live instances are registered, exposition() writes all of them in Prometheus text format.
+ */
+class Connection_Metrics
+{
+public:
+    static const int exception_count = 256;
+    static const int bucket_count = 14;
+    /// Upper bounds of latency buckets, us. The last bucket is +Inf.
+    static const quint64 bucket_bounds_us[bucket_count - 1];
+
+    explicit Connection_Metrics(const QString& endpoint);
+    ~Connection_Metrics();
+
+    Connection_Metrics(const Connection_Metrics&) = delete;
+    Connection_Metrics& operator=(const Connection_Metrics&) = delete;
+
+    /// Sent, with ADU size in bytes
+    void add_request(int bytes, bool retry);
+    /// Reply received, microseconds since request was sent
+    void add_response(int bytes, quint64 latency_us);
+    void add_timeout();
+    void add_error();
+    void add_exception(int code);
+    void add_reconnect();
+    void set_queue_depth(int depth);
+    void set_connected(bool connected);
+    /// Scan cycles skipped and finished after the next one was due, see Scan_Poller
+    void add_missed(quint64 count);
+    void add_overrun();
+
+    /// Prometheus text format of every live connection
+    static QByteArray exposition();
+private:
+    static void add(std::atomic<quint64>& counter, quint64 value = 1);
+    static quint64 get(const std::atomic<quint64>& counter);
+
+    const QByteArray _label;    ///< endpoint="..." escaped
+
+    std::atomic<quint64> _requests;
+    std::atomic<quint64> _retries;
+    std::atomic<quint64> _responses;
+    std::atomic<quint64> _timeouts;
+    std::atomic<quint64> _errors;
+    std::atomic<quint64> _bytes_out;
+    std::atomic<quint64> _bytes_in;
+    std::atomic<quint64> _reconnects;
+    std::atomic<quint64> _queue_depth;
+    std::atomic<quint64> _connected;
+    std::atomic<quint64> _latency_sum_us;
+    std::atomic<quint64> _missed;
+    std::atomic<quint64> _overruns;
+    std::atomic<quint64> _buckets[bucket_count];   ///< Not cumulative, added up in exposition
+    std::atomic<quint64> _exceptions[exception_count];
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_CONNECTION_METRICS_H
@@ -0,0 +1,47 @@
+#include "crc16.h"
+
+namespace Modbus_Cli {
+
+namespace {
+
+/// Slicing-by-8 tables: _table[k][i] is CRC of byte i followed by k zero bytes
+struct Crc_Table
+{
+    Crc_Table()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            quint16 crc = static_cast<quint16>(i);
+            for (int bit = 0; bit < 8; ++bit)
+                crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+            _table[0][i] = crc;
+        }
+
+        for (int k = 1; k < 8; ++k)
+            for (int i = 0; i < 256; ++i)
+                _table[k][i] = (_table[k - 1][i] >> 8) ^ _table[0][_table[k - 1][i] & 0xFF];
+    }
+
+    quint16 _table[8][256];
+};
+
+const Crc_Table crc_table;
+
+} // namespace
+
+quint16 crc16(const quint8 *data, int size)
+{
+    const quint16 (&t)[8][256] = crc_table._table;
+    quint16 crc = 0xFFFF;
+
+    // Eight independent lookups per step instead of a dependency chain of eight
+    for (; size >= 8; data += 8, size -= 8)
+        crc = t[7][(data[0] ^ crc) & 0xFF] ^ t[6][(data[1] ^ (crc >> 8)) & 0xFF]
+            ^ t[5][data[2]] ^ t[4][data[3]] ^ t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+
+    for (; size > 0; ++data, --size)
+        crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xFF];
+    return crc;
+}
+
+} // namespace Modbus_Cli
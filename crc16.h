@@ -0,0 +1,13 @@
+#ifndef MODBUS_CLI_CRC16_H
+#define MODBUS_CLI_CRC16_H
+
+#include <QtGlobal>
+
+namespace Modbus_Cli {
+
+/// Modbus RTU CRC-16 (poly 0xA001, init 0xFFFF). Low byte is sent first.
+quint16 crc16(const quint8* data, int size);
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_CRC16_H
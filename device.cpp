@@ -0,0 +1,99 @@
+#include <QTcpSocket>
+
+#include "protocol.h"
+#include "tcp_master.h"
+#include "device.h"
+
+namespace Modbus_Cli {
+
+/*static*/ void Device::finish_reply(QModbusReply *reply, const Request &request, const QByteArray &pdu)
+{
+    const QModbusResponse response(static_cast<QModbusPdu::FunctionCode>(static_cast<quint8>(pdu.at(0))), pdu.mid(1));
+    reply->setRawResult(response);
+
+    if (response.isException())
+    {
+        reply->setError(QModbusDevice::ProtocolError,
+                        tr("Modbus exception response 0x%1").arg(response.exceptionCode(), -1, 16));
+        return;
+    }
+
+    if (request._kind != Request::RAW)
+    {
+        QModbusDataUnit unit;
+        if (!decode_response(request, pdu, unit))
+        {
+            reply->setError(QModbusDevice::UnknownError, tr("Invalid response"));
+            return;
+        }
+        reply->setResult(unit);
+    }
+    reply->setFinished(true);
+}
+
+Qt_Device::Qt_Device(QModbusClient *dev, const Das::Modbus::Config &config, QObject *parent) :
+    Device(parent),
+    _dev(dev),
+    _config(config)
+{
+    if (_config._tcp._keepalive_s > 0)
+        connect(_dev.get(), &QModbusClient::stateChanged, this, [this](QModbusDevice::State state)
+        {
+            // QModbusTcpClient doesn't give its socket away, but owns it as a child
+            QTcpSocket* socket = state == QModbusDevice::ConnectedState ? _dev->findChild<QTcpSocket*>() : nullptr;
+            if (socket)
+                Tcp_Master::set_keepalive(static_cast<int>(socket->socketDescriptor()), _config._tcp._keepalive_s);
+        });
+    connect(_dev.get(), &QModbusClient::errorOccurred, this, &Device::error_occurred);
+    connect(_dev.get(), &QModbusClient::stateChanged, this, &Device::state_changed);
+}
+
+bool Qt_Device::connect_device()
+{
+    Das::Modbus::Config::set(_config, _dev.get());
+    _dev->setNumberOfRetries(0); // Retried by Client to be counted
+    return _dev->connectDevice();
+}
+
+void Qt_Device::disconnect_device()
+{
+    _dev->disconnectDevice();
+}
+
+QModbusDevice::State Qt_Device::state() const
+{
+    return _dev->state();
+}
+
+QModbusDevice::Error Qt_Device::error() const
+{
+    return _dev->error();
+}
+
+QString Qt_Device::error_string() const
+{
+    return _dev->errorString();
+}
+
+QModbusReply *Qt_Device::send(const Request &request, int timeout_ms)
+{
+    // Qt reads it when the request is sent, so it works per request
+    _dev->setTimeout(timeout_ms);
+
+    switch (request._kind)
+    {
+    case Request::READ:
+        return _dev->sendReadRequest(QModbusDataUnit(request._type, request._start, request._count), request._server_address);
+    case Request::WRITE:
+        return _dev->sendWriteRequest(QModbusDataUnit(request._type, request._start, request._values), request._server_address);
+    case Request::READ_WRITE:
+        return _dev->sendReadWriteRequest(QModbusDataUnit(request._type, request._start, request._count),
+                                          QModbusDataUnit(request._type, request._start, request._values),
+                                          request._server_address);
+    case Request::RAW:
+        return _dev->sendRawRequest(QModbusRequest{request._func, request._data}, request._server_address);
+    }
+    return nullptr;
+}
+
+} // namespace Modbus_Cli
@@ -0,0 +1,61 @@
+#ifndef MODBUS_CLI_DEVICE_H
+#define MODBUS_CLI_DEVICE_H
+
+#include <memory>
+
+#include <QModbusClient>
+#include <QModbusReply>
+
+#include "config.h"
+#include "request.h"
+
+namespace Modbus_Cli {
+
+/// Transport used by Client. Replies are QModbusReply, finished with result or error.
+class Device : public QObject
+{
+    Q_OBJECT
+public:
+    using QObject::QObject;
+
+    virtual bool connect_device() = 0;
+    virtual void disconnect_device() = 0;
+
+    virtual QModbusDevice::State state() const = 0;
+    virtual QModbusDevice::Error error() const = 0;
+    virtual QString error_string() const = 0;
+
+    /// Reply fails with TimeoutError if there is no answer in timeout_ms.
+    /// Returns nullptr if request can't be sent, see error_string()
+    virtual QModbusReply* send(const Request& request, int timeout_ms) = 0;
+signals:
+    void error_occurred(QModbusDevice::Error e);
+    void state_changed(QModbusDevice::State state);
+protected:
+    /// Finishes reply of request with response PDU: result, Modbus exception or invalid response error
+    static void finish_reply(QModbusReply* reply, const Request& request, const QByteArray& pdu);
+};
+
+/// Device based on QModbusTcpClient or QModbusRtuSerialMaster
+class Qt_Device : public Device
+{
+    Q_OBJECT
+public:
+    Qt_Device(QModbusClient* dev, const Das::Modbus::Config& config, QObject* parent = nullptr);
+
+    bool connect_device() override;
+    void disconnect_device() override;
+
+    QModbusDevice::State state() const override;
+    QModbusDevice::Error error() const override;
+    QString error_string() const override;
+
+    QModbusReply* send(const Request& request, int timeout_ms) override;
+private:
+    std::unique_ptr<QModbusClient> _dev;
+    Das::Modbus::Config _config;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_DEVICE_H
@@ -0,0 +1,89 @@
+#include <algorithm>
+
+#include <sys/resource.h>
+
+#include "fan_out.h"
+
+namespace Modbus_Cli {
+
+namespace {
+
+/// Every device holds a descriptor, default soft limit is often 1024
+void raise_file_limit()
+{
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+} // namespace
+
+Fan_Out::Fan_Out(const QStringList &endpoints, const Job &job, int thread_count, int max_parallel, QObject *parent) :
+    QObject(parent),
+    _endpoints(endpoints),
+    _job(job),
+    _next(0),
+    _active(0),
+    _max_parallel(std::max(max_parallel, 1)),
+    _next_thread(0)
+{
+    raise_file_limit();
+
+    thread_count = std::max(1, std::min(thread_count, _max_parallel));
+    for (int i = 0; i < thread_count; ++i)
+    {
+        _threads.emplace_back(new QThread);
+        _contexts.emplace_back(new QObject);
+        _contexts.back()->moveToThread(_threads.back().get());
+        _threads.back()->start();
+    }
+}
+
+Fan_Out::~Fan_Out()
+{
+    for (auto& thread: _threads)
+        thread->quit();
+    for (auto& thread: _threads)
+        thread->wait();
+}
+
+void Fan_Out::start()
+{
+    if (_endpoints.isEmpty())
+        emit done();
+
+    while (_active < _max_parallel && _next < _endpoints.size())
+        start_next();
+}
+
+void Fan_Out::session_done()
+{
+    --_active;
+    if (_next < _endpoints.size())
+        start_next();
+    else if (_active == 0)
+        emit done();
+}
+
+void Fan_Out::start_next()
+{
+    QObject* context = _contexts.at(_next_thread).get();
+    _next_thread = (_next_thread + 1) % _contexts.size();
+
+    const QString conn_string = _endpoints.at(_next++);
+    ++_active;
+
+    // Session must be created in the thread it lives in, Client owns objects without parent
+    QMetaObject::invokeMethod(context, [this, context, conn_string]()
+    {
+        Session* session = new Session{conn_string, _job, context};
+        connect(session, &Session::done, session, &Session::deleteLater);
+        connect(session, &Session::done, this, &Fan_Out::session_done, Qt::QueuedConnection);
+        session->start();
+    }, Qt::QueuedConnection);
+}
+
+} // namespace Modbus_Cli
@@ -0,0 +1,44 @@
+#ifndef MODBUS_CLI_FAN_OUT_H
+#define MODBUS_CLI_FAN_OUT_H
+
+#include <memory>
+#include <vector>
+
+#include <QThread>
+#include <QStringList>
+
+#include "session.h"
+
+namespace Modbus_Cli {
+
+/// Runs a job on many devices. Sessions are spread over a pool of threads,
+/// at most max_parallel of them exist at any time.
+class Fan_Out : public QObject
+{
+    Q_OBJECT
+public:
+    Fan_Out(const QStringList& endpoints, const Job& job, int thread_count, int max_parallel, QObject* parent = nullptr);
+    ~Fan_Out();
+
+    void start();
+signals:
+    void done();
+private slots:
+    void session_done();
+private:
+    void start_next();
+
+    QStringList _endpoints;
+    Job _job;
+    int _next;
+    int _active;
+    int _max_parallel;
+    int _next_thread;
+
+    std::vector<std::unique_ptr<QThread>> _threads;
+    std::vector<std::unique_ptr<QObject>> _contexts;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_FAN_OUT_H
@@ -0,0 +1,103 @@
+#include "histogram.h"
+
+namespace Modbus_Cli {
+
+Histogram::Histogram()
+{
+    reset();
+}
+
+void Histogram::record(quint64 value)
+{
+    _counts[index_of(value)].fetch_add(1, std::memory_order_relaxed);
+    _count.fetch_add(1, std::memory_order_relaxed);
+    _total.fetch_add(value, std::memory_order_relaxed);
+
+    quint64 max = _max.load(std::memory_order_relaxed);
+    while (value > max && !_max.compare_exchange_weak(max, value, std::memory_order_relaxed));
+}
+
+void Histogram::reset()
+{
+    for (std::atomic<quint64>& counter: _counts)
+        counter.store(0, std::memory_order_relaxed);
+    _count.store(0, std::memory_order_relaxed);
+    _total.store(0, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+}
+
+void Histogram::add_to(Histogram &other) const
+{
+    for (int i = 0; i < bucket_count; ++i)
+    {
+        const quint64 count = _counts[i].load(std::memory_order_relaxed);
+        if (count)
+            other._counts[i].fetch_add(count, std::memory_order_relaxed);
+    }
+    other._count.fetch_add(_count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    other._total.fetch_add(_total.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    const quint64 max = _max.load(std::memory_order_relaxed);
+    quint64 other_max = other._max.load(std::memory_order_relaxed);
+    while (max > other_max && !other._max.compare_exchange_weak(other_max, max, std::memory_order_relaxed));
+}
+
+quint64 Histogram::count() const
+{
+    return _count.load(std::memory_order_relaxed);
+}
+
+quint64 Histogram::max() const
+{
+    return _max.load(std::memory_order_relaxed);
+}
+
+double Histogram::mean() const
+{
+    const quint64 count = this->count();
+    return count ? static_cast<double>(_total.load(std::memory_order_relaxed)) / count : 0.;
+}
+
+quint64 Histogram::value_at_percentile(double percentile) const
+{
+    quint64 total = 0;
+    for (int i = 0; i < bucket_count; ++i)
+        total += _counts[i].load(std::memory_order_relaxed);
+    if (!total)
+        return 0;
+
+    quint64 target = static_cast<quint64>(percentile / 100. * total + 0.5);
+    if (target < 1)
+        target = 1;
+
+    quint64 seen = 0;
+    for (int i = 0; i < bucket_count; ++i)
+    {
+        seen += _counts[i].load(std::memory_order_relaxed);
+        if (seen >= target)
+            return qMin(highest_equivalent(i), max());
+    }
+    return max();
+}
+
+int Histogram::index_of(quint64 value)
+{
+    if (value < (1u << sub_bucket_bits))
+        return static_cast<int>(value);
+
+    const int msb = 63 - __builtin_clzll(value);
+    const int exponent = msb - sub_bucket_bits + 1;
+    return exponent * half_count + static_cast<int>(value >> exponent);
+}
+
+quint64 Histogram::highest_equivalent(int index)
+{
+    if (index < (1 << sub_bucket_bits))
+        return static_cast<quint64>(index);
+
+    const int exponent = index / half_count - 1;
+    const quint64 mantissa = static_cast<quint64>(index - exponent * half_count);
+    return (mantissa << exponent) + ((quint64(1) << exponent) - 1);
+}
+
+} // namespace Modbus_Cli
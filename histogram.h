@@ -0,0 +1,49 @@
+#ifndef MODBUS_CLI_HISTOGRAM_H
+#define MODBUS_CLI_HISTOGRAM_H
+
+#include <atomic>
+
+#include <QtGlobal>
+
+namespace Modbus_Cli {
+
+/*
+ * HDR-style log-linear histogram with fixed memory.
+ * Values below 2^sub_bucket_bits are exact, above it every power of two is split
+ * into 2^(sub_bucket_bits - 1) equal buckets, so relative error is below 1.6%.
+ * record() is lock-free and may run concurrently with readers.
+ */
+class Histogram
+{
+public:
+    static const int sub_bucket_bits = 7;
+    static const int half_count = 1 << (sub_bucket_bits - 1);
+    static const int bucket_count = (64 - sub_bucket_bits + 2) * half_count;
+
+    Histogram();
+
+    void record(quint64 value);
+    void reset();
+
+    /// Adds snapshot of this histogram to other
+    void add_to(Histogram& other) const;
+
+    quint64 count() const;
+    quint64 max() const;
+    double mean() const;
+
+    /// Highest value equivalent to the value at percentile. percentile is 0..100
+    quint64 value_at_percentile(double percentile) const;
+private:
+    static int index_of(quint64 value);
+    static quint64 highest_equivalent(int index);
+
+    std::atomic<quint64> _counts[bucket_count];
+    std::atomic<quint64> _count;
+    std::atomic<quint64> _total;
+    std::atomic<quint64> _max;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_HISTOGRAM_H
@@ -16,6 +16,7 @@ int main(int argc, char *argv[])
     QCoreApplication a(argc, argv);
 
     Modbus_Cli::Worker w;
-    w.process(a.arguments());
+    if (!w.process(a.arguments()))
+        return 1;
     return a.exec();
 }
@@ -0,0 +1,273 @@
+#include <algorithm>
+
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+
+#include "protocol.h"
+#include "map_discovery.h"
+
+namespace Modbus_Cli {
+
+Map_Discovery::Map_Discovery(const QString &conn_string, const Job &job, int server_address,
+                             const QVector<QModbusDataUnit::RegisterType> &types, int start, int count,
+                             const QString &file_name, QObject *parent) :
+    QObject(parent),
+    _job(job),
+    _server_address(server_address),
+    _file_name(file_name),
+    _client(make_client(conn_string, job)),
+    _next_id(0),
+    _next_group(0),
+    _requests(0),
+    _timeouts_in_row(0),
+    _given_up(false),
+    _finished(false)
+{
+    _client->set_print_values(false);
+
+    connect(_client.get(), &Client::connected, this, &Map_Discovery::on_connected);
+    connect(_client.get(), &Client::data_received, this, &Map_Discovery::data_received);
+    connect(_client.get(), &Client::request_failed, this, &Map_Discovery::request_failed);
+    connect(_client.get(), &Client::finished, this, &Map_Discovery::request_finished);
+
+    const int end = std::min(start + count, 0x10000);
+    for (QModbusDataUnit::RegisterType type: types)
+    {
+        const int size = max_read_count(type);
+        for (int address = start; address < end; address += size)
+            _queue.enqueue(Interval{type, address, std::min(size, end - address), true, -1, 0});
+    }
+}
+
+void Map_Discovery::start()
+{
+    _elapsed.start();
+    if (!_client->connect_device())
+        finish();
+}
+
+void Map_Discovery::on_connected()
+{
+    dispatch();
+}
+
+void Map_Discovery::dispatch()
+{
+    while (!_finished && !_queue.isEmpty() && _client->is_connected() && _client->can_send())
+    {
+        const Interval interval = _queue.dequeue();
+        Request request = Request::read(_server_address, interval._type, interval._start, interval._count);
+        request._id = _next_id++;
+        _in_flight.insert(request._id, interval);
+        ++_requests;
+        _client->send(request);
+    }
+}
+
+void Map_Discovery::data_received(const Request &request)
+{
+    if (!_in_flight.contains(request._id))
+        return;
+
+    const Interval interval = _in_flight.take(request._id);
+    _timeouts_in_row = 0;
+    _valid[interval._type].insert(interval._start, interval._count);
+    set_result(interval, VALID);
+}
+
+void Map_Discovery::request_failed(const Request &request, QModbusDevice::Error error, int exception_code)
+{
+    if (!_in_flight.contains(request._id))
+        return;
+
+    const Interval interval = _in_flight.take(request._id);
+    if (error == QModbusDevice::ProtocolError)
+    {
+        _timeouts_in_row = 0;
+        if (exception_code == 0x01)
+        {
+            // Illegal function: the device has no such register type
+            if (!_unsupported.contains(interval._type))
+                _unsupported.push_back(interval._type);
+            QQueue<Interval> rest;
+            for (const Interval& queued: _queue)
+                if (queued._type != interval._type)
+                    rest.enqueue(queued);
+            _queue = rest;
+        }
+        else
+            set_result(interval, INVALID);
+    }
+    else if (error == QModbusDevice::TimeoutError)
+    {
+        // Some devices don't answer reads of invalid addresses at all, so only silent whole chunks count
+        if (!interval._chunk || ++_timeouts_in_row < max_timeouts_in_row)
+            set_result(interval, INVALID);
+        else if (!_given_up)
+        {
+            qCritical().noquote() << "Slave" << _server_address << "doesn't answer, map is incomplete";
+            _given_up = true;
+            _queue.clear();
+        }
+    }
+    else
+        set_result(interval, LOST);
+}
+
+void Map_Discovery::set_result(const Interval &interval, Result result)
+{
+    if (interval._group == -1)
+    {
+        if (result == INVALID)
+            split(interval);
+        return;
+    }
+
+    auto it = _groups.find(interval._group);
+    if (it == _groups.end())
+        return;
+
+    Group& group = it.value();
+    group._results[interval._index] = result;
+    if (--group._waiting > 0)
+        return;
+
+    const Group resolved = group;
+    _groups.erase(it);
+    resolve(resolved);
+}
+
+void Map_Discovery::resolve(const Group &group)
+{
+    const Interval& parent = group._parent;
+    if (_given_up || _unsupported.contains(parent._type))
+        return;
+
+    if (group._step == 0)
+    {
+        // A failed half next to a valid one holds a boundary, two failed halves are probed
+        const int half = parent._count / 2;
+        if (group._results[0] == INVALID && group._results[1] == INVALID && half > 1)
+        {
+            probe(parent);
+            return;
+        }
+        if (group._results[0] == INVALID)
+            split(Interval{parent._type, parent._start, half, false, -1, 0});
+        if (group._results[1] == INVALID)
+            split(Interval{parent._type, parent._start + half, parent._count - half, false, -1, 0});
+        return;
+    }
+
+    // The registers between two probes are read again when one of them is valid
+    const int end = parent._start + parent._count;
+    for (int i = 0; i < group._results.size(); ++i)
+    {
+        const bool next_valid = i + 1 < group._results.size() && group._results[i + 1] == VALID;
+        const int start = parent._start + i * group._step + 1;
+        const int count = std::min(start + group._step - 1, end) - start;
+        if (count > 0 && (group._results[i] == VALID || next_valid))
+            _queue.enqueue(Interval{parent._type, start, count, false, -1, 0});
+    }
+}
+
+void Map_Discovery::split(const Interval &interval)
+{
+    if (interval._count == 1)
+        return;
+
+    const int id = _next_group++;
+    const int half = interval._count / 2;
+    _groups.insert(id, Group{interval, 0, QVector<Result>(2, WAITING), 2});
+    _queue.enqueue(Interval{interval._type, interval._start, half, false, id, 0});
+    _queue.enqueue(Interval{interval._type, interval._start + half, interval._count - half, false, id, 1});
+}
+
+void Map_Discovery::probe(const Interval &interval)
+{
+    const int id = _next_group++;
+    const int step = (interval._count + probe_count - 1) / probe_count;
+    const int count = (interval._count + step - 1) / step;
+    _groups.insert(id, Group{interval, step, QVector<Result>(count, WAITING), count});
+    for (int i = 0; i < count; ++i)
+        _queue.enqueue(Interval{interval._type, interval._start + i * step, 1, false, id, i});
+}
+
+void Map_Discovery::request_finished()
+{
+    if (_finished)
+        return;
+
+    if (!_client->is_connected())
+    {
+        if (_client->pending_count() == 0)
+        {
+            if (_requests > 0)
+                qCritical().noquote() << "Connection lost, map is incomplete";
+            finish();
+        }
+        return;
+    }
+
+    dispatch();
+    if (_queue.isEmpty() && _in_flight.isEmpty() && _client->pending_count() == 0)
+        finish();
+}
+
+void Map_Discovery::finish()
+{
+    if (_finished)
+        return;
+    _finished = true;
+
+    int valid_count = 0;
+    for (const QMap<int, int>& ranges: _valid)
+        for (int count: ranges)
+            valid_count += count;
+
+    if (write_map())
+        qInfo().noquote() << QString("Slave %1: %2 valid addresses found with %3 requests in %4 ms, map written to %5")
+                             .arg(_server_address).arg(valid_count).arg(_requests).arg(_elapsed.elapsed()).arg(_file_name);
+    emit done();
+}
+
+bool Map_Discovery::write_map() const
+{
+    QFile file(_file_name);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        qCritical().noquote() << "Can't write map" << _file_name << file.errorString();
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << "# Register map of " << _client->conn_string() << " slave " << _server_address << '\n';
+    for (int type: _unsupported)
+        out << "# " << register_type_to_string(static_cast<QModbusDataUnit::RegisterType>(type)) << ": illegal function\n";
+
+    for (auto it = _valid.constBegin(); it != _valid.constEnd(); ++it)
+    {
+        // Halves found valid apart are joined back
+        QStringList ranges;
+        int first = -1, end = -1;
+        for (auto range = it.value().constBegin(); range != it.value().constEnd(); ++range)
+        {
+            if (range.key() != end)
+            {
+                if (first != -1)
+                    ranges.push_back(end - first == 1 ? QString::number(first) : QString("%1-%2").arg(first).arg(end - 1));
+                first = range.key();
+            }
+            end = range.key() + range.value();
+        }
+        if (first != -1)
+            ranges.push_back(end - first == 1 ? QString::number(first) : QString("%1-%2").arg(first).arg(end - 1));
+
+        out << _server_address << ' ' << register_type_to_string(static_cast<QModbusDataUnit::RegisterType>(it.key()))
+            << ' ' << ranges.join(',') << '\n';
+    }
+    return true;
+}
+
+} // namespace Modbus_Cli
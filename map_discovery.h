@@ -0,0 +1,94 @@
+#ifndef MODBUS_CLI_MAP_DISCOVERY_H
+#define MODBUS_CLI_MAP_DISCOVERY_H
+
+#include <memory>
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QQueue>
+
+#include "session.h"
+
+namespace Modbus_Cli {
+
+/*
+ * Finds valid address ranges of one device. Every register type is read in requests of the protocol maximum,
+ * a range answered with an exception is split in halves. A half next to a valid half holds a boundary and is split
+ * further. When both halves fail, single registers are probed at an eighth of the range apart and only the parts
+ * next to a valid probe are read again, so an invalid chunk costs 11 requests. Valid runs shorter than the probe
+ * step between two invalid probes are missed. Exception 0x01 (illegal function) drops the register type.
+ * Silent devices are treated like exceptions, many timeouts of whole chunks in a row stop the discovery.
+ * The result is written as a scan list.
+ */
+class Map_Discovery : public QObject
+{
+    Q_OBJECT
+public:
+    Map_Discovery(const QString& conn_string, const Job& job, int server_address,
+                  const QVector<QModbusDataUnit::RegisterType>& types, int start, int count,
+                  const QString& file_name, QObject* parent = nullptr);
+
+    void start();
+signals:
+    void done();
+private slots:
+    void on_connected();
+    void data_received(const Request& request);
+    void request_failed(const Request& request, QModbusDevice::Error error, int exception_code);
+    void request_finished();
+private:
+    struct Interval
+    {
+        QModbusDataUnit::RegisterType _type;
+        int _start;
+        int _count;
+        bool _chunk;    ///< Read of the protocol maximum
+        int _group;     ///< Split or probe it belongs to, -1 for none
+        int _index;     ///< Place in the group
+    };
+
+    enum Result { WAITING, VALID, INVALID, LOST };
+
+    /// Halves (_step 0) or probes of a failed interval, resolved when all of them are answered
+    struct Group
+    {
+        Interval _parent;
+        int _step;
+        QVector<Result> _results;
+        int _waiting;
+    };
+
+    void dispatch();
+    void split(const Interval& interval);
+    void probe(const Interval& interval);
+    void set_result(const Interval& interval, Result result);
+    void resolve(const Group& group);
+    void finish();
+    bool write_map() const;
+
+    static const int max_timeouts_in_row = 10;
+    static const int probe_count = 8;
+
+    Job _job;
+    int _server_address;
+    QString _file_name;
+    std::unique_ptr<Client> _client;
+
+    QQueue<Interval> _queue;
+    QHash<int, Interval> _in_flight;
+    QHash<int, Group> _groups;
+    int _next_id;
+    int _next_group;
+    QMap<int, QMap<int, int>> _valid;   ///< Start to count of valid ranges, by register type
+    QVector<int> _unsupported;          ///< Register types answered with illegal function
+
+    int _requests;
+    int _timeouts_in_row;
+    bool _given_up;
+    bool _finished;
+    QElapsedTimer _elapsed;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_MAP_DISCOVERY_H
@@ -0,0 +1,75 @@
+#include <QDebug>
+
+#include "connection_metrics.h"
+#include "metrics_server.h"
+
+namespace Modbus_Cli {
+
+Metrics_Server::Metrics_Server(QObject *parent) :
+    QObject(parent)
+{
+    connect(&_server, &QTcpServer::newConnection, this, &Metrics_Server::new_connection);
+}
+
+bool Metrics_Server::listen(const QString &address)
+{
+    const int sep = address.lastIndexOf(':');
+    const QHostAddress host = sep == -1 ? QHostAddress{QHostAddress::LocalHost} : QHostAddress{address.left(sep)};
+    bool ok;
+    const int port = address.mid(sep + 1).toInt(&ok);
+    if (!ok || port <= 0 || port > 0xFFFF || host.isNull())
+    {
+        qCritical().noquote() << "Bad metrics address:" << address;
+        return false;
+    }
+
+    if (!_server.listen(host, static_cast<quint16>(port)))
+    {
+        qCritical().noquote() << "Can't listen for metrics on" << address << _server.errorString();
+        return false;
+    }
+    return true;
+}
+
+void Metrics_Server::new_connection()
+{
+    while (QTcpSocket* socket = _server.nextPendingConnection())
+    {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { read_request(socket); });
+    }
+}
+
+void Metrics_Server::read_request(QTcpSocket *socket)
+{
+    // Request is small, keep it in the socket buffer until the headers end
+    const QByteArray data = socket->peek(max_request_size + 1);
+    if (!data.contains("\r\n\r\n") && !data.contains("\n\n"))
+    {
+        if (data.size() > max_request_size)
+            reply(socket, "431 Request Header Fields Too Large", "text/plain", "Request too large\n");
+        return;
+    }
+    socket->readAll();
+    disconnect(socket, &QTcpSocket::readyRead, this, nullptr);
+
+    const QList<QByteArray> words = data.left(data.indexOf('\n')).trimmed().split(' ');
+    if (words.size() < 2 || words.at(0) != "GET")
+        reply(socket, "405 Method Not Allowed", "text/plain", "Only GET is supported\n");
+    else if (words.at(1) != "/metrics" && !words.at(1).startsWith("/metrics?"))
+        reply(socket, "404 Not Found", "text/plain", "See /metrics\n");
+    else
+        reply(socket, "200 OK", "text/plain; version=0.0.4; charset=utf-8", Connection_Metrics::exposition());
+}
+
+/*static*/ void Metrics_Server::reply(QTcpSocket *socket, const char *status, const QByteArray &content_type, const QByteArray &body)
+{
+    QByteArray head = QByteArray("HTTP/1.1 ") + status + "\r\n";
+    head += "Content-Type: " + content_type + "\r\n";
+    head += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    head += "Connection: close\r\n\r\n";
+    socket->write(head + body);
+    socket->disconnectFromHost();
+}
+
+} // namespace Modbus_Cli
@@ -0,0 +1,34 @@
+#ifndef MODBUS_CLI_METRICS_SERVER_H
+#define MODBUS_CLI_METRICS_SERVER_H
+
+#include <QTcpServer>
+#include <QTcpSocket>
+
+namespace Modbus_Cli {
+
+/*
+ * Minimal HTTP server for Prometheus scrapes: "GET /metrics" is answered with
+ * Connection_Metrics::exposition(), anything else with an error status. One request per connection.
+ */
+class Metrics_Server : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Metrics_Server(QObject* parent = nullptr);
+
+    /// address is "[host:]port", host is 127.0.0.1 by default
+    bool listen(const QString& address);
+private slots:
+    void new_connection();
+private:
+    static const int max_request_size = 8192;
+
+    void read_request(QTcpSocket* socket);
+    static void reply(QTcpSocket* socket, const char* status, const QByteArray& content_type, const QByteArray& body);
+
+    QTcpServer _server;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_METRICS_SERVER_H
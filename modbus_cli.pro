@@ -1,5 +1,5 @@
 QT -= gui
-QT += serialport serialbus
+QT += serialport serialbus network
 
 CONFIG += c++11 console
 CONFIG -= app_bundle
@@ -9,9 +9,39 @@ CONFIG -= app_bundle
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+        batch_runner.cpp \
+        bulk_writer.cpp \
+        bus_prober.cpp \
+        bus_scheduler.cpp \
+        cache_daemon.cpp \
+        change_filter.cpp \
         client.cpp \
         config.cpp \
+        connection_metrics.cpp \
+        crc16.cpp \
+        device.cpp \
+        fan_out.cpp \
+        histogram.cpp \
         main.cpp \
+        map_discovery.cpp \
+        metrics_server.cpp \
+        output_writer.cpp \
+        protocol.cpp \
+        register_cache.cpp \
+        register_image.cpp \
+        rtu_master.cpp \
+        scan_list.cpp \
+        scan_poller.cpp \
+        session.cpp \
+        rtt_estimator.cpp \
+        stats.cpp \
+        tcp_gateway.cpp \
+        tcp_master.cpp \
+        tcp_reactor.cpp \
+        traffic_capture.cpp \
+        traffic_replay.cpp \
+        unix_signal.cpp \
+        value_decoder.cpp \
         worker.cpp
 
 # Default rules for deployment.
@@ -20,6 +50,37 @@ else: unix:!android: target.path = /opt/$${TARGET}/bin
 !isEmpty(target.path): INSTALLS += target
 
 HEADERS += \
+    batch_runner.h \
+    bulk_writer.h \
+    bus_prober.h \
+    bus_scheduler.h \
+    cache_daemon.h \
+    change_filter.h \
     client.h \
     config.h \
+    connection_metrics.h \
+    crc16.h \
+    device.h \
+    fan_out.h \
+    histogram.h \
+    map_discovery.h \
+    metrics_server.h \
+    output_writer.h \
+    protocol.h \
+    register_cache.h \
+    register_image.h \
+    request.h \
+    rtu_master.h \
+    scan_list.h \
+    scan_poller.h \
+    session.h \
+    rtt_estimator.h \
+    stats.h \
+    tcp_gateway.h \
+    tcp_master.h \
+    tcp_reactor.h \
+    traffic_capture.h \
+    traffic_replay.h \
+    unix_signal.h \
+    value_decoder.h \
     worker.h
@@ -0,0 +1,311 @@
+#include <chrono>
+#include <cstring>
+
+#include <QByteArray>
+#include <QString>
+#include <QDebug>
+
+#include "protocol.h"
+#include "output_writer.h"
+
+namespace Modbus_Cli {
+
+namespace {
+
+void append_number(std::string& out, quint64 value)
+{
+    char digits[20];
+    int size = 0;
+    do
+    {
+        digits[size++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    while (value);
+
+    while (size)
+        out.push_back(digits[--size]);
+}
+
+template<typename T>
+void append_le(std::string& out, T value)
+{
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+        out.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+}
+
+/// Text is UTF-8, or Latin-1 bytes of a device string, which aren't valid UTF-8 above 0x7F
+void append_json_string(std::string& out, const QByteArray& text, bool latin1 = false)
+{
+    static const char hex[] = "0123456789abcdef";
+    out.push_back('"');
+    for (char c: text)
+    {
+        const unsigned char byte = static_cast<unsigned char>(c);
+        if (byte < 0x20 || (latin1 && byte >= 0x80))
+        {
+            out.append("\\u00");
+            out.push_back(hex[byte >> 4]);
+            out.push_back(hex[byte & 0xF]);
+            continue;
+        }
+        if (c == '"' || c == '\\')
+            out.push_back('\\');
+        out.push_back(c);
+    }
+    out.push_back('"');
+}
+
+void append_csv_field(std::string& out, const char* text, std::size_t size, bool quote)
+{
+    if (!quote && !std::memchr(text, ',', size) && !std::memchr(text, '"', size))
+    {
+        out.append(text, size);
+        return;
+    }
+
+    out.push_back('"');
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        if (text[i] == '"')
+            out.push_back('"');
+        out.push_back(text[i]);
+    }
+    out.push_back('"');
+}
+
+quint64 now_us()
+{
+    using namespace std::chrono;
+    return static_cast<quint64>(duration_cast<microseconds>(system_clock::now().time_since_epoch()).count());
+}
+
+} // namespace
+
+/*static*/ bool Output_Writer::parse_format(const QString &text, Format &format)
+{
+    const QString name = text.toLower();
+    if (name == "text") format = TEXT;
+    else if (name == "csv") format = CSV;
+    else if (name == "ndjson") format = NDJSON;
+    else if (name == "binary") format = BINARY;
+    else
+        return false;
+    return true;
+}
+
+Output_Writer::Output_Writer(Format format, std::FILE *file, bool close_file) :
+    _format(format),
+    _file(file),
+    _close_file(close_file)
+{
+    _buffer.reserve(flush_size * 2);
+}
+
+Output_Writer::~Output_Writer()
+{
+    flush();
+    if (_close_file)
+        std::fclose(_file);
+}
+
+/*static*/ Output_Writer *Output_Writer::open(Format format, const QString &file_name)
+{
+    if (file_name.isEmpty())
+        return new Output_Writer{format, stdout, false};
+
+    std::FILE* file = std::fopen(file_name.toLocal8Bit().constData(), format == BINARY ? "wb" : "w");
+    if (!file)
+    {
+        qCritical().noquote() << "Can't open output file" << file_name;
+        return nullptr;
+    }
+    return new Output_Writer{format, file, true};
+}
+
+Output_Writer::Format Output_Writer::format() const
+{
+    return _format;
+}
+
+void Output_Writer::write(const QString &endpoint, int slave, QModbusDataUnit::RegisterType type, int start,
+                          const quint16 *values, int count)
+{
+    // Record is formatted without the lock, only appending is serialized
+    thread_local std::string record;
+    record.clear();
+
+    const QByteArray endpoint_bytes = endpoint.toUtf8();
+    const quint64 time_us = now_us();
+    switch (_format)
+    {
+    case CSV:    format_csv(record, endpoint_bytes, time_us, slave, type, start, values, count); break;
+    case NDJSON: format_ndjson(record, endpoint_bytes, time_us, slave, type, start, values, count); break;
+    case BINARY: format_binary(record, endpoint_bytes, time_us, slave, type, start, values, count); break;
+    case TEXT:   return;
+    }
+    append_record(record);
+}
+
+void Output_Writer::write_value(const QString &endpoint, int slave, QModbusDataUnit::RegisterType type, int address,
+                                const QString &name, const char *value, int size, bool text)
+{
+    if (_format != CSV && _format != NDJSON)
+        return;
+
+    thread_local std::string record;
+    record.clear();
+
+    const QByteArray endpoint_bytes = endpoint.toUtf8();
+    const QByteArray name_bytes = name.toUtf8();
+    const std::size_t value_size = static_cast<std::size_t>(size);
+    if (_format == CSV)
+    {
+        append_number(record, now_us());
+        record.push_back(',');
+        append_csv_field(record, endpoint_bytes.constData(), static_cast<std::size_t>(endpoint_bytes.size()), false);
+        record.push_back(',');
+        append_number(record, static_cast<quint64>(slave));
+        record.push_back(',');
+        record.append(register_type_to_string(type).toStdString());
+        record.push_back(',');
+        append_number(record, static_cast<quint64>(address));
+        record.push_back(',');
+        append_csv_field(record, name_bytes.constData(), static_cast<std::size_t>(name_bytes.size()), false);
+        record.push_back(',');
+        append_csv_field(record, value, value_size, text);
+        record.push_back('\n');
+    }
+    else
+    {
+        record.append("{\"time_us\":");
+        append_number(record, now_us());
+        record.append(",\"endpoint\":");
+        append_json_string(record, endpoint_bytes);
+        record.append(",\"slave\":");
+        append_number(record, static_cast<quint64>(slave));
+        record.append(",\"type\":\"");
+        record.append(register_type_to_string(type).toStdString());
+        record.append("\",\"address\":");
+        append_number(record, static_cast<quint64>(address));
+        record.append(",\"name\":");
+        append_json_string(record, name_bytes);
+        record.append(",\"value\":");
+        if (text)
+            append_json_string(record, QByteArray::fromRawData(value, size), true);
+        else if (size > 0 && value[size - 1] >= '0' && value[size - 1] <= '9')
+            record.append(value, value_size);
+        else
+            record.append("null"); // JSON has no nan and inf
+        record.append("}\n");
+    }
+    append_record(record);
+}
+
+void Output_Writer::append_record(const std::string &record)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _buffer.append(record);
+    if (_buffer.size() >= flush_size)
+        flush_locked();
+}
+
+void Output_Writer::flush()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    flush_locked();
+}
+
+void Output_Writer::flush_locked()
+{
+    if (_buffer.empty())
+        return;
+
+    std::fwrite(_buffer.data(), 1, _buffer.size(), _file);
+    std::fflush(_file);
+    _buffer.clear();
+}
+
+void Output_Writer::format_csv(std::string &out, const QByteArray &endpoint, quint64 time_us, int slave,
+                               QModbusDataUnit::RegisterType type, int start, const quint16 *values, int count) const
+{
+    // Common prefix is formatted once and copied for every value
+    std::string prefix;
+    append_number(prefix, time_us);
+    prefix.push_back(',');
+    if (endpoint.contains(',') || endpoint.contains('"'))
+    {
+        prefix.push_back('"');
+        for (char c: endpoint)
+        {
+            if (c == '"')
+                prefix.push_back('"');
+            prefix.push_back(c);
+        }
+        prefix.push_back('"');
+    }
+    else
+        prefix.append(endpoint.constData(), static_cast<std::size_t>(endpoint.size()));
+    prefix.push_back(',');
+    append_number(prefix, static_cast<quint64>(slave));
+    prefix.push_back(',');
+    prefix.append(register_type_to_string(type).toStdString());
+    prefix.push_back(',');
+
+    out.reserve(out.size() + static_cast<std::size_t>(count) * (prefix.size() + 12));
+    for (int i = 0; i < count; ++i)
+    {
+        out.append(prefix);
+        append_number(out, static_cast<quint64>(start + i));
+        out.push_back(',');
+        append_number(out, values[i]);
+        out.push_back('\n');
+    }
+}
+
+void Output_Writer::format_ndjson(std::string &out, const QByteArray &endpoint, quint64 time_us, int slave,
+                                  QModbusDataUnit::RegisterType type, int start, const quint16 *values, int count) const
+{
+    out.append("{\"time_us\":");
+    append_number(out, time_us);
+    out.append(",\"endpoint\":");
+    append_json_string(out, endpoint);
+    out.append(",\"slave\":");
+    append_number(out, static_cast<quint64>(slave));
+    out.append(",\"type\":\"");
+    out.append(register_type_to_string(type).toStdString());
+    out.append("\",\"start\":");
+    append_number(out, static_cast<quint64>(start));
+    out.append(",\"values\":[");
+    for (int i = 0; i < count; ++i)
+    {
+        if (i)
+            out.push_back(',');
+        append_number(out, values[i]);
+    }
+    out.append("]}\n");
+}
+
+void Output_Writer::format_binary(std::string &out, const QByteArray &endpoint, quint64 time_us, int slave,
+                                  QModbusDataUnit::RegisterType type, int start, const quint16 *values, int count) const
+{
+    // Count is u16, a whole 64K read takes two records
+    for (; count > 0xFFFF; start += 0xFFFF, values += 0xFFFF, count -= 0xFFFF)
+        format_binary(out, endpoint, time_us, slave, type, start, values, 0xFFFF);
+
+    const quint32 size = 8 + 1 + 1 + 2 + 2 + 2 + static_cast<quint32>(endpoint.size()) + 2 * static_cast<quint32>(count);
+    out.reserve(out.size() + 4 + size);
+
+    append_le<quint32>(out, size);
+    append_le<quint64>(out, time_us);
+    out.push_back(static_cast<char>(type));
+    out.push_back(static_cast<char>(slave));
+    append_le<quint16>(out, static_cast<quint16>(start));
+    append_le<quint16>(out, static_cast<quint16>(count));
+    append_le<quint16>(out, static_cast<quint16>(endpoint.size()));
+    out.append(endpoint.constData(), static_cast<std::size_t>(endpoint.size()));
+    for (int i = 0; i < count; ++i)
+        append_le<quint16>(out, values[i]);
+}
+
+} // namespace Modbus_Cli
@@ -0,0 +1,82 @@
+#ifndef MODBUS_CLI_OUTPUT_WRITER_H
+#define MODBUS_CLI_OUTPUT_WRITER_H
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+#include <QModbusDataUnit>
+
+namespace Modbus_Cli {
+
+/*
+ * Machine readable output of read values. Records are collected in memory and
+ * written by flush() or when the buffer is full, bypassing the Qt logging.
+ * Safe to use from many threads.
+ *
+ * csv:     time_us,endpoint,slave,type,address,value   (one line per value)
+ * ndjson:  {"time_us":..,"endpoint":"..","slave":..,"type":"..","start":..,"values":[..]}
+ * binary:  one record per block (per 65535 values), little-endian:
+ *            u32 size of the rest of the record
+ *            u64 time_us (unix epoch)
+ *            u8  register type (1 discrete, 2 coils, 3 input, 4 holding)
+ *            u8  slave address
+ *            u16 start address
+ *            u16 value count
+ *            u16 endpoint length, endpoint bytes
+ *            u16 values[count]
+ *
+ * Typed values (see Value_Decoder) are written by write_value():
+ * csv:     time_us,endpoint,slave,type,address,name,value
+ * ndjson:  {"time_us":..,"endpoint":"..","slave":..,"type":"..","address":..,"name":"..","value":..}
+ * binary:  not written, raw registers are used instead
+ */
+class Output_Writer
+{
+public:
+    enum Format {
+        TEXT,
+        CSV,
+        NDJSON,
+        BINARY
+    };
+
+    static bool parse_format(const QString& text, Format& format);
+
+    Output_Writer(Format format, std::FILE* file, bool close_file);
+    ~Output_Writer();
+
+    /// Opens file_name or stdout if it is empty
+    static Output_Writer* open(Format format, const QString& file_name);
+
+    Format format() const;
+
+    void write(const QString& endpoint, int slave, QModbusDataUnit::RegisterType type, int start,
+               const quint16* values, int count);
+    /// Value is formatted already, text values are quoted
+    void write_value(const QString& endpoint, int slave, QModbusDataUnit::RegisterType type, int address,
+                     const QString& name, const char* value, int size, bool text);
+    void flush();
+private:
+    void format_csv(std::string& out, const QByteArray& endpoint, quint64 time_us, int slave,
+                    QModbusDataUnit::RegisterType type, int start, const quint16* values, int count) const;
+    void format_ndjson(std::string& out, const QByteArray& endpoint, quint64 time_us, int slave,
+                       QModbusDataUnit::RegisterType type, int start, const quint16* values, int count) const;
+    void format_binary(std::string& out, const QByteArray& endpoint, quint64 time_us, int slave,
+                       QModbusDataUnit::RegisterType type, int start, const quint16* values, int count) const;
+    void append_record(const std::string& record);
+    void flush_locked();
+
+    static const std::size_t flush_size = 64 * 1024;
+
+    Format _format;
+    std::FILE* _file;
+    bool _close_file;
+
+    std::mutex _mutex;
+    std::string _buffer;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_OUTPUT_WRITER_H
@@ -0,0 +1,346 @@
+#include <algorithm>
+
+#include <QString>
+
+#include "request.h"
+#include "protocol.h"
+
+namespace Modbus_Cli {
+
+QModbusDataUnit::RegisterType register_type_from_string(QString text)
+{
+    text = text.toLower();
+    if (text == "discrete") return QModbusDataUnit::DiscreteInputs;
+    else if (text == "coils") return QModbusDataUnit::Coils;
+    else if (text == "input_register") return QModbusDataUnit::InputRegisters;
+    else if (text == "holding_register") return QModbusDataUnit::HoldingRegisters;
+
+    return static_cast<QModbusDataUnit::RegisterType>(text.toInt());
+}
+
+QString register_type_to_string(QModbusDataUnit::RegisterType type)
+{
+    switch (type)
+    {
+    case QModbusDataUnit::DiscreteInputs:   return "discrete";
+    case QModbusDataUnit::Coils:            return "coils";
+    case QModbusDataUnit::InputRegisters:   return "input_register";
+    case QModbusDataUnit::HoldingRegisters: return "holding_register";
+    default:
+        break;
+    }
+    return QString::number(static_cast<int>(type));
+}
+
+bool is_bit_type(QModbusDataUnit::RegisterType type)
+{
+    return type == QModbusDataUnit::DiscreteInputs || type == QModbusDataUnit::Coils;
+}
+
+int max_read_count(QModbusDataUnit::RegisterType type)
+{
+    return is_bit_type(type) ? MAX_READ_BITS : MAX_READ_REGISTERS;
+}
+
+int max_write_count(QModbusDataUnit::RegisterType type)
+{
+    return is_bit_type(type) ? MAX_WRITE_BITS : MAX_WRITE_REGISTERS;
+}
+
+namespace {
+
+void split_read(const Request& request, QVector<Request>& parts)
+{
+    const int max_count = max_read_count(request._type);
+    for (int offset = 0; offset < request._count; offset += max_count)
+    {
+        Request part = request;
+        part._kind = Request::READ;
+        part._start = request._start + offset;
+        part._count = std::min(max_count, request._count - offset);
+        part._values.clear();
+        parts.push_back(part);
+    }
+}
+
+void split_write(const Request& request, QVector<Request>& parts)
+{
+    const int max_count = max_write_count(request._type);
+    for (int offset = 0; offset < request._values.size(); offset += max_count)
+    {
+        Request part = request;
+        part._kind = Request::WRITE;
+        part._start = request._start + offset;
+        part._values = request._values.mid(offset, max_count);
+        part._count = part._values.size();
+        parts.push_back(part);
+    }
+}
+
+} // namespace
+
+QVector<Request> split_request(const Request &request)
+{
+    QVector<Request> parts;
+    switch (request._kind)
+    {
+    case Request::READ:
+        if (request._count > max_read_count(request._type))
+            split_read(request, parts);
+        break;
+    case Request::WRITE:
+        if (request._values.size() > max_write_count(request._type))
+            split_write(request, parts);
+        break;
+    case Request::READ_WRITE:
+        if (request._count > MAX_READ_WRITE_READ || request._values.size() > MAX_READ_WRITE_WRITE)
+        {
+            // Function 23 writes before it reads, so do the same
+            split_write(request, parts);
+            split_read(request, parts);
+        }
+        break;
+    case Request::RAW:
+        break;
+    }
+    return parts;
+}
+
+namespace {
+
+void put_u16(QByteArray& data, int value)
+{
+    data.append(static_cast<char>((value >> 8) & 0xFF));
+    data.append(static_cast<char>(value & 0xFF));
+}
+
+quint16 get_u16(const QByteArray& data, int pos)
+{
+    return static_cast<quint16>((static_cast<quint8>(data.at(pos)) << 8) | static_cast<quint8>(data.at(pos + 1)));
+}
+
+quint8 read_function(QModbusDataUnit::RegisterType type)
+{
+    switch (type)
+    {
+    case QModbusDataUnit::Coils:            return QModbusPdu::ReadCoils;
+    case QModbusDataUnit::DiscreteInputs:   return QModbusPdu::ReadDiscreteInputs;
+    case QModbusDataUnit::HoldingRegisters: return QModbusPdu::ReadHoldingRegisters;
+    case QModbusDataUnit::InputRegisters:   return QModbusPdu::ReadInputRegisters;
+    default:
+        break;
+    }
+    return QModbusPdu::Invalid;
+}
+
+void put_values(QByteArray& data, QModbusDataUnit::RegisterType type, const QVector<quint16>& values)
+{
+    if (is_bit_type(type))
+    {
+        QByteArray bits((values.size() + 7) / 8, '\0');
+        for (int i = 0; i < values.size(); ++i)
+            if (values.at(i))
+                bits[i / 8] = static_cast<char>(bits.at(i / 8) | (1 << (i % 8)));
+        data.append(static_cast<char>(bits.size()));
+        data.append(bits);
+    }
+    else
+    {
+        data.append(static_cast<char>(values.size() * 2));
+        for (quint16 value: values)
+            put_u16(data, value);
+    }
+}
+
+bool get_values(const QByteArray& pdu, QModbusDataUnit::RegisterType type, int count, QVector<quint16>& values)
+{
+    if (pdu.size() < 2)
+        return false;
+
+    const int byte_count = static_cast<quint8>(pdu.at(1));
+    if (pdu.size() != 2 + byte_count)
+        return false;
+
+    values.resize(count);
+    if (is_bit_type(type))
+    {
+        if (byte_count != (count + 7) / 8)
+            return false;
+        for (int i = 0; i < count; ++i)
+            values[i] = (static_cast<quint8>(pdu.at(2 + i / 8)) >> (i % 8)) & 1;
+    }
+    else
+    {
+        if (byte_count != count * 2)
+            return false;
+        for (int i = 0; i < count; ++i)
+            values[i] = get_u16(pdu, 2 + i * 2);
+    }
+    return true;
+}
+
+} // namespace
+
+bool append_request(const Request &request, QByteArray &data)
+{
+    const int begin = data.size();
+    switch (request._kind)
+    {
+    case Request::READ:
+        data.append(static_cast<char>(read_function(request._type)));
+        put_u16(data, request._start);
+        put_u16(data, request._count);
+        break;
+
+    case Request::WRITE:
+        if (request._values.isEmpty())
+            return false;
+        if (request._type == QModbusDataUnit::Coils)
+        {
+            if (request._values.size() == 1)
+            {
+                data.append(static_cast<char>(QModbusPdu::WriteSingleCoil));
+                put_u16(data, request._start);
+                put_u16(data, request._values.front() ? 0xFF00 : 0x0000);
+                break;
+            }
+            data.append(static_cast<char>(QModbusPdu::WriteMultipleCoils));
+        }
+        else if (request._type == QModbusDataUnit::HoldingRegisters)
+        {
+            if (request._values.size() == 1)
+            {
+                data.append(static_cast<char>(QModbusPdu::WriteSingleRegister));
+                put_u16(data, request._start);
+                put_u16(data, request._values.front());
+                break;
+            }
+            data.append(static_cast<char>(QModbusPdu::WriteMultipleRegisters));
+        }
+        else
+            return false;
+        put_u16(data, request._start);
+        put_u16(data, request._values.size());
+        put_values(data, request._type, request._values);
+        break;
+
+    case Request::READ_WRITE:
+        if (request._type != QModbusDataUnit::HoldingRegisters || request._values.isEmpty())
+            return false;
+        data.append(static_cast<char>(QModbusPdu::ReadWriteMultipleRegisters));
+        put_u16(data, request._start);
+        put_u16(data, request._count);
+        put_u16(data, request._start);
+        put_u16(data, request._values.size());
+        put_values(data, request._type, request._values);
+        break;
+
+    case Request::RAW:
+        data.append(static_cast<char>(request._func));
+        data.append(request._data);
+        break;
+    }
+
+    if (data.size() == begin || data.at(begin) == QModbusPdu::Invalid)
+    {
+        data.truncate(begin);
+        return false;
+    }
+    return true;
+}
+
+QByteArray encode_request(const Request &request)
+{
+    QByteArray pdu;
+    return append_request(request, pdu) ? pdu : QByteArray();
+}
+
+int request_pdu_size(const Request &request)
+{
+    auto values_size = [&request]()
+    {
+        return is_bit_type(request._type) ? (request._values.size() + 7) / 8 : request._values.size() * 2;
+    };
+
+    switch (request._kind)
+    {
+    case Request::READ:
+        return 5;
+    case Request::WRITE:
+        if (request._values.isEmpty())
+            return 0;
+        return request._values.size() == 1 ? 5 : 6 + values_size();
+    case Request::READ_WRITE:
+        return request._values.isEmpty() ? 0 : 10 + values_size();
+    case Request::RAW:
+        return 1 + request._data.size();
+    }
+    return 0;
+}
+
+bool decode_response(const Request &request, const QByteArray &pdu, QModbusDataUnit &unit)
+{
+    if (pdu.isEmpty())
+        return false;
+
+    QVector<quint16> values;
+    switch (request._kind)
+    {
+    case Request::READ:
+        if (!get_values(pdu, request._type, request._count, values))
+            return false;
+        unit = QModbusDataUnit(request._type, request._start, values);
+        break;
+
+    case Request::WRITE:
+        if (pdu.size() != 5)
+            return false;
+        unit = QModbusDataUnit(request._type, request._start, request._values);
+        break;
+
+    case Request::READ_WRITE:
+        if (!get_values(pdu, request._type, request._count, values))
+            return false;
+        unit = QModbusDataUnit(request._type, request._start, values);
+        break;
+
+    case Request::RAW:
+        unit = QModbusDataUnit();
+        break;
+    }
+    return true;
+}
+
+int response_pdu_size(const quint8 *pdu, int available)
+{
+    if (available < 1)
+        return 0;
+
+    if (pdu[0] & 0x80)
+        return 2;
+
+    switch (pdu[0])
+    {
+    case QModbusPdu::ReadCoils:
+    case QModbusPdu::ReadDiscreteInputs:
+    case QModbusPdu::ReadHoldingRegisters:
+    case QModbusPdu::ReadInputRegisters:
+    case QModbusPdu::ReadWriteMultipleRegisters:
+    case QModbusPdu::ReportServerId:
+        return available < 2 ? 0 : 2 + pdu[1];
+    case QModbusPdu::WriteSingleCoil:
+    case QModbusPdu::WriteSingleRegister:
+    case QModbusPdu::WriteMultipleCoils:
+    case QModbusPdu::WriteMultipleRegisters:
+        return 5;
+    case QModbusPdu::ReadExceptionStatus:
+        return 2;
+    case QModbusPdu::MaskWriteRegister:
+        return 7;
+    default:
+        break;
+    }
+    return -1;
+}
+
+} // namespace Modbus_Cli
@@ -0,0 +1,52 @@
+#ifndef MODBUS_CLI_PROTOCOL_H
+#define MODBUS_CLI_PROTOCOL_H
+
+#include <QModbusDataUnit>
+#include <QByteArray>
+
+namespace Modbus_Cli {
+
+enum Protocol_Limits {
+    MAX_READ_REGISTERS = 125,
+    MAX_READ_BITS = 2000,
+    MAX_WRITE_REGISTERS = 123,
+    MAX_WRITE_BITS = 1968,
+    MAX_READ_WRITE_READ = 125,      ///< Read part of function 23
+    MAX_READ_WRITE_WRITE = 121      ///< Write part of function 23
+};
+
+QModbusDataUnit::RegisterType register_type_from_string(QString text);
+QString register_type_to_string(QModbusDataUnit::RegisterType type);
+
+bool is_bit_type(QModbusDataUnit::RegisterType type);
+
+/// Maximum value count of one read request for register type
+int max_read_count(QModbusDataUnit::RegisterType type);
+
+/// Maximum value count of one write request for register type
+int max_write_count(QModbusDataUnit::RegisterType type);
+
+struct Request;
+
+/// Parts of request that fit into protocol limits, in address order. Empty if it fits as is.
+/// Oversized read-write is done as writes followed by reads.
+QVector<Request> split_request(const Request& request);
+
+/// Request PDU: function code and data. Empty if request can't be encoded.
+QByteArray encode_request(const Request& request);
+
+/// Size of request PDU without encoding it, 0 if request can't be encoded
+int request_pdu_size(const Request& request);
+
+/// Appends request PDU to data, e.g. right after a transport header. Returns false and leaves data as is if request can't be encoded.
+bool append_request(const Request& request, QByteArray& data);
+
+/// Fills unit from response PDU of request. Returns false if response doesn't match request.
+bool decode_response(const Request& request, const QByteArray& pdu, QModbusDataUnit& unit);
+
+/// Size of response PDU by its first bytes. 0 if more bytes needed, -1 if size is unknown for function code.
+int response_pdu_size(const quint8* pdu, int available);
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_PROTOCOL_H
@@ -0,0 +1,84 @@
+#include <algorithm>
+
+#include "register_cache.h"
+
+namespace Modbus_Cli {
+
+namespace {
+const int table_size = 0x10000;
+} // namespace
+
+Register_Cache::Register_Cache()
+{
+    _clock.start();
+}
+
+bool Register_Cache::get(int server_address, QModbusDataUnit::RegisterType type, int start, int count, qint64 max_age_ms,
+                         QVector<quint16> &values) const
+{
+    const auto it = _tables.constFind(key(server_address, type));
+    if (it == _tables.constEnd() || start < 0 || count <= 0 || start + count > table_size)
+        return false;
+
+    const Table& table = it.value();
+    const qint64 oldest = now() - max_age_ms;
+    const qint64* read_at = table._read_at.constData() + start;
+    for (int i = 0; i < count; ++i)
+        if (read_at[i] == 0 || read_at[i] < oldest)
+            return false;
+
+    values = table._values.mid(start, count);
+    return true;
+}
+
+void Register_Cache::put(int server_address, QModbusDataUnit::RegisterType type, int start, const QVector<quint16> &values)
+{
+    const int count = std::min(values.size(), table_size - start);
+    if (start < 0 || count <= 0)
+        return;
+
+    Table& table = _tables[key(server_address, type)];
+    if (table._values.isEmpty())
+    {
+        table._values.resize(table_size);
+        table._read_at.fill(0, table_size);
+    }
+
+    const qint64 read_at = now();
+    std::copy(values.constBegin(), values.constBegin() + count, table._values.begin() + start);
+    std::fill(table._read_at.begin() + start, table._read_at.begin() + start + count, read_at);
+}
+
+void Register_Cache::invalidate(int server_address, QModbusDataUnit::RegisterType type, int start, int count)
+{
+    if (start < 0)
+    {
+        count += start;
+        start = 0;
+    }
+    count = std::min(count, table_size - start);
+    if (count <= 0)
+        return;
+
+    for (auto it = _tables.begin(); it != _tables.end(); ++it)
+        if (it.key() == key(server_address, type) || (server_address == 0 && (it.key() & 0xFF) == type))
+            std::fill(it.value()._read_at.begin() + start, it.value()._read_at.begin() + start + count, 0);
+}
+
+void Register_Cache::clear()
+{
+    _tables.clear();
+}
+
+/*static*/ int Register_Cache::key(int server_address, QModbusDataUnit::RegisterType type)
+{
+    return server_address << 8 | type;
+}
+
+qint64 Register_Cache::now() const
+{
+    // Never 0, it means not read
+    return _clock.elapsed() + 1;
+}
+
+} // namespace Modbus_Cli
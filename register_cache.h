@@ -0,0 +1,40 @@
+#ifndef MODBUS_CLI_REGISTER_CACHE_H
+#define MODBUS_CLI_REGISTER_CACHE_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVector>
+#include <QModbusDataUnit>
+
+namespace Modbus_Cli {
+
+/// Last read value of every register with the time it was read, by slave and register type
+class Register_Cache
+{
+public:
+    Register_Cache();
+
+    /// Fills values if every register of the range is cached and not older than max_age_ms
+    bool get(int server_address, QModbusDataUnit::RegisterType type, int start, int count, qint64 max_age_ms,
+             QVector<quint16>& values) const;
+    void put(int server_address, QModbusDataUnit::RegisterType type, int start, const QVector<quint16>& values);
+    /// Server address 0 is broadcast: the range of every slave is dropped
+    void invalidate(int server_address, QModbusDataUnit::RegisterType type, int start, int count);
+    void clear();
+private:
+    struct Table
+    {
+        QVector<quint16> _values;
+        QVector<qint64> _read_at;   ///< 0 is never read
+    };
+
+    static int key(int server_address, QModbusDataUnit::RegisterType type);
+    qint64 now() const;
+
+    QElapsedTimer _clock;
+    QHash<int, Table> _tables;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_REGISTER_CACHE_H
@@ -0,0 +1,199 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+#include <QFile>
+#include <QDebug>
+
+#include "register_image.h"
+
+namespace Modbus_Cli {
+
+static_assert(sizeof(Register_Image::Image_Header) == 64, "Image header layout is documented");
+static_assert(sizeof(Register_Image::Image_Block) == 128, "Image block layout is documented");
+
+namespace {
+
+quint64 now_us()
+{
+    using namespace std::chrono;
+    return static_cast<quint64>(duration_cast<microseconds>(system_clock::now().time_since_epoch()).count());
+}
+
+} // namespace
+
+/*static*/ Register_Image *Register_Image::open(const QString &file_name, int max_blocks, int max_values)
+{
+    const std::size_t blocks_offset = sizeof(Image_Header);
+    const std::size_t values_offset = blocks_offset + static_cast<std::size_t>(max_blocks) * sizeof(Image_Block);
+    const std::size_t size = values_offset + static_cast<std::size_t>(max_values) * sizeof(quint16);
+
+    // A new inode: readers of a previous image keep their mapping valid and reopen when they see the change
+    const QByteArray path = QFile::encodeName(file_name);
+    ::unlink(path.constData());
+    const int fd = ::open(path.constData(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        qCritical().noquote() << "Can't create register image" << file_name << std::strerror(errno);
+        return nullptr;
+    }
+
+    void* data = MAP_FAILED;
+    if (::ftruncate(fd, static_cast<off_t>(size)) == 0)
+        data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        qCritical().noquote() << "Can't map register image" << file_name << std::strerror(errno);
+        ::close(fd);
+        return nullptr;
+    }
+
+    // The file is zero filled
+    Register_Image* image = new Register_Image{fd, data, size};
+    Image_Header* header = image->header();
+    std::memcpy(header->_magic, "MBIMAGE", sizeof(header->_magic));
+    header->_version = 1;
+    header->_max_blocks = static_cast<quint32>(max_blocks);
+    header->_max_values = static_cast<quint32>(max_values);
+    header->_blocks_offset = static_cast<quint32>(blocks_offset);
+    header->_values_offset = static_cast<quint32>(values_offset);
+    header->_created_us = now_us();
+    header->_block_count.store(0, std::memory_order_release);
+    return image;
+}
+
+Register_Image::Register_Image(int fd, void *data, std::size_t size) :
+    _fd(fd),
+    _data(data),
+    _size(size),
+    _values_used(0)
+{
+}
+
+Register_Image::~Register_Image()
+{
+    ::munmap(_data, _size);
+    ::close(_fd);
+}
+
+int Register_Image::block(const QString &endpoint, int slave, QModbusDataUnit::RegisterType type, int start, int count,
+                          bool relative)
+{
+    const QByteArray name = endpoint.toUtf8().left(sizeof(Image_Block::_endpoint) - 1);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Image_Header* image_header = header();
+    const quint32 block_count = image_header->_block_count.load(std::memory_order_relaxed);
+    for (quint32 i = 0; i < block_count && !relative; ++i)
+    {
+        const Image_Block& block = blocks()[i];
+        if (block._slave == slave && block._type == type && block._start == start && block._count == count
+                && name == block._endpoint)
+            return static_cast<int>(i);
+    }
+
+    if (block_count >= image_header->_max_blocks || _values_used + count > image_header->_max_values)
+    {
+        qWarning().noquote() << "Register image is full, not published:" << endpoint << slave << type << start << count;
+        return -1;
+    }
+
+    // Readers see the block once _block_count covers it
+    Image_Block& block = blocks()[block_count];
+    block._seq.store(0, std::memory_order_relaxed);
+    block._slave = static_cast<quint8>(slave);
+    block._type = static_cast<quint8>(type);
+    block._start = static_cast<quint16>(start);
+    block._count = static_cast<quint16>(count);
+    block._quality = 0;
+    block._values_index = _values_used;
+    std::memcpy(block._endpoint, name.constData(), static_cast<std::size_t>(name.size()));
+    _values_used += count;
+
+    image_header->_block_count.store(block_count + 1, std::memory_order_release);
+    return static_cast<int>(block_count);
+}
+
+void Register_Image::publish(int block_index, int start, const quint16 *data, int count)
+{
+    Image_Block& block = blocks()[block_index];
+    const quint32 seq = block._seq.load(std::memory_order_relaxed);
+    block._seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    block._start = static_cast<quint16>(start);
+    std::memcpy(values() + block._values_index, data, sizeof(quint16) * std::min<std::size_t>(count, block._count));
+    block._quality = QUALITY_VALID;
+    block._read_time_us = block._update_time_us = now_us();
+    block._failures = 0;
+    block._exception = 0;
+
+    block._seq.store(seq + 2, std::memory_order_release);
+}
+
+void Register_Image::publish_failure(int block_index, quint16 quality, int exception_code)
+{
+    Image_Block& block = blocks()[block_index];
+    const quint32 seq = block._seq.load(std::memory_order_relaxed);
+    block._seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    block._quality = static_cast<quint16>((block._quality & QUALITY_VALID) | QUALITY_STALE | quality);
+    block._update_time_us = now_us();
+    ++block._failures;
+    block._exception = static_cast<quint8>(exception_code);
+
+    block._seq.store(seq + 2, std::memory_order_release);
+}
+
+/*static*/ bool Register_Image::read_block(const void *image, int block_index, Image_Block &out, quint16 *data, int max_count)
+{
+    const char* base = static_cast<const char*>(image);
+    const Image_Header* image_header = static_cast<const Image_Header*>(image);
+    if (block_index < 0 || static_cast<quint32>(block_index) >= image_header->_block_count.load(std::memory_order_acquire))
+        return false;
+
+    const Image_Block* block = reinterpret_cast<const Image_Block*>(base + image_header->_blocks_offset) + block_index;
+    const quint16* block_values = reinterpret_cast<const quint16*>(base + image_header->_values_offset);
+    const std::size_t offset = sizeof(block->_seq);
+    for (;;)
+    {
+        const quint32 seq = block->_seq.load(std::memory_order_acquire);
+        if (seq & 1)
+            continue;
+
+        std::memcpy(reinterpret_cast<char*>(&out) + offset, reinterpret_cast<const char*>(block) + offset,
+                    sizeof(Image_Block) - offset);
+        std::memcpy(data, block_values + out._values_index,
+                    sizeof(quint16) * std::min<std::size_t>(std::max(max_count, 0), out._count));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (block->_seq.load(std::memory_order_relaxed) == seq)
+        {
+            out._seq.store(seq, std::memory_order_relaxed);
+            return true;
+        }
+    }
+}
+
+Register_Image::Image_Header *Register_Image::header() const
+{
+    return static_cast<Image_Header*>(_data);
+}
+
+Register_Image::Image_Block *Register_Image::blocks() const
+{
+    return reinterpret_cast<Image_Block*>(static_cast<char*>(_data) + header()->_blocks_offset);
+}
+
+quint16 *Register_Image::values() const
+{
+    return reinterpret_cast<quint16*>(static_cast<char*>(_data) + header()->_values_offset);
+}
+
+} // namespace Modbus_Cli
@@ -0,0 +1,105 @@
+#ifndef MODBUS_CLI_REGISTER_IMAGE_H
+#define MODBUS_CLI_REGISTER_IMAGE_H
+
+#include <atomic>
+#include <mutex>
+
+#include <QModbusDataUnit>
+#include <QString>
+
+namespace Modbus_Cli {
+
+/*
+ * Polled values published in a shared memory-mapped file, for local readers without syscalls or locks.
+ * All numbers are little-endian (host order), the file size never changes:
+ *
+ *   Image_Header                               at 0, 64 bytes
+ *   Image_Block[header._max_blocks]            at header._blocks_offset, 128 bytes each
+ *   u16 values[header._max_values]             at header._values_offset
+ *
+ * A block is one polled range of one device: connection string, slave, register type, start and count.
+ * A relative scan block (see scan_list.h) has a block of its own, its _start is the start of its last read.
+ * Blocks are only added, header._block_count is their number. Values of block b are
+ * values[blocks[b]._values_index .. + blocks[b]._count].
+ *
+ * Every block is a seqlock: _seq is odd while the block is written. A reader copies the block and its values
+ * between two loads of _seq and retries if they differ or are odd, see read_block().
+ */
+class Register_Image
+{
+public:
+    enum Quality
+    {
+        QUALITY_VALID = 0x01,       ///< Values were read at least once
+        QUALITY_STALE = 0x02,       ///< Last read failed, values are from _read_time_us
+        QUALITY_TIMEOUT = 0x04,     ///< Last read failed by timeout
+        QUALITY_EXCEPTION = 0x08,   ///< Last read got Modbus exception _exception
+        QUALITY_ERROR = 0x10        ///< Last read failed otherwise
+    };
+
+    struct Image_Header
+    {
+        char _magic[8];             ///< "MBIMAGE" and zero
+        quint32 _version;           ///< 1
+        quint32 _max_blocks;
+        quint32 _max_values;
+        std::atomic<quint32> _block_count;
+        quint32 _blocks_offset;
+        quint32 _values_offset;
+        quint64 _created_us;        ///< Unix epoch. A new file means blocks may differ
+        char _reserved[24];
+    };
+
+    struct Image_Block
+    {
+        std::atomic<quint32> _seq;
+        quint8 _slave;
+        quint8 _type;               ///< 1 discrete, 2 coils, 3 input, 4 holding
+        quint16 _start;
+        quint16 _count;
+        quint16 _quality;           ///< Quality flags
+        quint32 _values_index;
+        quint64 _read_time_us;      ///< Last successful read, unix epoch
+        quint64 _update_time_us;    ///< Last read attempt
+        quint32 _failures;          ///< Failed reads in a row
+        quint8 _exception;
+        char _reserved[3];
+        char _endpoint[88];         ///< Connection string, zero terminated, may be truncated
+    };
+
+    static const int default_max_blocks = 4096;
+    static const int default_max_values = 1 << 20;
+
+    /// Creates the file of fixed size and maps it, null on failure
+    static Register_Image* open(const QString& file_name, int max_blocks = default_max_blocks,
+                                int max_values = default_max_values);
+    ~Register_Image();
+
+    /// Index of the block, added on first use, a relative one is always added. -1 if the image is full
+    int block(const QString& endpoint, int slave, QModbusDataUnit::RegisterType type, int start, int count,
+              bool relative = false);
+
+    /// Only the thread of the block connection writes it, no allocations or locks. start moves a relative block
+    void publish(int block, int start, const quint16* values, int count);
+    void publish_failure(int block, quint16 quality, int exception_code);
+
+    /// Consistent copy of a block and up to max_count of its values from a mapped image
+    static bool read_block(const void* image, int block, Image_Block& out, quint16* values, int max_count);
+private:
+    Register_Image(int fd, void* data, std::size_t size);
+
+    Image_Header* header() const;
+    Image_Block* blocks() const;
+    quint16* values() const;
+
+    int _fd;
+    void* _data;
+    std::size_t _size;
+
+    std::mutex _mutex;          ///< Adding blocks from many threads
+    quint32 _values_used;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_REGISTER_IMAGE_H
@@ -0,0 +1,61 @@
+#ifndef MODBUS_CLI_REQUEST_H
+#define MODBUS_CLI_REQUEST_H
+
+#include <chrono>
+
+#include <QModbusDataUnit>
+#include <QModbusPdu>
+
+namespace Modbus_Cli {
+
+struct Request
+{
+    enum Kind {
+        READ,
+        WRITE,
+        READ_WRITE,
+        RAW
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    static Clock::time_point no_deadline() { return Clock::time_point::max(); }
+
+    static Request read(int server_address, QModbusDataUnit::RegisterType type, int start, int count)
+    {
+        return Request{READ, server_address, type, start, count, {}, QModbusPdu::Invalid, {}, 0, -1, 0, no_deadline(), -1};
+    }
+    static Request write(int server_address, QModbusDataUnit::RegisterType type, int start, const QVector<quint16>& values)
+    {
+        return Request{WRITE, server_address, type, start, values.size(), values, QModbusPdu::Invalid, {}, 0, -1, 0, no_deadline(), -1};
+    }
+    static Request read_write(int server_address, QModbusDataUnit::RegisterType type, int start, int count, const QVector<quint16>& values)
+    {
+        return Request{READ_WRITE, server_address, type, start, count, values, QModbusPdu::Invalid, {}, 0, -1, 0, no_deadline(), -1};
+    }
+    static Request raw(int server_address, QModbusPdu::FunctionCode func, const QByteArray& data)
+    {
+        return Request{RAW, server_address, QModbusDataUnit::Invalid, 0, 0, {}, func, data, 0, -1, 0, no_deadline(), -1};
+    }
+
+    Kind _kind;
+    int _server_address;
+    QModbusDataUnit::RegisterType _type;
+    int _start;
+    int _count;
+    QVector<quint16> _values;
+    QModbusPdu::FunctionCode _func;
+    QByteArray _data;
+
+    int _id;    ///< Caller defined, passed back with result
+    int _slot;  ///< Caller defined fixed image place of a read whose start varies, -1 if the range is the place
+
+    int _priority;                  ///< Higher goes to the line first when requests wait for it
+    Clock::time_point _deadline;    ///< Among equal priority earlier deadline goes first
+
+    int _part;  ///< Set by Client: oversized request this one is a part of, -1 if none
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_REQUEST_H
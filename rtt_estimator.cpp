@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "rtt_estimator.h"
+
+namespace Modbus_Cli {
+
+Rtt_Estimator::Rtt_Estimator(int min_ms, int max_ms) :
+    _min_ms(min_ms),
+    _max_ms(std::max(min_ms, max_ms)),
+    _has_sample(false),
+    _srtt_us(0),
+    _rttvar_us(0),
+    _backoff_shift(0)
+{
+}
+
+void Rtt_Estimator::add_sample(qint64 rtt_us)
+{
+    if (_has_sample)
+    {
+        _rttvar_us = (3 * _rttvar_us + std::llabs(_srtt_us - rtt_us)) / 4;
+        _srtt_us = (7 * _srtt_us + rtt_us) / 8;
+    }
+    else
+    {
+        _srtt_us = rtt_us;
+        _rttvar_us = rtt_us / 2;
+        _has_sample = true;
+    }
+    _backoff_shift = 0;
+}
+
+void Rtt_Estimator::backoff()
+{
+    if (_backoff_shift < 16)
+        ++_backoff_shift;
+}
+
+int Rtt_Estimator::timeout_ms() const
+{
+    if (!_has_sample)
+        return _max_ms;
+
+    // One millisecond is the clock granularity of Qt timers
+    const qint64 rto_us = _srtt_us + std::max<qint64>(1000, 4 * _rttvar_us);
+    const qint64 rto_ms = ((rto_us + 999) / 1000) << _backoff_shift;
+    return static_cast<int>(std::max<qint64>(_min_ms, std::min<qint64>(_max_ms, rto_ms)));
+}
+
+qint64 Rtt_Estimator::srtt_us() const
+{
+    return _srtt_us;
+}
+
+} // namespace Modbus_Cli
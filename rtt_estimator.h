@@ -0,0 +1,35 @@
+#ifndef MODBUS_CLI_RTT_ESTIMATOR_H
+#define MODBUS_CLI_RTT_ESTIMATOR_H
+
+#include <QtGlobal>
+
+namespace Modbus_Cli {
+
+/*
+ * Response timeout of one device derived from its round trip times, as TCP RTO (RFC 6298):
+ * smoothed RTT plus four deviations, kept within [min_ms, max_ms].
+ * Every timeout doubles it until the next answer. Before the first answer it is max_ms.
+ */
+class Rtt_Estimator
+{
+public:
+    Rtt_Estimator(int min_ms = 0, int max_ms = 0);
+
+    /// Round trip of a request sent once. Retried requests must not be sampled, their answer is ambiguous.
+    void add_sample(qint64 rtt_us);
+    void backoff();
+
+    int timeout_ms() const;
+    qint64 srtt_us() const;
+private:
+    int _min_ms;
+    int _max_ms;
+    bool _has_sample;
+    qint64 _srtt_us;
+    qint64 _rttvar_us;
+    int _backoff_shift;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_RTT_ESTIMATOR_H
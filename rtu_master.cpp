@@ -0,0 +1,580 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+
+#include <QMetaObject>
+
+#include "crc16.h"
+#include "protocol.h"
+#include "rtu_master.h"
+
+namespace Modbus_Cli {
+
+namespace {
+
+bool baud_to_speed(int baud_rate, speed_t& speed)
+{
+    switch (baud_rate)
+    {
+    case 1200:   speed = B1200;   break;
+    case 2400:   speed = B2400;   break;
+    case 4800:   speed = B4800;   break;
+    case 9600:   speed = B9600;   break;
+    case 19200:  speed = B19200;  break;
+    case 38400:  speed = B38400;  break;
+    case 57600:  speed = B57600;  break;
+    case 115200: speed = B115200; break;
+#ifdef B230400
+    case 230400: speed = B230400; break;
+#endif
+#ifdef B460800
+    case 460800: speed = B460800; break;
+#endif
+#ifdef B921600
+    case 921600: speed = B921600; break;
+#endif
+    default: return false;
+    }
+    return true;
+}
+
+timespec to_timespec(std::chrono::microseconds us)
+{
+    if (us.count() < 0)
+        us = std::chrono::microseconds::zero();
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(us.count() / 1000000);
+    ts.tv_nsec = static_cast<long>(us.count() % 1000000) * 1000;
+    return ts;
+}
+
+} // namespace
+
+Rtu_Master::Rtu_Master(const Das::Modbus::Config &config, QObject *parent) :
+    Device(parent),
+    _config(config),
+    _fd(-1),
+    _wake_fd(-1),
+    _stop(false),
+    _state(QModbusDevice::UnconnectedState),
+    _error(QModbusDevice::NoError),
+    _next_id(0)
+{
+    frame_timing(_config._rtu, _t15_us, _t35_us);
+}
+
+Rtu_Master::~Rtu_Master()
+{
+    close_port();
+}
+
+/*static*/ void Rtu_Master::frame_timing(const Das::Modbus::Rtu_Config &config, int &t15_us, int &t35_us)
+{
+    if (config._baud_rate > 19200)
+    {
+        // Fixed values recommended by Modbus over serial line spec for high baud rates
+        t15_us = 750;
+        t35_us = 1750;
+    }
+    else
+    {
+        const int bits = 1 + config._data_bits
+                + (config._parity == QSerialPort::NoParity ? 0 : 1)
+                + (config._stop_bits == QSerialPort::OneStop ? 1 : 2);
+        const int baud_rate = config._baud_rate > 0 ? config._baud_rate : 9600;
+        const int char_us = bits * 1000000 / baud_rate;
+        t15_us = char_us * 3 / 2;
+        t35_us = char_us * 7 / 2;
+    }
+
+    if (config._frame_delay_microseconds > 0)
+        t35_us = config._frame_delay_microseconds;
+}
+
+bool Rtu_Master::connect_device()
+{
+    if (_state != QModbusDevice::UnconnectedState)
+        return true;
+
+    set_state(QModbusDevice::ConnectingState);
+    if (!open_port())
+    {
+        close_port();
+        set_state(QModbusDevice::UnconnectedState);
+        set_error(QModbusDevice::ConnectionError, _error_string);
+        return false;
+    }
+
+    _stop = false;
+    _last_activity = std::chrono::steady_clock::now();
+    _thread = std::thread(&Rtu_Master::io_loop, this);
+
+    // Same as Qt devices: connected state is reported from event loop
+    QMetaObject::invokeMethod(this, [this]() {
+        if (_state == QModbusDevice::ConnectingState)
+            set_state(QModbusDevice::ConnectedState);
+    }, Qt::QueuedConnection);
+    return true;
+}
+
+void Rtu_Master::disconnect_device()
+{
+    if (_state == QModbusDevice::UnconnectedState)
+        return;
+
+    set_state(QModbusDevice::ClosingState);
+    close_port();
+
+    const auto replies = _replies.values();
+    _replies.clear();
+    for (const auto& item: replies)
+        if (item.first)
+            item.first->setError(QModbusDevice::ReplyAbortedError, tr("Device disconnected"));
+
+    set_state(QModbusDevice::UnconnectedState);
+}
+
+QModbusDevice::State Rtu_Master::state() const
+{
+    return _state;
+}
+
+QModbusDevice::Error Rtu_Master::error() const
+{
+    return _error;
+}
+
+QString Rtu_Master::error_string() const
+{
+    return _error_string;
+}
+
+QModbusReply *Rtu_Master::send(const Request &request, int timeout_ms)
+{
+    if (_state != QModbusDevice::ConnectedState)
+    {
+        _error = QModbusDevice::ConnectionError;
+        _error_string = tr("Device not connected");
+        return nullptr;
+    }
+
+    const QByteArray pdu = encode_request(request);
+    if (pdu.isEmpty())
+    {
+        _error = QModbusDevice::ProtocolError;
+        _error_string = tr("Invalid request");
+        return nullptr;
+    }
+
+    QByteArray adu;
+    adu.reserve(pdu.size() + 3);
+    adu.append(static_cast<char>(request._server_address));
+    adu.append(pdu);
+    const quint16 crc = crc16(reinterpret_cast<const quint8*>(adu.constData()), adu.size());
+    adu.append(static_cast<char>(crc & 0xFF));
+    adu.append(static_cast<char>(crc >> 8));
+
+    auto reply = new QModbusReply(request._kind == Request::RAW ? QModbusReply::Raw : QModbusReply::Common,
+                                  request._server_address, this);
+    const quint64 id = ++_next_id;
+    _replies.insert(id, qMakePair(QPointer<QModbusReply>(reply), request));
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.push_back(Transaction{id, adu, request._server_address == 0, timeout_ms});
+    }
+
+    const uint64_t one = 1;
+    (void)!::write(_wake_fd, &one, sizeof(one));
+    return reply;
+}
+
+bool Rtu_Master::open_port()
+{
+    const Das::Modbus::Rtu_Config& rtu = _config._rtu;
+    QString name = rtu._name;
+    if (!name.startsWith('/'))
+        name.prepend("/dev/");
+
+    _fd = ::open(name.toLocal8Bit().constData(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (_fd < 0)
+    {
+        _error_string = tr("Can't open %1: %2").arg(name).arg(strerror(errno));
+        return false;
+    }
+
+    termios tio;
+    if (tcgetattr(_fd, &tio) != 0)
+    {
+        _error_string = tr("Can't get port attributes: %1").arg(strerror(errno));
+        return false;
+    }
+
+    cfmakeraw(&tio);
+
+    speed_t speed;
+    if (!baud_to_speed(rtu._baud_rate, speed))
+    {
+        _error_string = tr("Unsupported baud rate: %1").arg(rtu._baud_rate);
+        return false;
+    }
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+
+    tio.c_cflag &= ~static_cast<tcflag_t>(CSIZE | PARENB | PARODD | CSTOPB | CRTSCTS);
+#ifdef CMSPAR
+    tio.c_cflag &= ~static_cast<tcflag_t>(CMSPAR);
+#endif
+    tio.c_iflag &= ~static_cast<tcflag_t>(IXON | IXOFF | IXANY);
+
+    switch (rtu._data_bits)
+    {
+    case QSerialPort::Data5: tio.c_cflag |= CS5; break;
+    case QSerialPort::Data6: tio.c_cflag |= CS6; break;
+    case QSerialPort::Data7: tio.c_cflag |= CS7; break;
+    default:                 tio.c_cflag |= CS8; break;
+    }
+
+    switch (rtu._parity)
+    {
+    case QSerialPort::EvenParity: tio.c_cflag |= PARENB; break;
+    case QSerialPort::OddParity:  tio.c_cflag |= PARENB | PARODD; break;
+#ifdef CMSPAR
+    case QSerialPort::SpaceParity: tio.c_cflag |= PARENB | CMSPAR; break;
+    case QSerialPort::MarkParity:  tio.c_cflag |= PARENB | CMSPAR | PARODD; break;
+#endif
+    default: break;
+    }
+
+    if (rtu._stop_bits == QSerialPort::TwoStop)
+        tio.c_cflag |= CSTOPB;
+
+    if (rtu._flow_control == QSerialPort::HardwareControl)
+        tio.c_cflag |= CRTSCTS;
+    else if (rtu._flow_control == QSerialPort::SoftwareControl)
+        tio.c_iflag |= IXON | IXOFF;
+
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+
+    if (tcsetattr(_fd, TCSANOW, &tio) != 0)
+    {
+        _error_string = tr("Can't set port attributes: %1").arg(strerror(errno));
+        return false;
+    }
+
+#ifdef __linux__
+    // Don't let the driver hold received bytes for its latency timer. Not supported by every driver.
+    serial_struct serial;
+    if (ioctl(_fd, TIOCGSERIAL, &serial) == 0)
+    {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        ioctl(_fd, TIOCSSERIAL, &serial);
+    }
+#endif
+
+    tcflush(_fd, TCIOFLUSH);
+
+    _wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_wake_fd < 0)
+    {
+        _error_string = tr("Can't create eventfd: %1").arg(strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void Rtu_Master::close_port()
+{
+    if (_thread.joinable())
+    {
+        _stop = true;
+        const uint64_t one = 1;
+        (void)!::write(_wake_fd, &one, sizeof(one));
+        _thread.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _queue.clear();
+    }
+
+    if (_fd >= 0)
+    {
+        ::close(_fd);
+        _fd = -1;
+    }
+    if (_wake_fd >= 0)
+    {
+        ::close(_wake_fd);
+        _wake_fd = -1;
+    }
+}
+
+void Rtu_Master::io_loop()
+{
+    while (!_stop)
+    {
+        Transaction transaction;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_queue.empty())
+            {
+                transaction = std::move(_queue.front());
+                _queue.pop_front();
+            }
+            else
+                transaction._id = 0;
+        }
+
+        if (transaction._id == 0)
+        {
+            pollfd wake{_wake_fd, POLLIN, 0};
+            if (ppoll(&wake, 1, nullptr, nullptr) > 0)
+            {
+                uint64_t value;
+                (void)!::read(_wake_fd, &value, sizeof(value));
+            }
+            continue;
+        }
+
+        const Result result = transact(transaction);
+        QMetaObject::invokeMethod(this, [this, result]() { finish(result); }, Qt::QueuedConnection);
+    }
+}
+
+Rtu_Master::Result Rtu_Master::transact(const Transaction &transaction)
+{
+    using namespace std::chrono;
+    Result result{transaction._id, QModbusDevice::NoError, QString(), QByteArray()};
+
+    // The bus must be silent for t3.5 between frames
+    wait_until(_last_activity + microseconds(_t35_us));
+    tcflush(_fd, TCIFLUSH);
+
+    const auto write_deadline = steady_clock::now() + milliseconds(transaction._timeout_ms);
+    if (!write_all(transaction._adu, write_deadline) || !drain(write_deadline))
+    {
+        result._error = _stop ? QModbusDevice::ReplyAbortedError : QModbusDevice::WriteError;
+        result._error_string = tr("Write failed: %1").arg(strerror(errno));
+        return result;
+    }
+    _last_activity = steady_clock::now();
+
+    if (transaction._broadcast)
+    {
+        // Nobody answers a broadcast, give slaves time to process it
+        wait_until(_last_activity + _config._turnaround);
+        _last_activity = steady_clock::now();
+        return result;
+    }
+
+    const auto deadline = _last_activity + milliseconds(transaction._timeout_ms);
+    quint8 buffer[256];
+    int size = 0;
+    int expected = 0; // 0 - unknown yet, -1 - unknown for function code, wait for silence
+
+    while (size < static_cast<int>(sizeof(buffer)))
+    {
+        const auto now = steady_clock::now();
+        if (now >= deadline)
+            break;
+
+        auto until = deadline;
+        if (size > 0 && expected <= 0)
+        {
+            const auto silence_end = _last_activity + microseconds(_t35_us);
+            if (now >= silence_end)
+                break; // End of frame by t3.5 silence
+            until = std::min(until, silence_end);
+        }
+
+        const int ret = poll_port(POLLIN, until);
+        if (ret < 0)
+        {
+            result._error = _stop ? QModbusDevice::ReplyAbortedError : QModbusDevice::ReadError;
+            result._error_string = _stop ? tr("Port closed") : tr("Poll failed: %1").arg(strerror(errno));
+            return result;
+        }
+        if (ret == 0)
+            continue;
+
+        const ssize_t n = ::read(_fd, buffer + size, sizeof(buffer) - static_cast<size_t>(size));
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                continue;
+            result._error = QModbusDevice::ReadError;
+            result._error_string = tr("Read failed: %1").arg(strerror(errno));
+            return result;
+        }
+        size += static_cast<int>(n);
+        _last_activity = steady_clock::now();
+
+        if (expected == 0 && size > 1)
+        {
+            const int pdu_size = response_pdu_size(buffer + 1, size - 1);
+            expected = pdu_size > 0 ? pdu_size + 3 : pdu_size;
+        }
+        if (expected > 0 && size >= expected)
+            break;
+    }
+
+    if (size == 0 || (expected > 0 && size < expected))
+    {
+        result._error = QModbusDevice::TimeoutError;
+        result._error_string = tr("Response timeout");
+        return result;
+    }
+
+    if (expected > 0)
+        size = expected;
+
+    const quint8 address = static_cast<quint8>(transaction._adu.at(0));
+    const quint8 function = static_cast<quint8>(transaction._adu.at(1));
+    if (size < 4 || crc16(buffer, size - 2) != static_cast<quint16>(buffer[size - 2] | (buffer[size - 1] << 8)))
+    {
+        result._error = QModbusDevice::ReadError;
+        result._error_string = tr("Invalid CRC");
+    }
+    else if (buffer[0] != address || (buffer[1] & 0x7F) != function)
+    {
+        result._error = QModbusDevice::ReadError;
+        result._error_string = tr("Unexpected response from %1 function 0x%2").arg(buffer[0]).arg(buffer[1], 2, 16, QChar('0'));
+    }
+    else
+        result._pdu = QByteArray(reinterpret_cast<const char*>(buffer + 1), size - 3);
+    return result;
+}
+
+int Rtu_Master::poll_port(short events, std::chrono::steady_clock::time_point until)
+{
+    using namespace std::chrono;
+    pollfd pfd[2] = {{_fd, events, 0}, {_wake_fd, POLLIN, 0}};
+    const timespec ts = to_timespec(duration_cast<microseconds>(until - steady_clock::now()));
+    const int ret = ppoll(pfd, 2, &ts, nullptr);
+    if (ret < 0)
+        return errno == EINTR ? 0 : -1;
+
+    if (pfd[1].revents & POLLIN)
+    {
+        // New request or close_port(), io_loop() looks at the queue after this transaction anyway
+        uint64_t value;
+        (void)!::read(_wake_fd, &value, sizeof(value));
+    }
+    if (_stop)
+    {
+        errno = ECANCELED;
+        return -1;
+    }
+    return (pfd[0].revents & (events | POLLERR | POLLHUP)) ? 1 : 0;
+}
+
+bool Rtu_Master::write_all(const QByteArray &data, std::chrono::steady_clock::time_point deadline)
+{
+    const char* pos = data.constData();
+    size_t left = static_cast<size_t>(data.size());
+    while (left > 0)
+    {
+        const ssize_t n = ::write(_fd, pos, left);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN)
+                return false;
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                errno = ETIMEDOUT;
+                return false;
+            }
+            if (poll_port(POLLOUT, deadline) < 0)
+                return false;
+            continue;
+        }
+        pos += n;
+        left -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool Rtu_Master::drain(std::chrono::steady_clock::time_point deadline)
+{
+    using namespace std::chrono;
+    int queued = 0;
+    while (ioctl(_fd, TIOCOUTQ, &queued) == 0 && queued > 0)
+    {
+        const auto now = steady_clock::now();
+        if (_stop || now >= deadline)
+        {
+            errno = _stop ? ECANCELED : ETIMEDOUT;
+            return false;
+        }
+        // About the time to send what is queued, t1.5 is 1.5 characters
+        wait_until(std::min(deadline, now + microseconds(queued * _t15_us * 2 / 3 + 1)));
+    }
+    tcdrain(_fd); // Rest of the UART FIFO
+    return true;
+}
+
+void Rtu_Master::wait_until(std::chrono::steady_clock::time_point time) const
+{
+    // Signals (--stats uses SIGUSR1) interrupt ppoll, the silence must last anyway
+    for (auto now = std::chrono::steady_clock::now(); now < time; now = std::chrono::steady_clock::now())
+    {
+        const timespec ts = to_timespec(std::chrono::duration_cast<std::chrono::microseconds>(time - now));
+        ppoll(nullptr, 0, &ts, nullptr);
+    }
+}
+
+void Rtu_Master::finish(const Result &result)
+{
+    if (!_replies.contains(result._id))
+        return;
+    const auto item = _replies.take(result._id);
+    const QPointer<QModbusReply> reply = item.first;
+    const Request& request = item.second;
+    if (!reply)
+        return;
+
+    if (result._error != QModbusDevice::NoError)
+    {
+        reply->setError(result._error, result._error_string);
+        return;
+    }
+
+    if (result._pdu.isEmpty()) // Broadcast
+    {
+        reply->setFinished(true);
+        return;
+    }
+
+    finish_reply(reply, request, result._pdu);
+}
+
+void Rtu_Master::set_state(QModbusDevice::State state)
+{
+    if (_state == state)
+        return;
+    _state = state;
+    emit state_changed(state);
+}
+
+void Rtu_Master::set_error(QModbusDevice::Error error, const QString &text)
+{
+    _error = error;
+    _error_string = text;
+    emit error_occurred(error);
+}
+
+} // namespace Modbus_Cli
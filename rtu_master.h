@@ -0,0 +1,96 @@
+#ifndef MODBUS_CLI_RTU_MASTER_H
+#define MODBUS_CLI_RTU_MASTER_H
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <QHash>
+#include <QPointer>
+#include <QModbusReply>
+
+#include "device.h"
+
+namespace Modbus_Cli {
+
+/*
+ * Modbus RTU master on termios with its own I/O thread. Selected by rtu://...?driver=native
+ * Silent intervals are computed from the character format, end of a response is found
+ * by its length when the function code allows it and by t3.5 silence otherwise.
+ */
+class Rtu_Master : public Device
+{
+    Q_OBJECT
+public:
+    Rtu_Master(const Das::Modbus::Config& config, QObject* parent = nullptr);
+    ~Rtu_Master();
+
+    bool connect_device() override;
+    void disconnect_device() override;
+
+    QModbusDevice::State state() const override;
+    QModbusDevice::Error error() const override;
+    QString error_string() const override;
+
+    QModbusReply* send(const Request& request, int timeout_ms) override;
+
+    /// t1.5 and t3.5 in microseconds for the character format of config
+    static void frame_timing(const Das::Modbus::Rtu_Config& config, int& t15_us, int& t35_us);
+private:
+    struct Transaction
+    {
+        quint64 _id;
+        QByteArray _adu;
+        bool _broadcast;
+        int _timeout_ms;
+    };
+
+    struct Result
+    {
+        quint64 _id;
+        QModbusDevice::Error _error;
+        QString _error_string;
+        QByteArray _pdu;
+    };
+
+    bool open_port();
+    void close_port();
+
+    void io_loop();
+    Result transact(const Transaction& transaction);
+    /// Waits for events of the port or a wake up. 1 - port ready, 0 - not yet, -1 - poll failed or port is closing
+    int poll_port(short events, std::chrono::steady_clock::time_point until);
+    bool write_all(const QByteArray& data, std::chrono::steady_clock::time_point deadline);
+    /// tcdrain() with a deadline, it waits forever on a line stalled by flow control
+    bool drain(std::chrono::steady_clock::time_point deadline);
+    void wait_until(std::chrono::steady_clock::time_point time) const;
+
+    void finish(const Result& result);
+    void set_state(QModbusDevice::State state);
+    void set_error(QModbusDevice::Error error, const QString& text);
+
+    Das::Modbus::Config _config;
+    int _t15_us;
+    int _t35_us;
+
+    int _fd;
+    int _wake_fd;
+    std::thread _thread;
+    std::atomic<bool> _stop;
+    std::mutex _mutex;
+    std::deque<Transaction> _queue;
+    std::chrono::steady_clock::time_point _last_activity;   ///< I/O thread only
+
+    QModbusDevice::State _state;
+    QModbusDevice::Error _error;
+    QString _error_string;
+
+    quint64 _next_id;
+    QHash<quint64, QPair<QPointer<QModbusReply>, Request>> _replies;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_RTU_MASTER_H
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <tuple>
+
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+
+#include "protocol.h"
+#include "scan_list.h"
+
+namespace Modbus_Cli {
+
+namespace {
+
+bool parse_register(const QString& text, QModbusDataUnit::RegisterType& type, int& address)
+{
+    const int sep = text.indexOf(':');
+    if (sep == -1)
+        return false;
+
+    bool ok;
+    type = register_type_from_string(text.left(sep));
+    address = text.mid(sep + 1).toInt(&ok);
+    return ok && type > QModbusDataUnit::Invalid && type <= QModbusDataUnit::HoldingRegisters && address >= 0 && address <= 0xFFFF;
+}
+
+auto trigger_tie(const Scan_Trigger& t) -> decltype(std::tie(t._type, t._address, t._condition, t._value,
+                                                               t._base_type, t._base_address, t._stride, t._offset))
+{
+    return std::tie(t._type, t._address, t._condition, t._value, t._base_type, t._base_address, t._stride, t._offset);
+}
+
+} // namespace
+
+bool Scan_Trigger::is_set() const
+{
+    return _type != QModbusDataUnit::Invalid;
+}
+
+bool Scan_Trigger::has_base() const
+{
+    return _base_type != QModbusDataUnit::Invalid;
+}
+
+bool Scan_Trigger::holds(int value, int previous) const
+{
+    switch (_condition)
+    {
+    case ANSWERED:      return true;
+    case CHANGED:       return value != previous;
+    case EQUAL:         return value == _value;
+    case NOT_EQUAL:     return value != _value;
+    case LESS:          return value < _value;
+    case GREATER:       return value > _value;
+    case LESS_EQUAL:    return value <= _value;
+    case GREATER_EQUAL: return value >= _value;
+    case BITS_SET:      return (value & _value) != 0;
+    }
+    return false;
+}
+
+bool Scan_Trigger::operator==(const Scan_Trigger &other) const
+{
+    return trigger_tie(*this) == trigger_tie(other);
+}
+
+bool Scan_Trigger::operator!=(const Scan_Trigger &other) const
+{
+    return !(*this == other);
+}
+
+bool Scan_Trigger::operator<(const Scan_Trigger &other) const
+{
+    return trigger_tie(*this) < trigger_tie(other);
+}
+
+bool Scan_List::load(const QString &file_name)
+{
+    QFile file(file_name);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        qCritical().noquote() << "Can't open scan list" << file_name << file.errorString();
+        return false;
+    }
+
+    _ranges.clear();
+
+    QTextStream stream(&file);
+    for (int line_number = 1; !stream.atEnd(); ++line_number)
+        if (!parse_line(stream.readLine(), line_number))
+            return false;
+
+    if (_ranges.isEmpty())
+    {
+        qCritical().noquote() << "Scan list" << file_name << "is empty";
+        return false;
+    }
+    return check_triggers();
+}
+
+const QVector<Scan_Range> &Scan_List::ranges() const
+{
+    return _ranges;
+}
+
+bool Scan_List::parse_line(const QString &line, int line_number)
+{
+    const QString text = line.left(line.indexOf('#')).simplified();
+    if (text.isEmpty())
+        return true;
+
+    const QStringList fields = text.split(' ');
+    int positional = fields.size();
+    for (const char* keyword: {"when", "at"})
+        if (fields.contains(keyword))
+            positional = std::min(positional, static_cast<int>(fields.indexOf(keyword)));
+    bool ok = positional >= 3 && positional <= 6;
+
+    Scan_Range range;
+    if (ok)
+        range._server_address = fields.at(0).toInt(&ok);
+    if (ok)
+    {
+        range._type = register_type_from_string(fields.at(1));
+        ok = range._type > QModbusDataUnit::Invalid && range._type <= QModbusDataUnit::HoldingRegisters;
+    }
+    range._period = default_period;
+    if (ok && positional >= 4)
+    {
+        range._period = fields.at(3).toInt(&ok);
+        ok = ok && range._period >= 0;
+    }
+    range._priority = 0;
+    if (ok && positional >= 5)
+        range._priority = fields.at(4).toInt(&ok);
+    range._deadband = -1;
+    if (ok && positional == 6)
+    {
+        range._deadband = fields.at(5).toInt(&ok);
+        ok = ok && range._deadband >= 0;
+    }
+    if (ok)
+        ok = parse_trigger(fields, positional, range._trigger);
+
+    if (ok)
+    {
+        for (const QString& item: fields.at(2).split(','))
+        {
+            if (item.isEmpty())
+                continue;
+            const int sep = item.indexOf('-');
+            const int first = item.left(sep).toInt(&ok);
+            const int last = ok && sep != -1 ? item.mid(sep + 1).toInt(&ok) : first;
+            if (!ok || first < 0 || last < first || last > 0xFFFF)
+            {
+                ok = false;
+                break;
+            }
+
+            range._start = first;
+            range._count = last - first + 1;
+            _ranges.push_back(range);
+        }
+    }
+
+    if (!ok)
+        qCritical().noquote() << QString("Scan list line %1: bad entry \"%2\"").arg(line_number).arg(text);
+    return ok;
+}
+
+bool Scan_List::parse_trigger(const QStringList &fields, int first, Scan_Trigger &trigger) const
+{
+    static const QStringList conditions = { "", "changed", "==", "!=", "<", ">", "<=", ">=", "&" };
+
+    trigger = Scan_Trigger{QModbusDataUnit::Invalid, 0, Scan_Trigger::ANSWERED, 0, QModbusDataUnit::Invalid, 0, 1, 0};
+    for (int i = first; i < fields.size(); )
+    {
+        if (fields.at(i) == "when" && !trigger.is_set() && i + 2 < fields.size())
+        {
+            const int condition = conditions.indexOf(fields.at(i + 2));
+            if (!parse_register(fields.at(i + 1), trigger._type, trigger._address) || condition < Scan_Trigger::CHANGED)
+                return false;
+
+            trigger._condition = static_cast<Scan_Trigger::Condition>(condition);
+            i += 3;
+            if (trigger._condition != Scan_Trigger::CHANGED)
+            {
+                bool ok = i < fields.size();
+                if (ok)
+                    trigger._value = fields.at(i++).toInt(&ok, 0);
+                if (!ok)
+                    return false;
+            }
+        }
+        else if (fields.at(i) == "at" && !trigger.has_base() && i + 1 < fields.size())
+        {
+            // <type>:<address>[*stride][+offset]
+            QString expression = fields.at(i + 1);
+            bool ok = true;
+            const int plus = expression.indexOf('+');
+            if (plus != -1)
+            {
+                trigger._offset = expression.mid(plus + 1).toInt(&ok, 0);
+                expression = expression.left(plus);
+            }
+            const int star = expression.indexOf('*');
+            if (ok && star != -1)
+            {
+                trigger._stride = expression.mid(star + 1).toInt(&ok, 0);
+                expression = expression.left(star);
+            }
+            if (!ok || !parse_register(expression, trigger._base_type, trigger._base_address))
+                return false;
+            i += 2;
+        }
+        else
+            return false;
+    }
+
+    // A relative range alone is read every time its base register is
+    if (trigger.has_base() && !trigger.is_set())
+    {
+        trigger._type = trigger._base_type;
+        trigger._address = trigger._base_address;
+    }
+    return true;
+}
+
+bool Scan_List::check_triggers() const
+{
+    for (const Scan_Range& range: _ranges)
+    {
+        const Scan_Trigger& trigger = range._trigger;
+        if (!trigger.is_set())
+            continue;
+
+        if (!is_polled(range._server_address, trigger._type, trigger._address)
+            || (trigger.has_base() && !is_polled(range._server_address, trigger._base_type, trigger._base_address)))
+        {
+            qCritical().noquote() << QString("Scan list: %1 %2 %3 depends on a register no periodic range of device %1 reads")
+                                     .arg(range._server_address).arg(register_type_to_string(range._type)).arg(range._start);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Scan_List::is_polled(int server_address, QModbusDataUnit::RegisterType type, int address) const
+{
+    for (const Scan_Range& range: _ranges)
+        if (!range._trigger.is_set() && range._server_address == server_address && range._type == type
+            && address >= range._start && address < range._start + range._count)
+            return true;
+    return false;
+}
+
+QVector<Scan_Block> Scan_List::plan(int gap_tolerance) const
+{
+    QVector<Scan_Range> sorted = _ranges;
+    std::sort(sorted.begin(), sorted.end(), [](const Scan_Range& a, const Scan_Range& b)
+    {
+        if (a._server_address != b._server_address) return a._server_address < b._server_address;
+        if (a._type != b._type) return a._type < b._type;
+        if (a._period != b._period) return a._period < b._period;
+        if (a._priority != b._priority) return a._priority < b._priority;
+        if (a._trigger != b._trigger) return a._trigger < b._trigger;
+        return a._start < b._start;
+    });
+
+    QVector<Scan_Block> blocks;
+    Scan_Block* block = nullptr;
+    for (const Scan_Range& range: sorted)
+    {
+        const int max_count = max_read_count(range._type);
+        const int range_end = range._start + range._count;
+        int start = range._start;
+
+        if (block
+            && block->_server_address == range._server_address
+            && block->_type == range._type
+            && block->_period == range._period
+            && block->_priority == range._priority
+            && block->_ranges.front()._trigger == range._trigger
+            && range._start - (block->_start + block->_count) <= gap_tolerance)
+        {
+            const int block_end = block->_start + block->_count;
+            const int end = std::max(block_end, range_end);
+            if (end - block->_start <= max_count)
+            {
+                block->_count = end - block->_start;
+                block->_ranges.push_back(range);
+                continue;
+            }
+
+            if (start < block_end)
+            {
+                // Head of the range is already covered by the current block
+                Scan_Range head = range;
+                head._count = block_end - start;
+                block->_ranges.push_back(head);
+                start = block_end;
+            }
+        }
+
+        // Rest of the range doesn't fit into current block. Oversized ranges take several blocks.
+        for (; start < range_end; start += max_count)
+        {
+            Scan_Range part = range;
+            part._start = start;
+            part._count = std::min(max_count, range_end - start);
+
+            blocks.push_back(Scan_Block{part._server_address, part._type, part._start, part._count, part._period, part._priority, {part}});
+        }
+        block = &blocks.last();
+    }
+
+    return blocks;
+}
+
+} // namespace Modbus_Cli
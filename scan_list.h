@@ -0,0 +1,99 @@
+#ifndef MODBUS_CLI_SCAN_LIST_H
+#define MODBUS_CLI_SCAN_LIST_H
+
+#include <QModbusDataUnit>
+#include <QVector>
+
+namespace Modbus_Cli {
+
+/*
+ * Makes a range lazy: it isn't polled by period but read right after the block holding the trigger register
+ * is answered, if the condition holds. With a base register its start is relative: base value * stride + offset is added.
+ * Trigger and base are registers of the same device read by a periodic range.
+ */
+struct Scan_Trigger
+{
+    enum Condition { ANSWERED, CHANGED, EQUAL, NOT_EQUAL, LESS, GREATER, LESS_EQUAL, GREATER_EQUAL, BITS_SET };
+
+    QModbusDataUnit::RegisterType _type;    ///< Invalid if the range is polled by period
+    int _address;
+    Condition _condition;
+    int _value;
+
+    QModbusDataUnit::RegisterType _base_type;   ///< Invalid if the range start is absolute
+    int _base_address;
+    int _stride;
+    int _offset;
+
+    bool is_set() const;
+    bool has_base() const;
+    /// Condition holds for the trigger value, previous is the one the range was last read at, -1 is never
+    bool holds(int value, int previous) const;
+
+    bool operator==(const Scan_Trigger& other) const;
+    bool operator!=(const Scan_Trigger& other) const;
+    bool operator<(const Scan_Trigger& other) const;
+};
+
+struct Scan_Range
+{
+    int _server_address;
+    QModbusDataUnit::RegisterType _type;
+    int _start;
+    int _count;
+    int _period;    ///< Poll period in milliseconds
+    int _priority;  ///< Higher is read first when requests wait for the line
+    int _deadband;  ///< Change of value reported with --on_change, -1 is --deadband
+    Scan_Trigger _trigger;
+};
+
+/// One read request produced by the planner. Covers one or more ranges of the same device, type and trigger.
+struct Scan_Block
+{
+    int _server_address;
+    QModbusDataUnit::RegisterType _type;
+    int _start;
+    int _count;
+    int _period;
+    int _priority;
+
+    QVector<Scan_Range> _ranges;
+};
+
+/*
+ * Register map file. One entry per line, '#' starts a comment:
+ *   <address> <type> <ranges> [period_ms] [priority] [deadband] [when <register> <condition> [value]] [at <register>[*stride][+offset]]
+ * Ranges are comma separated: "0-9,12,20-29". A register is "<type>:<address>" of the same device.
+ * Conditions: changed, ==, !=, <, >, <=, >=, & (any of the bits set). Values may be hex: 0x10.
+ * Example:
+ *   1 holding_register 0-9,12,20-29 1000
+ *   2 coils 100-163 500 1
+ *   3 input_register 0-15 1000 0 10
+ *   3 holding_register 100-149 when input_register:0 changed
+ *   3 holding_register 0-7 at input_register:1*8+1000
+ */
+class Scan_List
+{
+public:
+    static const int default_period = 1000;
+
+    bool load(const QString& file_name);
+
+    const QVector<Scan_Range>& ranges() const;
+
+    /// Merges ranges of the same device, type, period and priority into as few requests as possible.
+    /// A hole of up to gap_tolerance unused values is read to save a round trip.
+    QVector<Scan_Block> plan(int gap_tolerance) const;
+private:
+    bool parse_line(const QString& line, int line_number);
+    bool parse_trigger(const QStringList& fields, int first, Scan_Trigger& trigger) const;
+    /// Trigger and base registers are read by periodic ranges
+    bool check_triggers() const;
+    bool is_polled(int server_address, QModbusDataUnit::RegisterType type, int address) const;
+
+    QVector<Scan_Range> _ranges;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_SCAN_LIST_H
@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <limits>
+
+#include <QDebug>
+
+#include "protocol.h"
+#include "stats.h"
+#include "client.h"
+#include "scan_poller.h"
+
+namespace Modbus_Cli {
+
+namespace {
+
+quint64 register_key(int server_address, QModbusDataUnit::RegisterType type, int address)
+{
+    return (static_cast<quint64>(server_address) << 32) | (static_cast<quint64>(type) << 16) | static_cast<quint64>(address);
+}
+
+bool covers(const Scan_Block& block, QModbusDataUnit::RegisterType type, int address)
+{
+    return block._type == type && address >= block._start && address < block._start + block._count;
+}
+
+} // namespace
+
+Scan_Poller::Scan_Poller(Client *client, const QVector<Scan_Block> &blocks, int repeat, QObject *parent) :
+    QObject(parent),
+    _client(client),
+    _repeat(repeat)
+{
+    for (const Scan_Block& block: blocks)
+        _blocks.push_back(Block_State{block, 0, 0, false, block._ranges.front()._trigger, 0, -1, {}, {}});
+
+    // A triggered block hangs on the first periodic block reading its trigger register, see Scan_List::check_triggers()
+    for (int id = 0; id < _blocks.size(); ++id)
+    {
+        const Scan_Trigger& trigger = _blocks.at(id)._trigger;
+        if (!trigger.is_set())
+            continue;
+
+        bool linked = false;
+        for (Block_State& state: _blocks)
+        {
+            if (state._trigger.is_set() || state._block._server_address != _blocks.at(id)._block._server_address)
+                continue;
+            if (!linked && covers(state._block, trigger._type, trigger._address))
+            {
+                linked = true;
+                state._dependents.push_back(id);
+                if (!state._watched.contains(trigger._address))
+                    state._watched.push_back(trigger._address);
+            }
+            if (trigger.has_base() && covers(state._block, trigger._base_type, trigger._base_address)
+                && !state._watched.contains(trigger._base_address))
+                state._watched.push_back(trigger._base_address);
+        }
+    }
+
+    _client->set_print_values(false);
+    connect(_client, &Client::data_received, this, &Scan_Poller::data_received);
+    connect(_client, &Client::request_failed, this, &Scan_Poller::request_failed);
+    connect(_client, &Client::finished, this, &Scan_Poller::request_finished);
+
+    connect(&_timer, &QTimer::timeout, this, &Scan_Poller::poll);
+    _timer.setSingleShot(true);
+    _timer.setTimerType(Qt::PreciseTimer);
+    _clock.start();
+}
+
+void Scan_Poller::start()
+{
+    poll();
+}
+
+void Scan_Poller::poll()
+{
+    const qint64 now = now_us();
+    Stats& stats = Stats::local();
+
+    // Everything due goes to the client at once, it orders requests by priority and deadline
+    const auto clock_now = Request::Clock::now();
+    for (int i = 0; i < _blocks.size(); ++i)
+    {
+        Block_State& state = _blocks[i];
+        if (state._active || state._trigger.is_set() || is_complete(state) || state._next_due > now)
+            continue;
+
+        const Scan_Block& block = state._block;
+        const qint64 period_us = block._period * qint64(1000);
+        if (period_us > 0)
+        {
+            const qint64 missed = (now - state._next_due) / period_us;
+            if (missed > 0)
+            {
+                stats.add_missed(missed);
+                _client->metrics().add_missed(missed);
+                state._next_due += missed * period_us;
+            }
+        }
+        stats.add_cycle(now - state._next_due);
+
+        state._next_due += period_us;
+        send_block(i, 0, clock_now + std::chrono::microseconds(state._next_due - now)); // Next cycle is due then
+    }
+
+    // Blocks in flight are polled again when they finish
+    qint64 next_due = std::numeric_limits<qint64>::max();
+    for (const Block_State& state: _blocks)
+        if (!state._active && !state._trigger.is_set() && !is_complete(state))
+            next_due = std::min(next_due, state._next_due);
+
+    if (next_due != std::numeric_limits<qint64>::max())
+        _timer.start(static_cast<int>((std::max<qint64>(next_due - now_us(), 0) + 999) / 1000));
+    else if (_client->pending_count() == 0)
+    {
+        _timer.stop();
+        emit done();
+    }
+}
+
+void Scan_Poller::data_received(const Request &request, const QModbusDataUnit &unit)
+{
+    if (request._id < 0 || request._id >= _blocks.size())
+        return;
+
+    block_finished(request._id);
+
+    const Scan_Block& block = _blocks.at(request._id)._block;
+    const int shift = _blocks.at(request._id)._shift;
+    const QVector<quint16> values = unit.values();
+    Output_Writer* writer = _client->writer();
+
+    QString prefix;
+    if (!writer)
+    {
+        prefix = QString("%1 %2").arg(block._server_address).arg(register_type_to_string(block._type));
+        if (!_client->tag().isEmpty())
+            prefix.prepend(_client->tag() + ' ');
+    }
+
+    auto emit_run = [&](int start, const quint16* data, int count)
+    {
+        if (_client->decoder())
+            _client->output_decoded(block._server_address, block._type, unit.startAddress(), values.constData(), values.size(),
+                                    start, count);
+        else if (writer)
+            writer->write(_client->conn_string(), block._server_address, block._type, start, data, count);
+        else
+            for (int i = 0; i < count; ++i)
+                qInfo().noquote() << prefix << (start + i) << "=" << data[i];
+    };
+
+    // Ranges of a relative block keep their filter slot wherever the block is read
+    const bool relative = _blocks.at(request._id)._trigger.has_base();
+    Change_Filter* change_filter = _client->change_filter();
+    for (int i = 0; i < block._ranges.size(); ++i)
+    {
+        const Scan_Range& range = block._ranges.at(i);
+        const int start = range._start + shift;
+        const int offset = start - unit.startAddress();
+        const int count = std::min(range._count, values.size() - offset);
+        if (offset < 0 || count <= 0)
+            continue;
+
+        if (change_filter)
+            change_filter->filter(block._server_address, block._type, start, values.constData() + offset, count,
+                                  range._deadband, emit_run, relative ? request._id << 16 | i : -1);
+        else
+            emit_run(start, values.constData() + offset, count);
+    }
+
+    trigger_dependents(request, unit);
+}
+
+void Scan_Poller::request_failed(const Request &request)
+{
+    if (request._id >= 0 && request._id < _blocks.size())
+        block_finished(request._id);
+}
+
+void Scan_Poller::request_finished()
+{
+    if (_client->is_connected())
+        poll();
+    else if (_client->pending_count() == 0 && !_client->connect_device())
+        emit done();
+}
+
+bool Scan_Poller::is_complete(const Block_State &state) const
+{
+    return _repeat != -1 && state._poll_count > _repeat;
+}
+
+void Scan_Poller::block_finished(int id)
+{
+    Block_State& state = _blocks[id];
+    state._active = false;
+    if (!state._trigger.is_set() && state._block._period > 0 && now_us() > state._next_due)
+    {
+        Stats::local().add_overrun();
+        _client->metrics().add_overrun();
+    }
+}
+
+void Scan_Poller::send_block(int id, int shift, Request::Clock::time_point deadline)
+{
+    Block_State& state = _blocks[id];
+    const Scan_Block& block = state._block;
+    state._active = true;
+    state._shift = shift;
+    ++state._poll_count;
+
+    Request request = Request::read(block._server_address, block._type, block._start + shift, block._count);
+    request._id = id;
+    if (state._trigger.has_base())
+        request._slot = id;
+    request._priority = block._priority;
+    request._deadline = deadline;
+    _client->send(request);
+}
+
+void Scan_Poller::trigger_dependents(const Request &request, const QModbusDataUnit &unit)
+{
+    const Block_State& state = _blocks.at(request._id);
+    const Scan_Block& block = state._block;
+    for (int address: state._watched)
+    {
+        const int offset = address - unit.startAddress();
+        if (offset >= 0 && offset < static_cast<int>(unit.valueCount()))
+            _values.insert(register_key(block._server_address, block._type, address), unit.value(offset));
+    }
+
+    for (int id: state._dependents)
+    {
+        Block_State& dependent = _blocks[id];
+        const Scan_Block& dependent_block = dependent._block;
+        const Scan_Trigger& trigger = dependent._trigger;
+
+        // Still in flight from an earlier trigger: the trigger value isn't taken, so a change is caught next cycle
+        const int value = _values.value(register_key(block._server_address, trigger._type, trigger._address), -1);
+        if (dependent._active || value == -1 || !trigger.holds(value, dependent._trigger_value))
+            continue;
+
+        int shift = 0;
+        if (trigger.has_base())
+        {
+            const int base = _values.value(register_key(block._server_address, trigger._base_type, trigger._base_address), -1);
+            if (base == -1)
+                continue;
+
+            shift = base * trigger._stride + trigger._offset;
+            const int start = dependent_block._start + shift;
+            if (start < 0 || start + dependent_block._count > 0x10000)
+            {
+                qCritical().noquote() << QString("Scan list: device %1 %2 start %3 is out of range")
+                                         .arg(dependent_block._server_address)
+                                         .arg(register_type_to_string(dependent_block._type)).arg(start);
+                continue;
+            }
+        }
+
+        dependent._trigger_value = value;
+        send_block(id, shift, request._deadline);
+    }
+}
+
+qint64 Scan_Poller::now_us() const
+{
+    return _clock.nsecsElapsed() / 1000;
+}
+
+} // namespace Modbus_Cli
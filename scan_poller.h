@@ -0,0 +1,72 @@
+#ifndef MODBUS_CLI_SCAN_POLLER_H
+#define MODBUS_CLI_SCAN_POLLER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QTimer>
+
+#include "request.h"
+#include "scan_list.h"
+
+namespace Modbus_Cli {
+
+class Client;
+
+/*
+ * Reads every block at its own fixed period. Cycles are due at multiples of the period
+ * from the start, so late cycles don't shift the following ones. A cycle due while the
+ * previous one of the block still runs starts when it ends; cycles it didn't start in time
+ * for are skipped and counted as missed, a read that ends after the next cycle is due is an overrun.
+ * Blocks due at the same time go to the client at once, it sends higher priority first.
+ * Blocks with a trigger (see Scan_Trigger) have no period: they are sent when the periodic block holding
+ * the trigger register is answered and the condition holds, with its deadline, and cost nothing otherwise.
+ */
+class Scan_Poller : public QObject
+{
+    Q_OBJECT
+public:
+    /// Every block is read repeat + 1 times, -1 is infinity
+    Scan_Poller(Client* client, const QVector<Scan_Block>& blocks, int repeat, QObject* parent = nullptr);
+
+    void start();
+signals:
+    void done();
+private slots:
+    void poll();
+    void data_received(const Request& request, const QModbusDataUnit& unit);
+    void request_failed(const Request& request);
+    void request_finished();
+private:
+    struct Block_State
+    {
+        Scan_Block _block;
+        qint64 _next_due;       ///< us since start
+        int _poll_count;
+        bool _active;
+
+        Scan_Trigger _trigger;      ///< Of every range of the block
+        int _shift;                 ///< Sent start minus planned start, non-zero for relative blocks
+        int _trigger_value;         ///< Trigger register value the block was last sent at, -1 is never
+        QVector<int> _dependents;   ///< Blocks triggered by this one
+        QVector<int> _watched;      ///< Registers of this block other blocks depend on
+    };
+
+    bool is_complete(const Block_State& state) const;
+    void block_finished(int id);
+    void send_block(int id, int shift, Request::Clock::time_point deadline);
+    /// Sends the blocks triggered by an answer of a periodic block
+    void trigger_dependents(const Request& request, const QModbusDataUnit& unit);
+    qint64 now_us() const;
+
+    Client* _client;
+    QVector<Block_State> _blocks;
+    int _repeat;
+    QHash<quint64, int> _values;    ///< Last read values of watched registers, see register_key()
+
+    QElapsedTimer _clock;
+    QTimer _timer;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_SCAN_POLLER_H
@@ -0,0 +1,119 @@
+#include "session.h"
+
+namespace Modbus_Cli {
+
+Client* make_client(const QString &conn_string, const Job &job)
+{
+    Client* client = new Client{conn_string, job._timeout, job._number_of_retries, job._quiet};
+    client->set_window(job._window);
+    client->set_connect_timeout(job._connect_timeout);
+    if (job._reconnect_ms > 0)
+        client->set_reconnect(job._reconnect_ms);
+    if (!job._standby.isEmpty())
+        client->set_standby(job._standby);
+    client->set_capture(job._capture);
+    if (job._min_timeout >= 0)
+        client->set_adaptive_timeout(job._min_timeout);
+    return client;
+}
+
+Session::Session(const QString &conn_string, const Job &job, QObject *parent) :
+    QObject(parent),
+    _job(job),
+    _next(0),
+    _finished(false),
+    _client(make_client(conn_string, job))
+{
+    for (int address: job._addresses)
+    {
+        Request request = job._request;
+        request._server_address = address;
+        _requests.push_back(request);
+    }
+    if (_requests.isEmpty())
+        _requests.push_back(job._request);
+
+    // Every address gets the request repeat + 1 times
+    _remaining = job._repeat == -1 ? -1 : (job._repeat + 1) * _requests.size();
+
+    _client->set_writer(job._writer);
+    _client->set_image(job._image);
+    _client->set_decoder(job._decoder);
+    if (job._tagged)
+        _client->set_tag(conn_string);
+    if (job._on_change)
+        _client->set_change_filter(job._deadband, job._keyframe_ms);
+    connect(_client.get(), &Client::connected, this, &Session::on_connected);
+
+    if (!job._blocks.isEmpty())
+    {
+        _poller.reset(new Scan_Poller{_client.get(), job._blocks, job._repeat});
+        connect(_poller.get(), &Scan_Poller::done, this, &Session::finish);
+    }
+    else if (job._discover)
+    {
+        _prober.reset(new Bus_Prober{_client.get(), job._addresses, job._request});
+        connect(_prober.get(), &Bus_Prober::done, this, &Session::finish);
+    }
+    else
+        connect(_client.get(), &Client::finished, this, &Session::on_request_finished);
+}
+
+void Session::start()
+{
+    if (!_client->connect_device())
+        finish();
+}
+
+void Session::on_connected()
+{
+    if (_poller)
+        _poller->start();
+    else if (_prober)
+        _prober->start();
+    else
+        fill_window();
+}
+
+void Session::on_request_finished()
+{
+    if (!_client->is_connected())
+    {
+        if (_client->pending_count() > 0)
+            return;
+
+        if (_remaining > 0)
+            --_remaining;
+        if (_remaining == 0 || !_client->connect_device())
+            finish();
+    }
+    else if (_remaining == 0)
+    {
+        if (_client->pending_count() == 0)
+            finish();
+    }
+    else
+        fill_window();
+}
+
+void Session::fill_window()
+{
+    while (_remaining != 0 && _client->can_send())
+    {
+        if (_remaining > 0)
+            --_remaining;
+        _client->send(_requests.at(_next));
+        _next = (_next + 1) % _requests.size();
+    }
+}
+
+void Session::finish()
+{
+    if (!_finished)
+    {
+        _finished = true;
+        emit done();
+    }
+}
+
+} // namespace Modbus_Cli
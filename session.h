@@ -0,0 +1,72 @@
+#ifndef MODBUS_CLI_SESSION_H
+#define MODBUS_CLI_SESSION_H
+
+#include <memory>
+
+#include "bus_prober.h"
+#include "client.h"
+#include "scan_poller.h"
+
+namespace Modbus_Cli {
+
+/// What to do with every connected device
+struct Job
+{
+    Request _request;
+    QVector<int> _addresses;        ///< _request is sent to each of them in turn
+    QVector<Scan_Block> _blocks;    ///< Scan list mode if not empty
+
+    int _repeat;
+    int _window;
+    int _timeout;
+    int _number_of_retries;
+    int _min_timeout;               ///< Adaptive timeout from it to _timeout, -1 is fixed _timeout
+    bool _quiet;
+    bool _tagged;                   ///< Prefix output with connection string
+    bool _on_change;                ///< Output only changed values
+    int _deadband;
+    int _keyframe_ms;               ///< Full output period with _on_change, 0 is never
+    Output_Writer* _writer;         ///< Log values if null
+    Register_Image* _image;         ///< Read blocks are published to it if set
+    const Value_Decoder* _decoder;  ///< Typed values output if set
+    Traffic_Capture* _capture;      ///< Traffic is logged to it if set
+    bool _discover;                 ///< _request probes every address once, responders are reported
+    int _connect_timeout;
+    int _reconnect_ms;              ///< Maximum reconnect delay, 0 ends the job on connection errors
+    QString _standby;               ///< Standby connection string, see Client::set_standby()
+};
+
+/// Client of one connection with the connection settings of the job: timeouts, window, reconnect, standby, capture
+Client* make_client(const QString& conn_string, const Job& job);
+
+/// Runs a job against one device and finishes
+class Session : public QObject
+{
+    Q_OBJECT
+public:
+    Session(const QString& conn_string, const Job& job, QObject* parent = nullptr);
+
+    void start();
+signals:
+    void done();
+private slots:
+    void on_connected();
+    void on_request_finished();
+private:
+    void fill_window();
+    void finish();
+
+    Job _job;
+    QVector<Request> _requests;
+    int _next;
+    int _remaining;
+    bool _finished;
+
+    std::unique_ptr<Client> _client;
+    std::unique_ptr<Scan_Poller> _poller;
+    std::unique_ptr<Bus_Prober> _prober;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_SESSION_H
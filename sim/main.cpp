@@ -0,0 +1,102 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QHostAddress>
+#include <QDebug>
+
+#include "rtu_slave.h"
+#include "tcp_slave.h"
+
+using namespace Modbus_Sim;
+
+QSet<int> parse_units(const QString& text)
+{
+    QSet<int> units;
+    for (const QString& item: text.split(','))
+    {
+        if (item.isEmpty())
+            continue;
+        const int sep = item.indexOf('-');
+        const int first = item.left(sep).toInt();
+        const int last = sep == -1 ? first : item.mid(sep + 1).toInt();
+        for (int unit = first; unit <= last; ++unit)
+            units.insert(unit);
+    }
+    return units;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Modbus slave simulator");
+    parser.addHelpOption();
+    parser.addOptions({
+        { "port", QCoreApplication::translate("main", "Modbus TCP port. 0 disables TCP. Default: 1502"), "port", "1502"},
+        { "rtu", QCoreApplication::translate("main", "Start RTU slave on a pseudo-terminal, its name is printed")},
+        { "frame_gap", QCoreApplication::translate("main", "RTU silence in milliseconds that ends a frame. Default: 5"), "ms", "5"},
+        { "delay", QCoreApplication::translate("main", "Response delay in milliseconds. Default: 0"), "ms", "0"},
+        { "jitter", QCoreApplication::translate("main", "Random addition to response delay in milliseconds. Default: 0"), "ms", "0"},
+        { "error_rate", QCoreApplication::translate("main", "Part of requests answered by exception, 0..1. Default: 0"), "rate", "0"},
+        { "error_code", QCoreApplication::translate("main", "Exception code for injected errors. Default: 4"), "code", "4"},
+        { "drop_rate", QCoreApplication::translate("main", "Part of requests left without answer, 0..1. Default: 0"), "rate", "0"},
+        { "units", QCoreApplication::translate("main", "Answered unit ids. Example: 1,2,10-20. Default: any"), "units"},
+        { "fill", QCoreApplication::translate("main", "Initial register values: zero or address. Default: address"), "fill", "address"},
+        { "set", QCoreApplication::translate("main", "Register values type:start=v1,v2. Example: 4:100=1,2,0x10"), "values"},
+        { "replay", QCoreApplication::translate("main", "Answer requests as in a capture of modbus_cli --capture, with its timing"), "file"},
+        { "speed", QCoreApplication::translate("main", "Replay speed factor, response delays are divided by it. Default: 1"), "factor", "1"}
+    });
+    parser.process(a);
+
+    Sim_Config config;
+    config._delay_ms = parser.value("delay").toInt();
+    config._jitter_ms = parser.value("jitter").toInt();
+    config._error_rate = parser.value("error_rate").toDouble();
+    config._error_code = parser.value("error_code").toInt(nullptr, 0);
+    config._drop_rate = parser.value("drop_rate").toDouble();
+    config._units = parse_units(parser.value("units"));
+
+    Simulator simulator{config};
+    if (parser.value("fill") == "address")
+        simulator.fill_with_addresses();
+    for (const QString& spec: parser.values("set"))
+    {
+        if (!simulator.set_values(spec))
+        {
+            qCritical().noquote() << "Bad register values:" << spec;
+            return 1;
+        }
+    }
+
+    if (parser.isSet("replay"))
+    {
+        const double speed = parser.value("speed").toDouble();
+        if (speed <= 0.)
+        {
+            qCritical().noquote() << "Bad replay speed:" << parser.value("speed");
+            return 1;
+        }
+        if (!simulator.load_replay(parser.value("replay"), speed))
+            return 1;
+    }
+
+    Tcp_Slave tcp_slave{&simulator};
+    const quint16 port = static_cast<quint16>(parser.value("port").toUInt());
+    if (port)
+    {
+        if (!tcp_slave.listen(QHostAddress::Any, port))
+            return 1;
+        qInfo() << "Modbus TCP slave on port" << tcp_slave.port();
+    }
+
+    Rtu_Slave rtu_slave{&simulator};
+    if (parser.isSet("rtu"))
+    {
+        if (!rtu_slave.open())
+            return 1;
+        rtu_slave.set_frame_gap(parser.value("frame_gap").toInt());
+        qInfo().noquote() << "Modbus RTU slave on" << rtu_slave.slave_name();
+    }
+
+    return a.exec();
+}
@@ -0,0 +1,24 @@
+QT -= gui
+QT += serialbus network
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = modbus_sim
+
+INCLUDEPATH += ..
+
+SOURCES += \
+        ../crc16.cpp \
+        ../traffic_capture.cpp \
+        main.cpp \
+        rtu_slave.cpp \
+        simulator.cpp \
+        tcp_slave.cpp
+
+HEADERS += \
+    ../crc16.h \
+    ../traffic_capture.h \
+    rtu_slave.h \
+    simulator.h \
+    tcp_slave.h
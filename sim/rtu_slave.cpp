@@ -0,0 +1,155 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <QDebug>
+
+#include <QModbusPdu>
+
+#include "crc16.h"
+#include "rtu_slave.h"
+
+namespace Modbus_Sim {
+
+Rtu_Slave::Rtu_Slave(Simulator *simulator, QObject *parent) :
+    QObject(parent),
+    _simulator(simulator),
+    _fd(-1),
+    _notifier(nullptr)
+{
+    _gap_timer.setSingleShot(true);
+    _gap_timer.setInterval(5);
+    connect(&_gap_timer, &QTimer::timeout, this, &Rtu_Slave::frame_gap_elapsed);
+}
+
+Rtu_Slave::~Rtu_Slave()
+{
+    if (_fd != -1)
+        ::close(_fd);
+}
+
+bool Rtu_Slave::open()
+{
+    _fd = ::posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (_fd == -1 || ::grantpt(_fd) || ::unlockpt(_fd))
+    {
+        qCritical() << "Can't open pseudo-terminal";
+        return false;
+    }
+
+    termios tio;
+    if (::tcgetattr(_fd, &tio) == 0)
+    {
+        ::cfmakeraw(&tio);
+        ::tcsetattr(_fd, TCSANOW, &tio);
+    }
+
+    _slave_name = QString::fromLocal8Bit(::ptsname(_fd));
+    _notifier = new QSocketNotifier(_fd, QSocketNotifier::Read, this);
+    connect(_notifier, &QSocketNotifier::activated, this, &Rtu_Slave::read_pty);
+    return true;
+}
+
+QString Rtu_Slave::slave_name() const
+{
+    return _slave_name;
+}
+
+void Rtu_Slave::set_frame_gap(int ms)
+{
+    _gap_timer.setInterval(ms);
+}
+
+void Rtu_Slave::read_pty()
+{
+    char data[512];
+    ssize_t size;
+    while ((size = ::read(_fd, data, sizeof(data))) > 0)
+        _buffer.append(data, static_cast<int>(size));
+
+    // Frames of known length are taken at once, others after the silence gap
+    int expected;
+    while ((expected = expected_size()) > 0 && _buffer.size() >= expected)
+    {
+        process_frame(_buffer.left(expected));
+        _buffer.remove(0, expected);
+    }
+
+    if (!_buffer.isEmpty())
+        _gap_timer.start();
+}
+
+void Rtu_Slave::frame_gap_elapsed()
+{
+    if (_buffer.size() >= 4)
+        process_frame(_buffer);
+    _buffer.clear();
+}
+
+int Rtu_Slave::expected_size() const
+{
+    if (_buffer.size() < 2)
+        return 0;
+
+    switch (static_cast<quint8>(_buffer.at(1)))
+    {
+    case QModbusPdu::ReadCoils:
+    case QModbusPdu::ReadDiscreteInputs:
+    case QModbusPdu::ReadHoldingRegisters:
+    case QModbusPdu::ReadInputRegisters:
+    case QModbusPdu::WriteSingleCoil:
+    case QModbusPdu::WriteSingleRegister:
+        return 8;
+    case QModbusPdu::WriteMultipleCoils:
+    case QModbusPdu::WriteMultipleRegisters:
+        return _buffer.size() > 6 ? 9 + static_cast<quint8>(_buffer.at(6)) : 0;
+    case QModbusPdu::ReadWriteMultipleRegisters:
+        return _buffer.size() > 10 ? 13 + static_cast<quint8>(_buffer.at(10)) : 0;
+    default:
+        break;
+    }
+    return 0;
+}
+
+void Rtu_Slave::process_frame(const QByteArray &frame)
+{
+    const quint8* data = reinterpret_cast<const quint8*>(frame.constData());
+    const int size = frame.size();
+    const quint16 crc = static_cast<quint16>(data[size - 2] | (data[size - 1] << 8));
+    if (Modbus_Cli::crc16(data, size - 2) != crc)
+    {
+        qWarning() << "Bad CRC in frame" << frame.toHex();
+        return;
+    }
+
+    const int unit = data[0];
+    const QByteArray pdu = frame.mid(1, size - 3);
+
+    if (unit == 0) // Broadcast is never answered
+    {
+        _simulator->execute(pdu);
+        return;
+    }
+
+    QByteArray response_pdu;
+    int delay_ms = 0;
+    if (!_simulator->process(unit, pdu, response_pdu, delay_ms))
+        return;
+
+    QByteArray response;
+    response.append(static_cast<char>(unit));
+    response.append(response_pdu);
+    const quint16 response_crc = Modbus_Cli::crc16(reinterpret_cast<const quint8*>(response.constData()), response.size());
+    response.append(static_cast<char>(response_crc & 0xFF));
+    response.append(static_cast<char>(response_crc >> 8));
+
+    const int fd = _fd;
+    auto write_response = [fd, response]() { (void)!::write(fd, response.constData(), static_cast<size_t>(response.size())); };
+    if (delay_ms > 0)
+        QTimer::singleShot(delay_ms, this, write_response);
+    else
+        write_response();
+}
+
+} // namespace Modbus_Sim
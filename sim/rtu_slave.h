@@ -0,0 +1,42 @@
+#ifndef MODBUS_SIM_RTU_SLAVE_H
+#define MODBUS_SIM_RTU_SLAVE_H
+
+#include <QSocketNotifier>
+#include <QTimer>
+
+#include "simulator.h"
+
+namespace Modbus_Sim {
+
+/// Modbus RTU slave on the master side of a pseudo-terminal pair. Clients open slave_name().
+class Rtu_Slave : public QObject
+{
+    Q_OBJECT
+public:
+    Rtu_Slave(Simulator* simulator, QObject* parent = nullptr);
+    ~Rtu_Slave();
+
+    bool open();
+    QString slave_name() const;
+
+    /// Silence that ends a frame of unknown length
+    void set_frame_gap(int ms);
+private slots:
+    void read_pty();
+    void frame_gap_elapsed();
+private:
+    int expected_size() const;
+    void process_frame(const QByteArray& frame);
+
+    Simulator* _simulator;
+    int _fd;
+    QString _slave_name;
+    QSocketNotifier* _notifier;
+
+    QByteArray _buffer;
+    QTimer _gap_timer;
+};
+
+} // namespace Modbus_Sim
+
+#endif // MODBUS_SIM_RTU_SLAVE_H
@@ -0,0 +1,362 @@
+#include <QStringList>
+#include <QModbusPdu>
+#include <QDebug>
+
+#include "traffic_capture.h"
+#include "simulator.h"
+
+namespace Modbus_Sim {
+
+namespace {
+
+enum Exception_Code {
+    ILLEGAL_FUNCTION = 1,
+    ILLEGAL_DATA_ADDRESS = 2,
+    ILLEGAL_DATA_VALUE = 3
+};
+
+const int table_size = 0x10000;
+
+bool in_range(int start, int count)
+{
+    return start + count <= table_size;
+}
+
+} // namespace
+
+quint16 get_u16(const quint8 *data)
+{
+    return static_cast<quint16>((data[0] << 8) | data[1]);
+}
+
+void put_u16(QByteArray &data, quint16 value)
+{
+    data.append(static_cast<char>(value >> 8));
+    data.append(static_cast<char>(value & 0xFF));
+}
+
+Simulator::Simulator(const Sim_Config &config) :
+    _config(config),
+    _random(std::random_device{}()),
+    _chance(0., 1.)
+{
+    for (QVector<quint16>& table: _tables)
+        table.fill(0, table_size);
+}
+
+const Sim_Config &Simulator::config() const
+{
+    return _config;
+}
+
+void Simulator::fill_with_addresses()
+{
+    for (int i = 0; i < table_size; ++i)
+    {
+        table(QModbusDataUnit::DiscreteInputs)[i] = i & 1;
+        table(QModbusDataUnit::Coils)[i] = i & 1;
+        table(QModbusDataUnit::InputRegisters)[i] = static_cast<quint16>(i);
+        table(QModbusDataUnit::HoldingRegisters)[i] = static_cast<quint16>(i);
+    }
+}
+
+bool Simulator::set_values(const QString &spec)
+{
+    const int type_end = spec.indexOf(':');
+    const int start_end = spec.indexOf('=');
+    if (type_end == -1 || start_end < type_end)
+        return false;
+
+    bool ok;
+    const int type = spec.left(type_end).toInt(&ok);
+    if (!ok || type <= QModbusDataUnit::Invalid || type > QModbusDataUnit::HoldingRegisters)
+        return false;
+
+    int address = spec.mid(type_end + 1, start_end - type_end - 1).toInt(&ok);
+    if (!ok || address < 0)
+        return false;
+
+    for (const QString& text: spec.mid(start_end + 1).split(','))
+    {
+        const quint16 value = text.toUShort(&ok, 0);
+        if (!ok || address >= table_size)
+            return false;
+        set_value(static_cast<QModbusDataUnit::RegisterType>(type), address++, value);
+    }
+    return true;
+}
+
+void Simulator::set_value(QModbusDataUnit::RegisterType type, int address, quint16 value)
+{
+    table(type)[address] = value;
+}
+
+quint16 Simulator::value(QModbusDataUnit::RegisterType type, int address) const
+{
+    return table(type).at(address);
+}
+
+bool Simulator::load_replay(const QString &file_name, double speed)
+{
+    using Modbus_Cli::Traffic_Capture;
+
+    struct Sent
+    {
+        quint64 _time_ns;
+        QByteArray _key;
+    };
+    QHash<quint64, Sent> sent;  // By endpoint and transaction
+    int count = 0;
+
+    const bool ok = Traffic_Capture::read(file_name, [&](const Traffic_Capture::Record_Header& header, const char* payload)
+    {
+        const quint64 id = (static_cast<quint64>(header._endpoint) << 32) | header._transaction;
+        if (header._kind == Traffic_Capture::REQUEST)
+        {
+            QByteArray key(1, static_cast<char>(header._unit));
+            key.append(payload, static_cast<int>(header._size));
+            sent.insert(id, Sent{header._time_ns, key});
+            return;
+        }
+
+        const auto it = sent.find(id);
+        if (it == sent.end())
+            return;
+        if (header._kind == Traffic_Capture::RESPONSE)
+        {
+            const int delay_ms = static_cast<int>((header._time_ns - it->_time_ns) / 1e6 / speed);
+            _script[it->_key].enqueue(Scripted{QByteArray(payload, static_cast<int>(header._size)), delay_ms});
+            ++count;
+        }
+        else if (header._kind == Traffic_Capture::TIMEOUT)
+        {
+            _script[it->_key].enqueue(Scripted{QByteArray(), 0});
+            ++count;
+        }
+        // Connection errors aren't the device behavior, the request is answered from the tables
+        sent.erase(it);
+    });
+
+    if (ok)
+        qInfo() << "Replaying" << count << "answers of" << _script.size() << "distinct requests";
+    return ok;
+}
+
+bool Simulator::process(int unit, const QByteArray &request, QByteArray &response, int &delay_ms)
+{
+    if (!_script.isEmpty())
+    {
+        const auto it = _script.find(QByteArray(1, static_cast<char>(unit)) + request);
+        if (it != _script.end())
+        {
+            const Scripted scripted = it->dequeue();
+            if (it->isEmpty())
+                _script.erase(it);
+            if (scripted._response.isEmpty())
+                return false;
+            response = scripted._response;
+            delay_ms = scripted._delay_ms;
+            return true;
+        }
+    }
+
+    if (request.isEmpty() || (!_config._units.isEmpty() && unit != 0 && !_config._units.contains(unit)))
+        return false;
+
+    if (_config._drop_rate > 0. && _chance(_random) < _config._drop_rate)
+        return false;
+
+    if (_config._error_rate > 0. && _chance(_random) < _config._error_rate)
+        response = exception(static_cast<quint8>(request.at(0)), static_cast<quint8>(_config._error_code));
+    else
+        response = execute(request);
+
+    delay_ms = _config._delay_ms;
+    if (_config._jitter_ms > 0)
+        delay_ms += static_cast<int>(_chance(_random) * _config._jitter_ms);
+    return true;
+}
+
+QByteArray Simulator::execute(const QByteArray &request)
+{
+    const quint8 function_code = static_cast<quint8>(request.at(0));
+    const quint8* data = reinterpret_cast<const quint8*>(request.constData()) + 1;
+    const int size = request.size() - 1;
+
+    switch (function_code)
+    {
+    case QModbusPdu::ReadCoils:
+    case QModbusPdu::ReadDiscreteInputs:
+        return read_bits(function_code, data, size);
+    case QModbusPdu::ReadHoldingRegisters:
+    case QModbusPdu::ReadInputRegisters:
+        return read_registers(function_code, data, size);
+    case QModbusPdu::WriteSingleCoil:
+    case QModbusPdu::WriteSingleRegister:
+        return write_single(function_code, data, size);
+    case QModbusPdu::WriteMultipleCoils:
+        return write_bits(function_code, data, size);
+    case QModbusPdu::WriteMultipleRegisters:
+        return write_registers(function_code, data, size);
+    case QModbusPdu::ReadWriteMultipleRegisters:
+        return read_write_registers(function_code, data, size);
+    default:
+        break;
+    }
+    return exception(function_code, ILLEGAL_FUNCTION);
+}
+
+/*static*/ QByteArray Simulator::exception(quint8 function_code, quint8 code)
+{
+    QByteArray response;
+    response.append(static_cast<char>(function_code | 0x80));
+    response.append(static_cast<char>(code));
+    return response;
+}
+
+QByteArray Simulator::read_bits(quint8 function_code, const quint8 *data, int size)
+{
+    if (size != 4)
+        return exception(function_code, ILLEGAL_DATA_VALUE);
+
+    const int start = get_u16(data), count = get_u16(data + 2);
+    if (count < 1 || count > 2000)
+        return exception(function_code, ILLEGAL_DATA_VALUE);
+    if (!in_range(start, count))
+        return exception(function_code, ILLEGAL_DATA_ADDRESS);
+
+    const auto& values = table(function_code == QModbusPdu::ReadCoils ? QModbusDataUnit::Coils : QModbusDataUnit::DiscreteInputs);
+    const int byte_count = (count + 7) / 8;
+
+    QByteArray response(2 + byte_count, '\0');
+    response[0] = static_cast<char>(function_code);
+    response[1] = static_cast<char>(byte_count);
+    for (int i = 0; i < count; ++i)
+        if (values.at(start + i))
+            response[2 + i / 8] = static_cast<char>(response.at(2 + i / 8) | (1 << (i % 8)));
+    return response;
+}
+
+QByteArray Simulator::read_registers(quint8 function_code, const quint8 *data, int size)
+{
+    if (size != 4)
+        return exception(function_code, ILLEGAL_DATA_VALUE);
+
+    const int start = get_u16(data), count = get_u16(data + 2);
+    if (count < 1 || count > 125)
+        return exception(function_code, ILLEGAL_DATA_VALUE);
+    if (!in_range(start, count))
+        return exception(function_code, ILLEGAL_DATA_ADDRESS);
+
+    const auto& values = table(function_code == QModbusPdu::ReadHoldingRegisters ? QModbusDataUnit::HoldingRegisters : QModbusDataUnit::InputRegisters);
+
+    QByteArray response;
+    response.reserve(2 + count * 2);
+    response.append(static_cast<char>(function_code));
+    response.append(static_cast<char>(count * 2));
+    for (int i = 0; i < count; ++i)
+        put_u16(response, values.at(start + i));
+    return response;
+}
+
+QByteArray Simulator::write_single(quint8 function_code, const quint8 *data, int size)
+{
+    if (size != 4)
+        return exception(function_code, ILLEGAL_DATA_VALUE);
+
+    const int address = get_u16(data);
+    const quint16 value = get_u16(data + 2);
+    if (function_code == QModbusPdu::WriteSingleCoil)
+    {
+        if (value != 0xFF00 && value != 0x0000)
+            return exception(function_code, ILLEGAL_DATA_VALUE);
+        table(QModbusDataUnit::Coils)[address] = value ? 1 : 0;
+    }
+    else
+        table(QModbusDataUnit::HoldingRegisters)[address] = value;
+
+    QByteArray response;
+    response.append(static_cast<char>(function_code));
+    response.append(reinterpret_cast<const char*>(data), 4);
+    return response;
+}
+
+QByteArray Simulator::write_bits(quint8 function_code, const quint8 *data, int size)
+{
+    if (size < 5)
+        return exception(function_code, ILLEGAL_DATA_VALUE);
+
+    const int start = get_u16(data), count = get_u16(data + 2), byte_count = data[4];
+    if (count < 1 || count > 1968 || byte_count != (count + 7) / 8 || size != 5 + byte_count)
+        return exception(function_code, ILLEGAL_DATA_VALUE);
+    if (!in_range(start, count))
+        return exception(function_code, ILLEGAL_DATA_ADDRESS);
+
+    auto& values = table(QModbusDataUnit::Coils);
+    for (int i = 0; i < count; ++i)
+        values[start + i] = (data[5 + i / 8] >> (i % 8)) & 1;
+
+    QByteArray response;
+    response.append(static_cast<char>(function_code));
+    response.append(reinterpret_cast<const char*>(data), 4);
+    return response;
+}
+
+QByteArray Simulator::write_registers(quint8 function_code, const quint8 *data, int size)
+{
+    if (size < 5)
+        return exception(function_code, ILLEGAL_DATA_VALUE);
+
+    const int start = get_u16(data), count = get_u16(data + 2), byte_count = data[4];
+    if (count < 1 || count > 123 || byte_count != count * 2 || size != 5 + byte_count)
+        return exception(function_code, ILLEGAL_DATA_VALUE);
+    if (!in_range(start, count))
+        return exception(function_code, ILLEGAL_DATA_ADDRESS);
+
+    auto& values = table(QModbusDataUnit::HoldingRegisters);
+    for (int i = 0; i < count; ++i)
+        values[start + i] = get_u16(data + 5 + i * 2);
+
+    QByteArray response;
+    response.append(static_cast<char>(function_code));
+    response.append(reinterpret_cast<const char*>(data), 4);
+    return response;
+}
+
+QByteArray Simulator::read_write_registers(quint8 function_code, const quint8 *data, int size)
+{
+    if (size < 9)
+        return exception(function_code, ILLEGAL_DATA_VALUE);
+
+    const int read_start = get_u16(data), read_count = get_u16(data + 2);
+    const int write_start = get_u16(data + 4), write_count = get_u16(data + 6), byte_count = data[8];
+    if (read_count < 1 || read_count > 125 || write_count < 1 || write_count > 121
+        || byte_count != write_count * 2 || size != 9 + byte_count)
+        return exception(function_code, ILLEGAL_DATA_VALUE);
+    if (!in_range(read_start, read_count) || !in_range(write_start, write_count))
+        return exception(function_code, ILLEGAL_DATA_ADDRESS);
+
+    auto& values = table(QModbusDataUnit::HoldingRegisters);
+    for (int i = 0; i < write_count; ++i)
+        values[write_start + i] = get_u16(data + 9 + i * 2);
+
+    QByteArray response;
+    response.reserve(2 + read_count * 2);
+    response.append(static_cast<char>(function_code));
+    response.append(static_cast<char>(read_count * 2));
+    for (int i = 0; i < read_count; ++i)
+        put_u16(response, values.at(read_start + i));
+    return response;
+}
+
+QVector<quint16> &Simulator::table(QModbusDataUnit::RegisterType type)
+{
+    return _tables[type - 1];
+}
+
+const QVector<quint16> &Simulator::table(QModbusDataUnit::RegisterType type) const
+{
+    return _tables[type - 1];
+}
+
+} // namespace Modbus_Sim
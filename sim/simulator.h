@@ -0,0 +1,83 @@
+#ifndef MODBUS_SIM_SIMULATOR_H
+#define MODBUS_SIM_SIMULATOR_H
+
+#include <random>
+
+#include <QByteArray>
+#include <QHash>
+#include <QModbusDataUnit>
+#include <QQueue>
+#include <QSet>
+#include <QVector>
+
+namespace Modbus_Sim {
+
+struct Sim_Config
+{
+    int _delay_ms = 0;          ///< Response delay
+    int _jitter_ms = 0;         ///< Random addition to delay, 0..jitter
+    double _error_rate = 0.;    ///< Part of requests answered by exception
+    double _drop_rate = 0.;     ///< Part of requests left without answer
+    int _error_code = 4;        ///< Exception code for injected errors. Default: server device failure
+    QSet<int> _units;           ///< Answered unit ids. Empty is any
+};
+
+/// Register tables of a slave device and request processing
+class Simulator
+{
+public:
+    explicit Simulator(const Sim_Config& config = Sim_Config());
+
+    const Sim_Config& config() const;
+
+    /// Every register value equals its address, odd addresses are set for coils and discrete inputs
+    void fill_with_addresses();
+
+    /// "type:start=v1,v2,..." Example: "4:100=1,2,3"
+    bool set_values(const QString& spec);
+
+    /// Requests found in a capture of modbus_cli --capture get the captured answer after the captured
+    /// response time divided by speed, or none if they timed out. Every capture answer is used once, in order.
+    bool load_replay(const QString& file_name, double speed);
+
+    void set_value(QModbusDataUnit::RegisterType type, int address, quint16 value);
+    quint16 value(QModbusDataUnit::RegisterType type, int address) const;
+
+    /// Builds response PDU for request PDU. Returns false when request must stay unanswered.
+    bool process(int unit, const QByteArray& request, QByteArray& response, int& delay_ms);
+
+    /// Executes request PDU without error injection
+    QByteArray execute(const QByteArray& request);
+
+    static QByteArray exception(quint8 function_code, quint8 code);
+private:
+    struct Scripted
+    {
+        QByteArray _response;       ///< Empty if left without answer
+        int _delay_ms;
+    };
+
+    QByteArray read_bits(quint8 function_code, const quint8* data, int size);
+    QByteArray read_registers(quint8 function_code, const quint8* data, int size);
+    QByteArray write_single(quint8 function_code, const quint8* data, int size);
+    QByteArray write_bits(quint8 function_code, const quint8* data, int size);
+    QByteArray write_registers(quint8 function_code, const quint8* data, int size);
+    QByteArray read_write_registers(quint8 function_code, const quint8* data, int size);
+
+    QVector<quint16>& table(QModbusDataUnit::RegisterType type);
+    const QVector<quint16>& table(QModbusDataUnit::RegisterType type) const;
+
+    Sim_Config _config;
+    QVector<quint16> _tables[4];
+    QHash<QByteArray, QQueue<Scripted>> _script;   ///< By unit id and request PDU
+
+    std::mt19937 _random;
+    std::uniform_real_distribution<double> _chance;
+};
+
+quint16 get_u16(const quint8* data);
+void put_u16(QByteArray& data, quint16 value);
+
+} // namespace Modbus_Sim
+
+#endif // MODBUS_SIM_SIMULATOR_H
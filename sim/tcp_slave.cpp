@@ -0,0 +1,97 @@
+#include <QTcpSocket>
+#include <QTimer>
+#include <QDebug>
+
+#include "tcp_slave.h"
+
+namespace Modbus_Sim {
+
+namespace {
+const int mbap_size = 7;
+const int max_frame_size = mbap_size + 253;
+} // namespace
+
+Tcp_Slave::Tcp_Slave(Simulator *simulator, QObject *parent) :
+    QObject(parent),
+    _simulator(simulator)
+{
+    connect(&_server, &QTcpServer::newConnection, this, &Tcp_Slave::new_connection);
+}
+
+bool Tcp_Slave::listen(const QHostAddress &address, quint16 port)
+{
+    if (_server.listen(address, port))
+        return true;
+
+    qCritical().noquote() << "Can't listen on port" << port << _server.errorString();
+    return false;
+}
+
+quint16 Tcp_Slave::port() const
+{
+    return _server.serverPort();
+}
+
+void Tcp_Slave::new_connection()
+{
+    while (QTcpSocket* socket = _server.nextPendingConnection())
+    {
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connect(socket, &QTcpSocket::readyRead, this, &Tcp_Slave::read_socket);
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]()
+        {
+            _buffers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void Tcp_Slave::read_socket()
+{
+    QTcpSocket* socket = qobject_cast<QTcpSocket*>(sender());
+    QByteArray& buffer = _buffers[socket];
+    buffer += socket->readAll();
+
+    int pos = 0;
+    while (buffer.size() - pos >= mbap_size)
+    {
+        const quint8* header = reinterpret_cast<const quint8*>(buffer.constData()) + pos;
+        const int length = get_u16(header + 4);
+        if (length < 2 || mbap_size - 1 + length > max_frame_size)
+        {
+            socket->abort();
+            return;
+        }
+
+        const int frame_size = mbap_size - 1 + length;
+        if (buffer.size() - pos < frame_size)
+            break;
+
+        process_frame(socket, buffer.mid(pos, frame_size));
+        pos += frame_size;
+    }
+
+    buffer.remove(0, pos);
+}
+
+void Tcp_Slave::process_frame(QTcpSocket *socket, const QByteArray &frame)
+{
+    const quint8 unit = static_cast<quint8>(frame.at(6));
+
+    QByteArray pdu;
+    int delay_ms = 0;
+    if (!_simulator->process(unit, frame.mid(mbap_size), pdu, delay_ms))
+        return;
+
+    QByteArray response = frame.left(4); // Transaction and protocol id
+    put_u16(response, static_cast<quint16>(pdu.size() + 1));
+    response.append(static_cast<char>(unit));
+    response.append(pdu);
+
+    if (delay_ms > 0)
+        QTimer::singleShot(delay_ms, socket, [socket, response]() { socket->write(response); });
+    else
+        socket->write(response);
+}
+
+} // namespace Modbus_Sim
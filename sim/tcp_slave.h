@@ -0,0 +1,33 @@
+#ifndef MODBUS_SIM_TCP_SLAVE_H
+#define MODBUS_SIM_TCP_SLAVE_H
+
+#include <QTcpServer>
+#include <QHash>
+
+#include "simulator.h"
+
+namespace Modbus_Sim {
+
+/// Modbus TCP slave. Requests of one connection are answered independently, so pipelining clients see the delay once.
+class Tcp_Slave : public QObject
+{
+    Q_OBJECT
+public:
+    Tcp_Slave(Simulator* simulator, QObject* parent = nullptr);
+
+    bool listen(const QHostAddress& address, quint16 port);
+    quint16 port() const;
+private slots:
+    void new_connection();
+    void read_socket();
+private:
+    void process_frame(QTcpSocket* socket, const QByteArray& frame);
+
+    Simulator* _simulator;
+    QTcpServer _server;
+    QHash<QTcpSocket*, QByteArray> _buffers;
+};
+
+} // namespace Modbus_Sim
+
+#endif // MODBUS_SIM_TCP_SLAVE_H
@@ -0,0 +1,189 @@
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+#include <QDebug>
+
+#include "stats.h"
+
+namespace Modbus_Cli {
+
+namespace {
+
+struct Registry
+{
+    Registry() { _clock.start(); }
+
+    std::mutex _mutex;
+    std::vector<Stats*> _live;
+    Stats _retired;     ///< Counters of finished threads
+    QElapsedTimer _clock;
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+} // namespace
+
+/*static*/ Stats &Stats::local()
+{
+    thread_local Stats stats{true};
+    return stats;
+}
+
+/*static*/ void Stats::summary(Stats &total)
+{
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg._mutex);
+    reg._retired.add_to(total);
+    for (const Stats* stats: reg._live)
+        stats->add_to(total);
+}
+
+/*static*/ double Stats::uptime_seconds()
+{
+    return registry()._clock.nsecsElapsed() / 1e9;
+}
+
+/*static*/ void Stats::print_summary()
+{
+    Stats total;
+    summary(total);
+
+    const double seconds = uptime_seconds();
+    const Histogram& latency = total.latency();
+    auto ms = [&latency](double percentile) { return QString::number(latency.value_at_percentile(percentile) / 1000., 'f', 3); };
+
+    qInfo().noquote() << "Requests:" << total.requests() << "Responses:" << total.responses()
+                      << "Errors:" << total.errors() << "Timeouts:" << total.timeouts() << "Retries:" << total.retries()
+                      << "Rate:" << QString::number(seconds > 0 ? total.responses() / seconds : 0., 'f', 1) << "req/s";
+    qInfo().noquote() << "Latency ms: p50" << ms(50) << "p90" << ms(90) << "p99" << ms(99) << "p99.9" << ms(99.9)
+                      << "max" << QString::number(latency.max() / 1000., 'f', 3)
+                      << "mean" << QString::number(latency.mean() / 1000., 'f', 3);
+
+    QStringList exceptions;
+    for (int code = 0; code < exception_count; ++code)
+        if (total.exceptions(code))
+            exceptions << QString("0x%1: %2").arg(code, 2, 16, QChar('0')).arg(total.exceptions(code));
+    if (!exceptions.isEmpty())
+        qInfo().noquote() << "Exceptions:" << exceptions.join(", ");
+
+    const Histogram& lateness = total.lateness();
+    if (lateness.count())
+        qInfo().noquote() << "Scan cycles:" << lateness.count() << "Missed:" << total.missed() << "Overruns:" << total.overruns()
+                          << "Start lateness ms: p50" << QString::number(lateness.value_at_percentile(50) / 1000., 'f', 3)
+                          << "p99" << QString::number(lateness.value_at_percentile(99) / 1000., 'f', 3)
+                          << "max" << QString::number(lateness.max() / 1000., 'f', 3);
+}
+
+Stats::Stats() : Stats{false} {}
+
+Stats::Stats(bool registered) :
+    _registered(registered),
+    _requests{0}, _responses{0}, _retries{0}, _timeouts{0}, _errors{0}, _missed{0}, _overruns{0}
+{
+    for (std::atomic<quint64>& counter: _exceptions)
+        counter.store(0, std::memory_order_relaxed);
+
+    if (_registered)
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg._mutex);
+        reg._live.push_back(this);
+    }
+}
+
+Stats::~Stats()
+{
+    if (_registered)
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg._mutex);
+        add_to(reg._retired);
+        reg._live.erase(std::remove(reg._live.begin(), reg._live.end(), this), reg._live.end());
+    }
+}
+
+void Stats::add_request() { add(_requests); }
+void Stats::add_retry() { add(_retries); }
+void Stats::add_timeout() { add(_timeouts); }
+void Stats::add_error() { add(_errors); }
+
+void Stats::add_exception(int code)
+{
+    add(_exceptions[code & 0xFF]);
+}
+
+void Stats::add_response(quint64 latency_us)
+{
+    add(_responses);
+    _latency.record(latency_us);
+}
+
+void Stats::add_cycle(quint64 lateness_us)
+{
+    _lateness.record(lateness_us);
+}
+
+void Stats::add_missed(quint64 count) { add(_missed, count); }
+void Stats::add_overrun() { add(_overruns); }
+
+void Stats::add_to(Stats &other) const
+{
+    add(other._requests, requests());
+    add(other._responses, responses());
+    add(other._retries, retries());
+    add(other._timeouts, timeouts());
+    add(other._errors, errors());
+    for (int code = 0; code < exception_count; ++code)
+        if (exceptions(code))
+            add(other._exceptions[code], exceptions(code));
+    add(other._missed, missed());
+    add(other._overruns, overruns());
+    _latency.add_to(other._latency);
+    _lateness.add_to(other._lateness);
+}
+
+void Stats::reset()
+{
+    for (std::atomic<quint64>* counter: {&_requests, &_responses, &_retries, &_timeouts, &_errors, &_missed, &_overruns})
+        counter->store(0, std::memory_order_relaxed);
+    for (std::atomic<quint64>& counter: _exceptions)
+        counter.store(0, std::memory_order_relaxed);
+    _latency.reset();
+    _lateness.reset();
+}
+
+quint64 Stats::requests() const { return _requests.load(std::memory_order_relaxed); }
+quint64 Stats::responses() const { return _responses.load(std::memory_order_relaxed); }
+quint64 Stats::retries() const { return _retries.load(std::memory_order_relaxed); }
+quint64 Stats::timeouts() const { return _timeouts.load(std::memory_order_relaxed); }
+quint64 Stats::errors() const { return _errors.load(std::memory_order_relaxed); }
+
+quint64 Stats::exceptions(int code) const
+{
+    return _exceptions[code & 0xFF].load(std::memory_order_relaxed);
+}
+
+const Histogram &Stats::latency() const
+{
+    return _latency;
+}
+
+quint64 Stats::missed() const { return _missed.load(std::memory_order_relaxed); }
+quint64 Stats::overruns() const { return _overruns.load(std::memory_order_relaxed); }
+
+const Histogram &Stats::lateness() const
+{
+    return _lateness;
+}
+
+/*static*/ void Stats::add(std::atomic<quint64> &counter, quint64 value)
+{
+    counter.fetch_add(value, std::memory_order_relaxed);
+}
+
+} // namespace Modbus_Cli
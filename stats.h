@@ -0,0 +1,80 @@
+#ifndef MODBUS_CLI_STATS_H
+#define MODBUS_CLI_STATS_H
+
+#include <atomic>
+
+#include <QElapsedTimer>
+
+#include "histogram.h"
+
+namespace Modbus_Cli {
+
+/*
+ * Request counters and latency histogram. Every thread records into its own
+ * instance without locks, summary() adds up all of them.
+ */
+class Stats
+{
+public:
+    static const int exception_count = 256;
+
+    static Stats& local();
+
+    /// Sum of all threads since program start
+    static void summary(Stats& total);
+    static double uptime_seconds();
+    static void print_summary();
+
+    Stats();
+    ~Stats();
+
+    void add_request();
+    void add_retry();
+    void add_timeout();
+    void add_error();
+    void add_exception(int code);
+    /// Reply received, microseconds since request was sent
+    void add_response(quint64 latency_us);
+    /// Scan cycle started, microseconds after it was due
+    void add_cycle(quint64 lateness_us);
+    /// Cycles skipped because the previous one was still running
+    void add_missed(quint64 count);
+    /// Cycle finished after the next one was due
+    void add_overrun();
+
+    void add_to(Stats& other) const;
+    void reset();
+
+    quint64 requests() const;
+    quint64 responses() const;
+    quint64 retries() const;
+    quint64 timeouts() const;
+    quint64 errors() const;
+    quint64 exceptions(int code) const;
+    const Histogram& latency() const;
+    quint64 missed() const;
+    quint64 overruns() const;
+    const Histogram& lateness() const;
+private:
+    explicit Stats(bool registered);
+
+    static void add(std::atomic<quint64>& counter, quint64 value = 1);
+
+    bool _registered;
+
+    std::atomic<quint64> _requests;
+    std::atomic<quint64> _responses;
+    std::atomic<quint64> _retries;
+    std::atomic<quint64> _timeouts;
+    std::atomic<quint64> _errors;
+    std::atomic<quint64> _exceptions[exception_count];
+    std::atomic<quint64> _missed;
+    std::atomic<quint64> _overruns;
+
+    Histogram _latency;
+    Histogram _lateness;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_STATS_H
@@ -0,0 +1,376 @@
+#include <QDebug>
+
+#include "tcp_gateway.h"
+
+namespace Modbus_Cli {
+
+namespace {
+
+quint16 get_u16(const QByteArray& data, int pos)
+{
+    return static_cast<quint16>(static_cast<quint8>(data.at(pos)) << 8 | static_cast<quint8>(data.at(pos + 1)));
+}
+
+void put_u16(QByteArray& data, quint16 value)
+{
+    data.append(static_cast<char>(value >> 8));
+    data.append(static_cast<char>(value & 0xFF));
+}
+
+} // namespace
+
+Tcp_Gateway::Tcp_Gateway(const QString &conn_string, const Job &job, qint64 max_age_ms, int max_queue, QObject *parent) :
+    QObject(parent),
+    _job(job),
+    _max_age_ms(max_age_ms),
+    _max_queue(max_queue),
+    _client(make_client(conn_string, job)),
+    _next_master(0),
+    _next_id(0)
+{
+    _client->set_print_values(false);
+
+    connect(_client.get(), &Client::connected, this, &Tcp_Gateway::on_connected);
+    connect(_client.get(), &Client::data_received, this, &Tcp_Gateway::data_received);
+    connect(_client.get(), &Client::request_failed, this, &Tcp_Gateway::request_failed);
+    connect(_client.get(), &Client::finished, this, &Tcp_Gateway::request_finished);
+    connect(&_server, &QTcpServer::newConnection, this, &Tcp_Gateway::new_connection);
+    _clock.start();
+}
+
+bool Tcp_Gateway::start(const QString &address)
+{
+    const int sep = address.lastIndexOf(':');
+    const QHostAddress host = sep == -1 ? QHostAddress{QHostAddress::Any} : QHostAddress{address.left(sep)};
+    bool ok;
+    const int port = address.mid(sep + 1).toInt(&ok);
+    if (!ok || port <= 0 || port > 0xFFFF || host.isNull())
+    {
+        qCritical().noquote() << "Bad gateway address:" << address;
+        return false;
+    }
+
+    if (!_server.listen(host, static_cast<quint16>(port)))
+    {
+        qCritical().noquote() << "Can't listen on" << address << _server.errorString();
+        return false;
+    }
+
+    _client->connect_device();
+    return true;
+}
+
+void Tcp_Gateway::new_connection()
+{
+    while (QTcpSocket* socket = _server.nextPendingConnection())
+    {
+        const quint64 id = _next_master++;
+        _masters.insert(id, Master{socket, QByteArray(), QQueue<int>()});
+
+        connect(socket, &QTcpSocket::readyRead, this, [this, id]() { read_socket(id); });
+        connect(socket, &QTcpSocket::disconnected, this, [this, id]() { remove_master(id); });
+    }
+}
+
+void Tcp_Gateway::on_connected()
+{
+    dispatch();
+}
+
+void Tcp_Gateway::read_socket(quint64 master_id)
+{
+    auto it = _masters.find(master_id);
+    if (it == _masters.end())
+        return;
+
+    Master& master = it.value();
+    master._buffer.append(master._socket->readAll());
+
+    // MBAP header: transaction, protocol 0, length of unit and PDU, unit
+    int pos = 0;
+    while (master._buffer.size() - pos >= mbap_size)
+    {
+        const quint16 transaction = get_u16(master._buffer, pos);
+        const int length = get_u16(master._buffer, pos + 4);
+        if (get_u16(master._buffer, pos + 2) != 0 || length < 2 || length > max_pdu_size + 1)
+        {
+            qCritical().noquote() << "Bad Modbus TCP frame from" << master._socket->peerAddress().toString();
+            master._socket->abort();
+            return;
+        }
+        if (master._buffer.size() - pos < mbap_size - 1 + length)
+            break;
+
+        handle_frame(master_id, master, transaction, static_cast<quint8>(master._buffer.at(pos + 6)),
+                     master._buffer.mid(pos + mbap_size, length - 1));
+        pos += mbap_size - 1 + length;
+    }
+    master._buffer.remove(0, pos);
+
+    dispatch();
+}
+
+void Tcp_Gateway::handle_frame(quint64 master_id, Master &master, quint16 transaction, quint8 unit, const QByteArray &pdu)
+{
+    const Waiter waiter{master_id, transaction};
+    const quint8 function = static_cast<quint8>(pdu.at(0));
+    if (function == 0 || (function & 0x80))
+    {
+        reply(waiter, unit, exception_pdu(pdu, QModbusPdu::IllegalFunction));
+        return;
+    }
+
+    const bool shared = _max_age_ms > 0 && unit != 0 && is_read(pdu);
+    const QByteArray key = shared ? static_cast<char>(unit) + pdu : QByteArray();
+    if (shared)
+    {
+        auto cached = _cache.find(key);
+        if (cached != _cache.end())
+        {
+            if (_clock.elapsed() - cached.value()._time_ms <= _max_age_ms)
+            {
+                reply(waiter, unit, cached.value()._pdu);
+                return;
+            }
+            _cache.erase(cached);
+        }
+
+        const int id = _shared.value(key, -1);
+        if (id != -1)
+        {
+            _transactions[id]._waiters.push_back(waiter);
+            return;
+        }
+    }
+
+    if (master._queue.size() >= _max_queue)
+    {
+        reply(waiter, unit, exception_pdu(pdu, QModbusPdu::ServerDeviceBusy));
+        return;
+    }
+
+    const int id = _next_id++;
+    _transactions.insert(id, Transaction{unit, pdu, {waiter}});
+    if (shared)
+        _shared.insert(key, id);
+
+    if (master._queue.isEmpty())
+        _ready.enqueue(master_id);
+    master._queue.enqueue(id);
+}
+
+void Tcp_Gateway::remove_master(quint64 master_id)
+{
+    auto it = _masters.find(master_id);
+    if (it == _masters.end())
+        return;
+
+    const Master master = it.value();
+    _masters.erase(it);
+    master._socket->deleteLater();
+
+    // Requests it shares with other masters become theirs, answers to it in flight are dropped
+    for (int id: master._queue)
+    {
+        Transaction& transaction = _transactions[id];
+        QVector<Waiter> waiters;
+        for (const Waiter& waiter: transaction._waiters)
+            if (waiter._master != master_id && _masters.contains(waiter._master))
+                waiters.push_back(waiter);
+        transaction._waiters = waiters;
+
+        if (waiters.isEmpty())
+        {
+            _shared.remove(static_cast<char>(transaction._unit) + transaction._pdu);
+            _transactions.remove(id);
+            continue;
+        }
+
+        Master& heir = _masters[waiters.first()._master];
+        if (heir._queue.isEmpty())
+            _ready.enqueue(waiters.first()._master);
+        heir._queue.enqueue(id);
+    }
+}
+
+void Tcp_Gateway::dispatch()
+{
+    if (!_client->is_connected())
+    {
+        if (!_ready.isEmpty() && !_client->connect_device())
+            fail_queue(QModbusPdu::GatewayPathUnavailable);
+        return;
+    }
+
+    // One request more than the window waits in the client, so the line doesn't wait for the gateway
+    while (!_ready.isEmpty() && _client->pending_count() <= _job._window)
+    {
+        const quint64 master_id = _ready.dequeue();
+        auto it = _masters.find(master_id);
+        if (it == _masters.end() || it.value()._queue.isEmpty())
+            continue;
+
+        Master& master = it.value();
+        const int id = master._queue.dequeue();
+        if (!master._queue.isEmpty())
+            _ready.enqueue(master_id);
+
+        const Transaction& transaction = _transactions[id];
+        if (!is_wanted(transaction))
+        {
+            finish(id, QByteArray());
+            continue;
+        }
+
+        Request request = Request::raw(transaction._unit, static_cast<QModbusPdu::FunctionCode>(static_cast<quint8>(transaction._pdu.at(0))),
+                                       transaction._pdu.mid(1));
+        request._id = id;
+        _client->send(request);
+    }
+}
+
+void Tcp_Gateway::data_received(const Request &request, const QModbusDataUnit &, const QModbusResponse &response)
+{
+    auto it = _transactions.find(request._id);
+    if (it == _transactions.end())
+        return;
+
+    const Transaction& transaction = it.value();
+    QByteArray pdu;
+    pdu.append(static_cast<char>(response.functionCode()));
+    pdu.append(response.data());
+
+    if (_max_age_ms > 0 && transaction._unit != 0)
+    {
+        if (is_read(transaction._pdu))
+            put_cache(static_cast<char>(transaction._unit) + transaction._pdu, pdu);
+        else
+            invalidate(transaction._unit);
+    }
+    finish(request._id, transaction._unit != 0 ? pdu : QByteArray());
+}
+
+void Tcp_Gateway::request_failed(const Request &request, QModbusDevice::Error error, int exception_code)
+{
+    auto it = _transactions.find(request._id);
+    if (it == _transactions.end())
+        return;
+
+    const Transaction& transaction = it.value();
+    if (_max_age_ms > 0 && !is_read(transaction._pdu))
+        invalidate(transaction._unit); // May be done anyway
+
+    int code = exception_code;
+    if (error != QModbusDevice::ProtocolError || code == 0)
+        code = error == QModbusDevice::ConnectionError || error == QModbusDevice::WriteError || error == QModbusDevice::ReplyAbortedError
+                ? QModbusPdu::GatewayPathUnavailable : QModbusPdu::GatewayTargetDeviceFailedToRespond;
+    finish(request._id, transaction._unit != 0 ? exception_pdu(transaction._pdu, code) : QByteArray());
+}
+
+void Tcp_Gateway::request_finished()
+{
+    if (!_client->is_connected() && _client->pending_count() == 0)
+        fail_queue(QModbusPdu::GatewayPathUnavailable); // Next request reconnects
+    else
+        dispatch();
+}
+
+void Tcp_Gateway::finish(int id, const QByteArray &pdu)
+{
+    const Transaction transaction = _transactions.take(id);
+    if (_shared.value(static_cast<char>(transaction._unit) + transaction._pdu, -1) == id)
+        _shared.remove(static_cast<char>(transaction._unit) + transaction._pdu);
+
+    if (!pdu.isEmpty())
+        for (const Waiter& waiter: transaction._waiters)
+            reply(waiter, transaction._unit, pdu);
+}
+
+void Tcp_Gateway::fail_queue(int exception_code)
+{
+    _ready.clear();
+    for (Master& master: _masters)
+    {
+        const QQueue<int> queue = master._queue;
+        master._queue.clear();
+        for (int id: queue)
+            finish(id, exception_pdu(_transactions.value(id)._pdu, exception_code));
+    }
+}
+
+void Tcp_Gateway::reply(const Waiter &waiter, quint8 unit, const QByteArray &pdu)
+{
+    auto it = _masters.find(waiter._master);
+    if (it == _masters.end())
+        return;
+
+    QByteArray frame;
+    frame.reserve(mbap_size + pdu.size());
+    put_u16(frame, waiter._transaction);
+    put_u16(frame, 0);
+    put_u16(frame, static_cast<quint16>(pdu.size() + 1));
+    frame.append(static_cast<char>(unit));
+    frame.append(pdu);
+    it.value()._socket->write(frame);
+}
+
+bool Tcp_Gateway::is_wanted(const Transaction &transaction) const
+{
+    for (const Waiter& waiter: transaction._waiters)
+        if (_masters.contains(waiter._master))
+            return true;
+    return false;
+}
+
+void Tcp_Gateway::put_cache(const QByteArray &key, const QByteArray &pdu)
+{
+    const qint64 now = _clock.elapsed();
+    if (_cache.size() >= max_cache_size)
+    {
+        for (auto it = _cache.begin(); it != _cache.end(); )
+        {
+            if (now - it.value()._time_ms > _max_age_ms)
+                it = _cache.erase(it);
+            else
+                ++it;
+        }
+        if (_cache.size() >= max_cache_size)
+            _cache.clear();
+    }
+    _cache.insert(key, Cached{pdu, now});
+}
+
+void Tcp_Gateway::invalidate(quint8 unit)
+{
+    for (auto it = _cache.begin(); it != _cache.end(); )
+    {
+        if (static_cast<quint8>(it.key().at(0)) == unit)
+            it = _cache.erase(it);
+        else
+            ++it;
+    }
+}
+
+/*static*/ bool Tcp_Gateway::is_read(const QByteArray &pdu)
+{
+    switch (static_cast<quint8>(pdu.at(0)))
+    {
+    case QModbusPdu::ReadCoils:
+    case QModbusPdu::ReadDiscreteInputs:
+    case QModbusPdu::ReadHoldingRegisters:
+    case QModbusPdu::ReadInputRegisters:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*static*/ QByteArray Tcp_Gateway::exception_pdu(const QByteArray &request_pdu, int exception_code)
+{
+    QByteArray pdu;
+    pdu.append(static_cast<char>(static_cast<quint8>(request_pdu.at(0)) | 0x80));
+    pdu.append(static_cast<char>(exception_code));
+    return pdu;
+}
+
+} // namespace Modbus_Cli
@@ -0,0 +1,105 @@
+#ifndef MODBUS_CLI_TCP_GATEWAY_H
+#define MODBUS_CLI_TCP_GATEWAY_H
+
+#include <memory>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMap>
+#include <QQueue>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include "session.h"
+
+namespace Modbus_Cli {
+
+/*
+ * Modbus TCP server forwarding requests of any number of masters to one connection, usually an RTU line.
+ * Every master has its own queue and the queues take turns, so a busy master can't starve the others.
+ * A master with max_queue requests waiting gets exception 0x06 (server busy) at once.
+ * With max_age > 0 identical reads (same unit and PDU) share one device request while it waits or runs,
+ * and are answered from the last answer not older than max_age. A write to a unit drops its cached answers.
+ * Failed requests are answered with exception 0x0A (no path) or 0x0B (device didn't respond), broadcasts aren't answered.
+ */
+class Tcp_Gateway : public QObject
+{
+    Q_OBJECT
+public:
+    Tcp_Gateway(const QString& conn_string, const Job& job, qint64 max_age_ms, int max_queue, QObject* parent = nullptr);
+
+    /// address is "[host:]port", every interface by default
+    bool start(const QString& address);
+private slots:
+    void new_connection();
+    void on_connected();
+    void data_received(const Request& request, const QModbusDataUnit& unit, const QModbusResponse& response);
+    void request_failed(const Request& request, QModbusDevice::Error error, int exception_code);
+    void request_finished();
+private:
+    static const int mbap_size = 7;
+    static const int max_pdu_size = 253;
+    static const int max_cache_size = 4096;
+
+    struct Master
+    {
+        QTcpSocket* _socket;
+        QByteArray _buffer;
+        QQueue<int> _queue;     ///< Transactions it asked for first, by id
+    };
+
+    struct Waiter
+    {
+        quint64 _master;
+        quint16 _transaction;   ///< MBAP transaction id
+    };
+
+    /// One device request and every master waiting for it
+    struct Transaction
+    {
+        quint8 _unit;
+        QByteArray _pdu;
+        QVector<Waiter> _waiters;
+    };
+
+    struct Cached
+    {
+        QByteArray _pdu;
+        qint64 _time_ms;
+    };
+
+    void read_socket(quint64 master_id);
+    void handle_frame(quint64 master_id, Master& master, quint16 transaction, quint8 unit, const QByteArray& pdu);
+    void remove_master(quint64 master_id);
+    void dispatch();
+    /// Answers every waiter and forgets the transaction
+    void finish(int id, const QByteArray& pdu);
+    void fail_queue(int exception_code);
+    void reply(const Waiter& waiter, quint8 unit, const QByteArray& pdu);
+    bool is_wanted(const Transaction& transaction) const;
+    void put_cache(const QByteArray& key, const QByteArray& pdu);
+    void invalidate(quint8 unit);
+
+    static bool is_read(const QByteArray& pdu);
+    static QByteArray exception_pdu(const QByteArray& request_pdu, int exception_code);
+
+    Job _job;
+    qint64 _max_age_ms;
+    int _max_queue;
+    std::unique_ptr<Client> _client;
+    QTcpServer _server;
+    QElapsedTimer _clock;
+
+    QMap<quint64, Master> _masters;
+    quint64 _next_master;
+    QQueue<quint64> _ready;     ///< Masters with waiting requests in turn order, one entry each
+
+    QHash<int, Transaction> _transactions;
+    QHash<QByteArray, int> _shared;     ///< Reads waiting or in flight, by unit and PDU
+    QHash<QByteArray, Cached> _cache;
+    int _next_id;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_TCP_GATEWAY_H
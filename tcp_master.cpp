@@ -0,0 +1,450 @@
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <QHostInfo>
+
+#include "protocol.h"
+#include "tcp_reactor.h"
+#include "tcp_master.h"
+
+namespace Modbus_Cli {
+
+Tcp_Master::Tcp_Master(const Das::Modbus::Config &config, QObject *parent) :
+    Device(parent),
+    _config(config),
+    _lookup_id(-1),
+    _fd(-1),
+    _reactor_id(0),
+    _want_write(false),
+    _flush_scheduled(false),
+    _next_transaction_id(0),
+    _generation(0),
+    _send_pos(0),
+    _receive_buffer(receive_buffer_size, '\0'),
+    _receive_size(0),
+    _state(QModbusDevice::UnconnectedState),
+    _error(QModbusDevice::NoError)
+{
+    _send_buffer.reserve(receive_buffer_size);
+}
+
+Tcp_Master::~Tcp_Master()
+{
+    if (_lookup_id != -1)
+        QHostInfo::abortHostLookup(_lookup_id);
+
+    // Client is being destroyed too, so no signals and no reply finishing here
+    if (_fd >= 0)
+    {
+        _reactor->remove(_reactor_id, _fd);
+        ::close(_fd);
+    }
+}
+
+bool Tcp_Master::connect_device()
+{
+    if (_state != QModbusDevice::UnconnectedState)
+        return true;
+
+    if (!_reactor)
+        _reactor = Tcp_Reactor::acquire();
+
+    // A name lookup may take seconds, so it must not block the reactor of every connection of the thread
+    const QHostAddress address(_config._tcp._address);
+    if (address.isNull())
+    {
+        set_state(QModbusDevice::ConnectingState);
+        _lookup_id = QHostInfo::lookupHost(_config._tcp._address, this, [this](const QHostInfo& info) { host_found(info); });
+        return true;
+    }
+
+    _addresses = {address};
+    return connect_next();
+}
+
+void Tcp_Master::host_found(const QHostInfo &info)
+{
+    if (info.lookupId() != _lookup_id)
+        return;
+    _lookup_id = -1;
+
+    if (info.error() != QHostInfo::NoError || info.addresses().isEmpty())
+    {
+        set_state(QModbusDevice::UnconnectedState);
+        set_error(QModbusDevice::ConnectionError, tr("Can't resolve %1: %2").arg(_config._tcp._address).arg(info.errorString()));
+        return;
+    }
+
+    _addresses = info.addresses();
+    connect_next();
+}
+
+bool Tcp_Master::connect_next()
+{
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+
+    QString error_text;
+    while (!_addresses.isEmpty())
+    {
+        const QString host = _addresses.takeFirst().toString();
+        addrinfo* addr = nullptr;
+        const int ret = getaddrinfo(host.toLatin1().constData(), QByteArray::number(_config._tcp._port).constData(), &hints, &addr);
+        if (ret != 0 || !addr)
+        {
+            error_text = tr("Can't resolve %1: %2").arg(host).arg(gai_strerror(ret));
+            continue;
+        }
+
+        _fd = ::socket(addr->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+        if (_fd < 0)
+        {
+            freeaddrinfo(addr);
+            error_text = tr("Can't create socket: %1").arg(strerror(errno));
+            continue;
+        }
+
+        const int one = 1;
+        setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        if (_config._tcp._keepalive_s > 0)
+            set_keepalive(_fd, _config._tcp._keepalive_s);
+
+        const bool connected = ::connect(_fd, addr->ai_addr, addr->ai_addrlen) == 0;
+        const int connect_errno = errno;
+        freeaddrinfo(addr);
+
+        if (!connected && connect_errno != EINPROGRESS)
+        {
+            ::close(_fd);
+            _fd = -1;
+            error_text = tr("Can't connect to %1: %2").arg(host).arg(strerror(connect_errno));
+            continue;
+        }
+
+        _reactor_id = _reactor->add(_fd, this, EPOLLIN | EPOLLOUT);
+        if (_reactor_id == 0)
+        {
+            ::close(_fd);
+            _fd = -1;
+            error_text = tr("Can't watch socket: %1").arg(strerror(errno));
+            break;
+        }
+
+        // Connection result comes as EPOLLOUT, even if it's already established
+        _want_write = true;
+        set_state(QModbusDevice::ConnectingState);
+        return true;
+    }
+
+    _addresses.clear();
+    set_state(QModbusDevice::UnconnectedState);
+    set_error(QModbusDevice::ConnectionError, error_text);
+    return false;
+}
+
+void Tcp_Master::disconnect_device()
+{
+    if (_state == QModbusDevice::UnconnectedState)
+        return;
+
+    if (_lookup_id != -1)
+    {
+        QHostInfo::abortHostLookup(_lookup_id);
+        _lookup_id = -1;
+    }
+    _addresses.clear();
+    if (_fd < 0)
+    {
+        set_state(QModbusDevice::UnconnectedState);
+        return;
+    }
+
+    set_state(QModbusDevice::ClosingState);
+    close_socket(QModbusDevice::NoError, QString());
+}
+
+QModbusDevice::State Tcp_Master::state() const
+{
+    return _state;
+}
+
+QModbusDevice::Error Tcp_Master::error() const
+{
+    return _error;
+}
+
+QString Tcp_Master::error_string() const
+{
+    return _error_string;
+}
+
+QModbusReply *Tcp_Master::send(const Request &request, int timeout_ms)
+{
+    if (_state != QModbusDevice::ConnectedState)
+    {
+        _error = QModbusDevice::ConnectionError;
+        _error_string = tr("Device not connected");
+        return nullptr;
+    }
+
+    // MBAP header: transaction id, protocol id 0, length of the rest, unit id
+    const int begin = _send_buffer.size();
+    const quint16 transaction_id = _next_transaction_id++;
+    _send_buffer.append(static_cast<char>(transaction_id >> 8));
+    _send_buffer.append(static_cast<char>(transaction_id & 0xFF));
+    _send_buffer.append(2, '\0');
+    _send_buffer.append(2, '\0');
+    _send_buffer.append(static_cast<char>(request._server_address));
+
+    if (!append_request(request, _send_buffer))
+    {
+        _send_buffer.truncate(begin);
+        _error = QModbusDevice::ProtocolError;
+        _error_string = tr("Invalid request");
+        return nullptr;
+    }
+
+    const int length = _send_buffer.size() - begin - 6;
+    _send_buffer[begin + 4] = static_cast<char>(length >> 8);
+    _send_buffer[begin + 5] = static_cast<char>(length & 0xFF);
+
+    auto reply = new QModbusReply(request._kind == Request::RAW ? QModbusReply::Raw : QModbusReply::Common,
+                                  request._server_address, this);
+    _pending.insert(transaction_id, Pending{reply, request, ++_generation});
+    _reactor->add_timer(_reactor_id, transaction_id, _generation, timeout_ms);
+
+    if (!_flush_scheduled)
+    {
+        _flush_scheduled = true;
+        _reactor->schedule_flush(_reactor_id);
+    }
+    return reply;
+}
+
+void Tcp_Master::handle_events(quint32 events)
+{
+    if (_state == QModbusDevice::ConnectingState)
+    {
+        if (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+            finish_connect();
+        return;
+    }
+
+    if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        read_available();
+
+    if (_fd >= 0 && (events & EPOLLOUT))
+        flush_send();
+}
+
+void Tcp_Master::handle_timeout(quint16 transaction_id, quint32 generation)
+{
+    if (!_pending.contains(transaction_id) || _pending.value(transaction_id)._generation != generation)
+        return;
+
+    const Pending pending = _pending.take(transaction_id);
+    if (pending._reply)
+        pending._reply->setError(QModbusDevice::TimeoutError, tr("Request timeout"));
+}
+
+void Tcp_Master::flush_send()
+{
+    _flush_scheduled = false;
+    if (_fd < 0 || _state != QModbusDevice::ConnectedState)
+        return;
+
+    while (_send_pos < _send_buffer.size())
+    {
+        const ssize_t n = ::send(_fd, _send_buffer.constData() + _send_pos,
+                                 static_cast<size_t>(_send_buffer.size() - _send_pos), MSG_NOSIGNAL);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            close_socket(QModbusDevice::WriteError, tr("Write failed: %1").arg(strerror(errno)));
+            return;
+        }
+        _send_pos += static_cast<int>(n);
+    }
+
+    const bool want_write = _send_pos < _send_buffer.size();
+    if (!want_write)
+    {
+        _send_buffer.resize(0); // Keeps reserved capacity
+        _send_pos = 0;
+    }
+
+    if (want_write != _want_write)
+    {
+        _want_write = want_write;
+        _reactor->modify(_reactor_id, _fd, want_write ? EPOLLIN | EPOLLOUT : EPOLLIN);
+    }
+}
+
+void Tcp_Master::finish_connect()
+{
+    int error = 0;
+    socklen_t size = sizeof(error);
+    if (getsockopt(_fd, SOL_SOCKET, SO_ERROR, &error, &size) != 0)
+        error = errno;
+
+    if (error != 0)
+    {
+        if (_addresses.isEmpty())
+        {
+            close_socket(QModbusDevice::ConnectionError, tr("Can't connect: %1").arg(strerror(error)));
+            return;
+        }
+
+        // Next address of the host, e.g. IPv4 after unreachable IPv6
+        _reactor->remove(_reactor_id, _fd);
+        ::close(_fd);
+        _fd = -1;
+        _reactor_id = 0;
+        connect_next();
+        return;
+    }
+
+    _want_write = false;
+    _reactor->modify(_reactor_id, _fd, EPOLLIN);
+    set_state(QModbusDevice::ConnectedState);
+}
+
+void Tcp_Master::read_available()
+{
+    // Replies are finished right here and their handlers may close or reopen the socket
+    const quint64 connection_id = _reactor_id;
+    quint8* buffer = reinterpret_cast<quint8*>(_receive_buffer.data());
+
+    for (;;)
+    {
+        const ssize_t n = ::recv(_fd, buffer + _receive_size, static_cast<size_t>(receive_buffer_size - _receive_size), 0);
+        if (n == 0)
+        {
+            close_socket(QModbusDevice::ConnectionError, tr("Connection closed by peer"));
+            return;
+        }
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                close_socket(QModbusDevice::ConnectionError, tr("Read failed: %1").arg(strerror(errno)));
+            return;
+        }
+        _receive_size += static_cast<int>(n);
+
+        int pos = 0;
+        while (_receive_size - pos >= mbap_size)
+        {
+            const quint8* adu = buffer + pos;
+            const int size = 6 + ((adu[4] << 8) | adu[5]);
+            if (adu[2] != 0 || adu[3] != 0 || size <= mbap_size || size > max_adu_size)
+            {
+                close_socket(QModbusDevice::ConnectionError, tr("Invalid MBAP header"));
+                return;
+            }
+            if (_receive_size - pos < size)
+                break;
+
+            process_frame(adu, size);
+            if (_reactor_id != connection_id)
+                return;
+            pos += size;
+        }
+
+        if (pos > 0)
+        {
+            memmove(buffer, buffer + pos, static_cast<size_t>(_receive_size - pos));
+            _receive_size -= pos;
+        }
+    }
+}
+
+void Tcp_Master::process_frame(const quint8 *adu, int size)
+{
+    const quint16 transaction_id = static_cast<quint16>((adu[0] << 8) | adu[1]);
+    if (!_pending.contains(transaction_id))
+        return; // Late response to timed out request
+
+    const Pending pending = _pending.take(transaction_id);
+    if (!pending._reply)
+        return;
+
+    // Protocol id is checked with the header. A gateway mixing up its slaves must not deliver another one's data.
+    if (adu[6] != static_cast<quint8>(pending._request._server_address))
+        pending._reply->setError(QModbusDevice::ReadError, tr("Unexpected response from unit %1").arg(adu[6]));
+    else
+        finish_reply(pending._reply, pending._request,
+                     QByteArray(reinterpret_cast<const char*>(adu + mbap_size), size - mbap_size));
+}
+
+/*static*/ void Tcp_Master::set_keepalive(int fd, int idle_s)
+{
+    const int one = 1;
+    const int interval_s = 1;
+    const int probe_count = 3;
+    const unsigned int user_timeout_ms = idle_s * 1000u;
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle_s, sizeof(idle_s));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval_s, sizeof(interval_s));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &probe_count, sizeof(probe_count));
+    setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &user_timeout_ms, sizeof(user_timeout_ms));
+}
+
+void Tcp_Master::close_socket(QModbusDevice::Error error, const QString &text)
+{
+    if (_fd < 0)
+        return;
+
+    _reactor->remove(_reactor_id, _fd);
+    ::close(_fd);
+    _fd = -1;
+    _reactor_id = 0;
+    _want_write = false;
+    _flush_scheduled = false;
+    _send_buffer.resize(0);
+    _send_pos = 0;
+    _receive_size = 0;
+
+    // State first, so reply handlers don't try to resend into the closed socket
+    set_state(QModbusDevice::UnconnectedState);
+
+    const auto pending = _pending.values();
+    _pending.clear();
+    for (const Pending& item: pending)
+        if (item._reply)
+            item._reply->setError(QModbusDevice::ReplyAbortedError, tr("Connection closed"));
+
+    if (error != QModbusDevice::NoError)
+        set_error(error, text);
+}
+
+void Tcp_Master::set_state(QModbusDevice::State state)
+{
+    if (_state == state)
+        return;
+    _state = state;
+    emit state_changed(state);
+}
+
+void Tcp_Master::set_error(QModbusDevice::Error error, const QString &text)
+{
+    _error = error;
+    _error_string = text;
+    emit error_occurred(error);
+}
+
+} // namespace Modbus_Cli
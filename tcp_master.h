@@ -0,0 +1,98 @@
+#ifndef MODBUS_CLI_TCP_MASTER_H
+#define MODBUS_CLI_TCP_MASTER_H
+
+#include <memory>
+
+#include <QHash>
+#include <QHostAddress>
+#include <QPointer>
+#include <QModbusReply>
+
+#include "device.h"
+
+class QHostInfo;
+
+namespace Modbus_Cli {
+
+class Tcp_Reactor;
+
+/*
+ * Modbus TCP client on a non-blocking socket driven by the thread's Tcp_Reactor.
+ * Selected by mtcp://host:port?engine=epoll. Requests are encoded straight into the
+ * send buffer and all requests of one event loop iteration go out in one write.
+ * Host names are resolved by QHostInfo off the reactor thread, every address of the host is tried in turn.
+ */
+class Tcp_Master : public Device
+{
+    Q_OBJECT
+public:
+    Tcp_Master(const Das::Modbus::Config& config, QObject* parent = nullptr);
+    ~Tcp_Master();
+
+    bool connect_device() override;
+    void disconnect_device() override;
+
+    QModbusDevice::State state() const override;
+    QModbusDevice::Error error() const override;
+    QString error_string() const override;
+
+    QModbusReply* send(const Request& request, int timeout_ms) override;
+
+    /// Idle connection is probed every second after idle_s, it fails after 3 lost probes
+    /// or when sent data isn't acknowledged for idle_s
+    static void set_keepalive(int fd, int idle_s);
+private:
+    friend class Tcp_Reactor;
+
+    void handle_events(quint32 events);
+    void handle_timeout(quint16 transaction_id, quint32 generation);
+    void flush_send();
+
+    void host_found(const QHostInfo& info);
+    /// Connects to the next address left, false when none of them accepts
+    bool connect_next();
+    void finish_connect();
+    void read_available();
+    void process_frame(const quint8* adu, int size);
+
+    void close_socket(QModbusDevice::Error error, const QString& text);
+    void set_state(QModbusDevice::State state);
+    void set_error(QModbusDevice::Error error, const QString& text);
+
+    struct Pending
+    {
+        QPointer<QModbusReply> _reply;
+        Request _request;
+        quint32 _generation;
+    };
+
+    static const int mbap_size = 7;
+    static const int max_adu_size = 260;
+    static const int receive_buffer_size = 8192;
+
+    Das::Modbus::Config _config;
+    std::shared_ptr<Tcp_Reactor> _reactor;
+    int _lookup_id;                 ///< Host lookup running, -1 if none
+    QList<QHostAddress> _addresses; ///< Addresses of the host not tried yet
+    int _fd;
+    quint64 _reactor_id;
+    bool _want_write;
+    bool _flush_scheduled;
+
+    quint16 _next_transaction_id;
+    quint32 _generation;
+    QHash<quint16, Pending> _pending;
+
+    QByteArray _send_buffer;
+    int _send_pos;
+    QByteArray _receive_buffer;
+    int _receive_size;
+
+    QModbusDevice::State _state;
+    QModbusDevice::Error _error;
+    QString _error_string;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_TCP_MASTER_H
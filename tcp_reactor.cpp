@@ -0,0 +1,177 @@
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <QSocketNotifier>
+#include <QMetaObject>
+
+#include "tcp_master.h"
+#include "tcp_reactor.h"
+
+namespace Modbus_Cli {
+
+const int Tcp_Reactor::tick_ms;
+
+/*static*/ std::shared_ptr<Tcp_Reactor> Tcp_Reactor::acquire()
+{
+    thread_local std::weak_ptr<Tcp_Reactor> current;
+    std::shared_ptr<Tcp_Reactor> reactor = current.lock();
+    if (!reactor)
+    {
+        reactor.reset(new Tcp_Reactor);
+        current = reactor;
+    }
+    return reactor;
+}
+
+Tcp_Reactor::Tcp_Reactor() :
+    _epoll_fd(epoll_create1(EPOLL_CLOEXEC)),
+    _notifier(nullptr),
+    _next_id(0),
+    _wheel(wheel_size),
+    _wheel_pos(0),
+    _timer_count(0)
+{
+    if (_epoll_fd >= 0)
+    {
+        _notifier = new QSocketNotifier(_epoll_fd, QSocketNotifier::Read, this);
+        connect(_notifier, &QSocketNotifier::activated, this, &Tcp_Reactor::process_events);
+    }
+
+    _tick_timer.setInterval(tick_ms);
+    connect(&_tick_timer, &QTimer::timeout, this, &Tcp_Reactor::tick);
+}
+
+Tcp_Reactor::~Tcp_Reactor()
+{
+    if (_epoll_fd >= 0)
+        ::close(_epoll_fd);
+}
+
+quint64 Tcp_Reactor::add(int fd, Tcp_Master *master, quint32 events)
+{
+    if (_epoll_fd < 0)
+        return 0;
+
+    const quint64 id = ++_next_id;
+    epoll_event event;
+    event.events = events;
+    event.data.u64 = id;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+        return 0;
+
+    _masters.insert(id, master);
+    return id;
+}
+
+bool Tcp_Reactor::modify(quint64 id, int fd, quint32 events)
+{
+    epoll_event event;
+    event.events = events;
+    event.data.u64 = id;
+    return epoll_ctl(_epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void Tcp_Reactor::remove(quint64 id, int fd)
+{
+    // Timers and scheduled flushes of removed master are dropped when they come up
+    _masters.remove(id);
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void Tcp_Reactor::add_timer(quint64 id, quint16 transaction_id, quint32 generation, int timeout_ms)
+{
+    using namespace std::chrono;
+
+    const auto now = steady_clock::now();
+    if (_timer_count == 0)
+    {
+        _wheel_time = now;
+        _tick_timer.start();
+    }
+
+    // The wheel lags behind when the event loop is late, count ticks from its time, not from now
+    const qint64 due_ms = duration_cast<milliseconds>(now - _wheel_time).count() + timeout_ms;
+    const int ticks = static_cast<int>(std::max<qint64>(1, (due_ms + tick_ms - 1) / tick_ms));
+    const int slot = (_wheel_pos + ticks) % wheel_size;
+    _wheel[slot].push_back(Timer_Entry{id, generation, transaction_id, (ticks - 1) / wheel_size});
+    ++_timer_count;
+}
+
+void Tcp_Reactor::schedule_flush(quint64 id)
+{
+    if (_flush.empty())
+        QMetaObject::invokeMethod(this, [this]() { flush_scheduled(); }, Qt::QueuedConnection);
+    _flush.push_back(id);
+}
+
+void Tcp_Reactor::process_events()
+{
+    epoll_event events[max_events];
+    int count;
+    do
+    {
+        count = epoll_wait(_epoll_fd, events, max_events, 0);
+        for (int i = 0; i < count; ++i)
+        {
+            // Master may be removed by handler of previous event
+            Tcp_Master* master = _masters.value(events[i].data.u64, nullptr);
+            if (master)
+                master->handle_events(events[i].events);
+        }
+    }
+    while (count == max_events);
+}
+
+void Tcp_Reactor::tick()
+{
+    using namespace std::chrono;
+
+    // Catch up with real time if event loop was late
+    const auto now = steady_clock::now();
+    std::vector<Timer_Entry> expired;
+    while (_wheel_time + milliseconds(tick_ms) <= now)
+    {
+        _wheel_time += milliseconds(tick_ms);
+        _wheel_pos = (_wheel_pos + 1) % wheel_size;
+
+        std::vector<Timer_Entry>& slot = _wheel[_wheel_pos];
+        auto keep = slot.begin();
+        for (const Timer_Entry& entry: slot)
+        {
+            if (entry._rounds > 0)
+            {
+                *keep = entry;
+                --keep->_rounds;
+                ++keep;
+            }
+            else
+                expired.push_back(entry);
+        }
+        slot.erase(keep, slot.end());
+    }
+
+    _timer_count -= static_cast<int>(expired.size());
+    if (_timer_count == 0)
+        _tick_timer.stop();
+
+    for (const Timer_Entry& entry: expired)
+    {
+        Tcp_Master* master = _masters.value(entry._id, nullptr);
+        if (master)
+            master->handle_timeout(entry._transaction_id, entry._generation);
+    }
+}
+
+void Tcp_Reactor::flush_scheduled()
+{
+    std::vector<quint64> ids;
+    ids.swap(_flush);
+    for (quint64 id: ids)
+    {
+        Tcp_Master* master = _masters.value(id, nullptr);
+        if (master)
+            master->flush_send();
+    }
+}
+
+} // namespace Modbus_Cli
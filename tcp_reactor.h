@@ -0,0 +1,77 @@
+#ifndef MODBUS_CLI_TCP_REACTOR_H
+#define MODBUS_CLI_TCP_REACTOR_H
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <QObject>
+#include <QHash>
+#include <QTimer>
+
+QT_FORWARD_DECLARE_CLASS(QSocketNotifier)
+
+namespace Modbus_Cli {
+
+class Tcp_Master;
+
+/*
+ * One epoll instance and one timer wheel per thread, shared by all Tcp_Master of the thread.
+ * The epoll fd is watched by the thread event loop, so masters stay ordinary QObjects.
+ */
+class Tcp_Reactor : public QObject
+{
+    Q_OBJECT
+public:
+    /// Reactor of the current thread. Lives while somebody holds it.
+    static std::shared_ptr<Tcp_Reactor> acquire();
+
+    ~Tcp_Reactor();
+
+    /// Returns id used in the rest of the calls, 0 on error
+    quint64 add(int fd, Tcp_Master* master, quint32 events);
+    bool modify(quint64 id, int fd, quint32 events);
+    void remove(quint64 id, int fd);
+
+    /// Calls master->handle_timeout(transaction_id, generation) after timeout_ms unless master is removed
+    void add_timer(quint64 id, quint16 transaction_id, quint32 generation, int timeout_ms);
+
+    /// Calls master->flush_send() once the current event loop iteration is done
+    void schedule_flush(quint64 id);
+private slots:
+    void process_events();
+    void tick();
+private:
+    Tcp_Reactor();
+
+    void flush_scheduled();
+
+    struct Timer_Entry
+    {
+        quint64 _id;
+        quint32 _generation;
+        quint16 _transaction_id;
+        int _rounds;
+    };
+
+    static const int wheel_size = 1024;
+    static const int tick_ms = 5;
+    static const int max_events = 256;
+
+    int _epoll_fd;
+    QSocketNotifier* _notifier;
+    quint64 _next_id;
+    QHash<quint64, Tcp_Master*> _masters;
+
+    std::vector<std::vector<Timer_Entry>> _wheel;
+    int _wheel_pos;
+    int _timer_count;
+    std::chrono::steady_clock::time_point _wheel_time;  ///< Time of slot _wheel_pos
+    QTimer _tick_timer;
+
+    std::vector<quint64> _flush;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_TCP_REACTOR_H
@@ -0,0 +1,9 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+        tst_bus_scheduler \
+        tst_change_filter \
+        tst_protocol \
+        tst_register_cache \
+        tst_rtt_estimator \
+        tst_scan_list
@@ -0,0 +1,105 @@
+#include <QTest>
+
+#include "bus_scheduler.h"
+
+using namespace Modbus_Cli;
+
+class Tst_Bus_Scheduler : public QObject
+{
+    Q_OBJECT
+private slots:
+    void order();
+    void isolation();
+    void backoff_limit();
+    void broadcast();
+};
+
+namespace {
+
+Request request(int server_address, int priority, Request::Clock::time_point deadline = Request::no_deadline())
+{
+    Request request = Request::read(server_address, QModbusDataUnit::HoldingRegisters, 0, 1);
+    request._priority = priority;
+    request._deadline = deadline;
+    return request;
+}
+
+} // namespace
+
+void Tst_Bus_Scheduler::order()
+{
+    // Retries first, then priority, then deadline, then arrival
+    const auto now = Bus_Scheduler::Clock::now();
+    Bus_Scheduler scheduler;
+    scheduler.push(request(1, 0));
+    scheduler.push(request(2, 0));
+    scheduler.push(request(3, 0, now + std::chrono::seconds(1)));
+    scheduler.push(request(4, 5));
+    scheduler.push(request(5, 0), 1);
+    QCOMPARE(scheduler.size(), 5);
+
+    QVector<int> order;
+    Request next;
+    int attempt;
+    while (scheduler.pop(next, attempt))
+        order.push_back(next._server_address);
+    QCOMPARE(order, QVector<int>({5, 4, 3, 1, 2}));
+    QVERIFY(scheduler.is_empty());
+}
+
+void Tst_Bus_Scheduler::isolation()
+{
+    const auto now = Bus_Scheduler::Clock::now();
+    Bus_Scheduler scheduler;
+    for (int i = 1; i < Bus_Scheduler::isolate_after; ++i)
+        QCOMPARE(scheduler.report(1, false, now), Bus_Scheduler::NO_CHANGE);
+    QVERIFY(scheduler.admit(1, now));
+
+    QCOMPARE(scheduler.report(1, false, now), Bus_Scheduler::ISOLATED);
+    QVERIFY(scheduler.is_isolated(1));
+    QCOMPARE(scheduler.isolated_count(), 1);
+    QCOMPARE(scheduler.backoff_ms(1), static_cast<int>(Bus_Scheduler::min_backoff_ms));
+    QVERIFY(!scheduler.admit(1, now));
+    QVERIFY(scheduler.admit(2, now));
+    QVERIFY(scheduler.next_probe(now) == std::chrono::milliseconds(Bus_Scheduler::min_backoff_ms));
+
+    // One probe after the back-off, a failed probe doubles it
+    const auto later = now + std::chrono::milliseconds(Bus_Scheduler::min_backoff_ms);
+    QVERIFY(scheduler.admit(1, later));
+    QVERIFY(!scheduler.admit(1, later));
+    QCOMPARE(scheduler.report(1, false, later), Bus_Scheduler::ISOLATED);
+    QCOMPARE(scheduler.backoff_ms(1), 2 * Bus_Scheduler::min_backoff_ms);
+
+    const auto probe = later + std::chrono::milliseconds(2 * Bus_Scheduler::min_backoff_ms);
+    QVERIFY(scheduler.admit(1, probe));
+    QCOMPARE(scheduler.report(1, true, probe), Bus_Scheduler::RECOVERED);
+    QVERIFY(!scheduler.is_isolated(1));
+    QCOMPARE(scheduler.backoff_ms(1), 0);
+    QVERIFY(scheduler.admit(1, probe));
+}
+
+void Tst_Bus_Scheduler::backoff_limit()
+{
+    auto now = Bus_Scheduler::Clock::now();
+    Bus_Scheduler scheduler;
+    for (int i = 0; i < 20; ++i)
+    {
+        scheduler.report(1, false, now);
+        now += std::chrono::milliseconds(scheduler.backoff_ms(1));
+    }
+    QCOMPARE(scheduler.backoff_ms(1), static_cast<int>(Bus_Scheduler::max_backoff_ms));
+}
+
+void Tst_Bus_Scheduler::broadcast()
+{
+    const auto now = Bus_Scheduler::Clock::now();
+    Bus_Scheduler scheduler;
+    for (int i = 0; i < 2 * Bus_Scheduler::isolate_after; ++i)
+        QCOMPARE(scheduler.report(0, false, now), Bus_Scheduler::NO_CHANGE);
+    QVERIFY(scheduler.admit(0, now));
+    QCOMPARE(scheduler.isolated_count(), 0);
+}
+
+QTEST_APPLESS_MAIN(Tst_Bus_Scheduler)
+
+#include "tst_bus_scheduler.moc"
@@ -0,0 +1,17 @@
+QT -= gui
+QT += serialbus testlib
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_bus_scheduler
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+        ../../bus_scheduler.cpp \
+        tst_bus_scheduler.cpp
+
+HEADERS += \
+    ../../bus_scheduler.h \
+    ../../request.h
@@ -0,0 +1,109 @@
+#include <algorithm>
+
+#include <QTest>
+
+#include "change_filter.h"
+
+using namespace Modbus_Cli;
+
+class Tst_Change_Filter : public QObject
+{
+    Q_OBJECT
+private slots:
+    void first_read();
+    void runs();
+    void deadband();
+    void slot();
+};
+
+namespace {
+
+struct Run
+{
+    int _start;
+    QVector<quint16> _values;
+};
+
+/// Runs the filter passes on for one read
+QVector<Run> filter(Change_Filter& change_filter, int start, const QVector<quint16>& values, int deadband = -1, int slot = -1)
+{
+    QVector<Run> runs;
+    change_filter.filter(1, QModbusDataUnit::HoldingRegisters, start, values.constData(), values.size(), deadband,
+                         [&runs](int run_start, const quint16* data, int count)
+    {
+        runs.push_back(Run{run_start, QVector<quint16>(count)});
+        std::copy(data, data + count, runs.last()._values.begin());
+    }, slot);
+    return runs;
+}
+
+} // namespace
+
+void Tst_Change_Filter::first_read()
+{
+    Change_Filter change_filter(0, 0);
+    const QVector<quint16> values(10, 7);
+    QVector<Run> runs = filter(change_filter, 100, values);
+    QCOMPARE(runs.size(), 1);
+    QCOMPARE(runs.at(0)._start, 100);
+    QCOMPARE(runs.at(0)._values, values);
+
+    QVERIFY(filter(change_filter, 100, values).isEmpty());
+
+    // Another range is a block of its own
+    QCOMPARE(filter(change_filter, 100, values.mid(0, 5)).size(), 1);
+}
+
+void Tst_Change_Filter::runs()
+{
+    Change_Filter change_filter(0, 0);
+    QVector<quint16> values(12, 0);
+    filter(change_filter, 0, values);
+
+    values[2] = values[3] = 1;
+    values[7] = 1;
+    values[11] = 1;
+    const QVector<Run> runs = filter(change_filter, 0, values);
+    QCOMPARE(runs.size(), 3);
+    QCOMPARE(runs.at(0)._start, 2);
+    QCOMPARE(runs.at(0)._values.size(), 2);
+    QCOMPARE(runs.at(1)._start, 7);
+    QCOMPARE(runs.at(1)._values.size(), 1);
+    QCOMPARE(runs.at(2)._start, 11);
+    QCOMPARE(runs.at(2)._values.size(), 1);
+}
+
+void Tst_Change_Filter::deadband()
+{
+    Change_Filter change_filter(5, 0);
+    filter(change_filter, 0, QVector<quint16>(3, 100));
+
+    QVERIFY(filter(change_filter, 0, {103, 100, 95}).isEmpty());
+
+    // Drift is measured from the last reported value
+    const QVector<Run> runs = filter(change_filter, 0, {106, 100, 100});
+    QCOMPARE(runs.size(), 1);
+    QCOMPARE(runs.at(0)._start, 0);
+    QCOMPARE(runs.at(0)._values.size(), 1);
+    QCOMPARE(runs.at(0)._values.at(0), static_cast<quint16>(106));
+
+    // Deadband of the range overrides the default one
+    QCOMPARE(filter(change_filter, 0, {106, 101, 100}, 0).size(), 1);
+}
+
+void Tst_Change_Filter::slot()
+{
+    Change_Filter change_filter(0, 0);
+    const QVector<quint16> values(4, 1);
+    QCOMPARE(filter(change_filter, 0, values, -1, 0).size(), 1);
+
+    // A range whose start moved is compared with the last values of its slot
+    QVERIFY(filter(change_filter, 40, values, -1, 0).isEmpty());
+    const QVector<Run> runs = filter(change_filter, 80, {1, 2, 1, 1}, -1, 0);
+    QCOMPARE(runs.size(), 1);
+    QCOMPARE(runs.at(0)._start, 81);
+}
+
+QTEST_APPLESS_MAIN(Tst_Change_Filter)
+
+#include "tst_change_filter.moc"
@@ -0,0 +1,16 @@
+QT -= gui
+QT += serialbus testlib
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_change_filter
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+        ../../change_filter.cpp \
+        tst_change_filter.cpp
+
+HEADERS += \
+    ../../change_filter.h
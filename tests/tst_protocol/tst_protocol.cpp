@@ -0,0 +1,164 @@
+#include <QTest>
+
+#include "protocol.h"
+#include "request.h"
+
+using namespace Modbus_Cli;
+
+class Tst_Protocol : public QObject
+{
+    Q_OBJECT
+private slots:
+    void read_fits();
+    void read_parts();
+    void write_parts();
+    void read_write_parts();
+    void reassembly();
+    void bad_response();
+};
+
+namespace {
+
+QVector<quint16> sequence(int count)
+{
+    QVector<quint16> values;
+    for (int i = 0; i < count; ++i)
+        values.push_back(static_cast<quint16>(i * 7 + 1));
+    return values;
+}
+
+QVector<quint16> bits(int count)
+{
+    QVector<quint16> values;
+    for (int i = 0; i < count; ++i)
+        values.push_back(static_cast<quint16>(i % 3 == 0));
+    return values;
+}
+
+/// Read response PDU a device would send to request
+QByteArray response_pdu(const Request& request, const QVector<quint16>& values)
+{
+    QByteArray pdu = encode_request(request).left(1);
+    if (is_bit_type(request._type))
+    {
+        QByteArray data((values.size() + 7) / 8, '\0');
+        for (int i = 0; i < values.size(); ++i)
+            if (values.at(i))
+                data[i / 8] = static_cast<char>(data.at(i / 8) | (1 << (i % 8)));
+        pdu.append(static_cast<char>(data.size()));
+        pdu.append(data);
+    }
+    else
+    {
+        pdu.append(static_cast<char>(values.size() * 2));
+        for (quint16 value: values)
+        {
+            pdu.append(static_cast<char>(value >> 8));
+            pdu.append(static_cast<char>(value & 0xFF));
+        }
+    }
+    return pdu;
+}
+
+} // namespace
+
+void Tst_Protocol::read_fits()
+{
+    QVERIFY(split_request(Request::read(1, QModbusDataUnit::HoldingRegisters, 0, MAX_READ_REGISTERS)).isEmpty());
+    QVERIFY(split_request(Request::read(1, QModbusDataUnit::InputRegisters, 0xFFFF - 124, MAX_READ_REGISTERS)).isEmpty());
+    QVERIFY(split_request(Request::read(1, QModbusDataUnit::Coils, 0, MAX_READ_BITS)).isEmpty());
+    QVERIFY(split_request(Request::write(1, QModbusDataUnit::HoldingRegisters, 0, sequence(MAX_WRITE_REGISTERS))).isEmpty());
+    QVERIFY(split_request(Request::write(1, QModbusDataUnit::Coils, 0, bits(MAX_WRITE_BITS))).isEmpty());
+    QVERIFY(split_request(Request::read_write(1, QModbusDataUnit::HoldingRegisters, 0, MAX_READ_WRITE_READ,
+                                              sequence(MAX_READ_WRITE_WRITE))).isEmpty());
+}
+
+void Tst_Protocol::read_parts()
+{
+    const QVector<Request> registers = split_request(Request::read(1, QModbusDataUnit::HoldingRegisters, 10, MAX_READ_REGISTERS + 1));
+    QCOMPARE(registers.size(), 2);
+    QCOMPARE(registers.at(0)._start, 10);
+    QCOMPARE(registers.at(0)._count, static_cast<int>(MAX_READ_REGISTERS));
+    QCOMPARE(registers.at(1)._start, 10 + MAX_READ_REGISTERS);
+    QCOMPARE(registers.at(1)._count, 1);
+
+    const QVector<Request> coils = split_request(Request::read(1, QModbusDataUnit::DiscreteInputs, 0, 2 * MAX_READ_BITS + 5));
+    QCOMPARE(coils.size(), 3);
+    QCOMPARE(coils.at(2)._start, 2 * MAX_READ_BITS);
+    QCOMPARE(coils.at(2)._count, 5);
+    for (const Request& part: coils)
+    {
+        QCOMPARE(part._kind, Request::READ);
+        QVERIFY(!encode_request(part).isEmpty());
+    }
+}
+
+void Tst_Protocol::write_parts()
+{
+    const QVector<quint16> values = sequence(2 * MAX_WRITE_REGISTERS + 1);
+    const QVector<Request> registers = split_request(Request::write(1, QModbusDataUnit::HoldingRegisters, 100, values));
+    QCOMPARE(registers.size(), 3);
+    QCOMPARE(registers.at(1)._start, 100 + MAX_WRITE_REGISTERS);
+    QCOMPARE(registers.at(1)._values, values.mid(MAX_WRITE_REGISTERS, MAX_WRITE_REGISTERS));
+    QCOMPARE(registers.at(2)._count, 1);
+    QCOMPARE(registers.at(2)._values.first(), values.last());
+
+    const QVector<Request> coils = split_request(Request::write(1, QModbusDataUnit::Coils, 0, bits(MAX_WRITE_BITS + 1)));
+    QCOMPARE(coils.size(), 2);
+    QCOMPARE(coils.at(0)._count, static_cast<int>(MAX_WRITE_BITS));
+    QCOMPARE(coils.at(1)._start, static_cast<int>(MAX_WRITE_BITS));
+}
+
+void Tst_Protocol::read_write_parts()
+{
+    // Function 23 writes first, so oversized read-write is all writes, then all reads
+    const QVector<Request> parts = split_request(Request::read_write(1, QModbusDataUnit::HoldingRegisters, 0, MAX_READ_WRITE_READ,
+                                                                     sequence(MAX_READ_WRITE_WRITE + 1)));
+    QCOMPARE(parts.size(), 2);
+    QCOMPARE(parts.at(0)._kind, Request::WRITE);
+    QCOMPARE(parts.at(0)._count, MAX_READ_WRITE_WRITE + 1);
+    QCOMPARE(parts.at(1)._kind, Request::READ);
+    QCOMPARE(parts.at(1)._count, static_cast<int>(MAX_READ_WRITE_READ));
+
+    const QVector<Request> reads = split_request(Request::read_write(1, QModbusDataUnit::HoldingRegisters, 0, MAX_READ_WRITE_READ + 1,
+                                                                     sequence(1)));
+    QCOMPARE(reads.size(), 3);
+    QCOMPARE(reads.at(0)._kind, Request::WRITE);
+    QCOMPARE(reads.at(2)._count, 1);
+}
+
+void Tst_Protocol::reassembly()
+{
+    for (QModbusDataUnit::RegisterType type: {QModbusDataUnit::HoldingRegisters, QModbusDataUnit::Coils})
+    {
+        const int count = 2 * max_read_count(type) + 3;
+        const QVector<quint16> expected = is_bit_type(type) ? bits(count) : sequence(count);
+        const Request request = Request::read(1, type, 7, count);
+
+        QVector<quint16> values;
+        for (const Request& part: split_request(request))
+        {
+            QCOMPARE(part._start, request._start + values.size());
+
+            QModbusDataUnit unit;
+            QVERIFY(decode_response(part, response_pdu(part, expected.mid(values.size(), part._count)), unit));
+            QCOMPARE(unit.startAddress(), part._start);
+            values.append(unit.values());
+        }
+        QCOMPARE(values, expected);
+    }
+}
+
+void Tst_Protocol::bad_response()
+{
+    const Request request = Request::read(1, QModbusDataUnit::HoldingRegisters, 0, 2);
+    QModbusDataUnit unit;
+    QVERIFY(decode_response(request, response_pdu(request, sequence(2)), unit));
+    QVERIFY(!decode_response(request, response_pdu(request, sequence(3)), unit));
+    QVERIFY(!decode_response(request, response_pdu(request, sequence(2)).left(5), unit));
+    QVERIFY(!decode_response(request, QByteArray(), unit));
+}
+
+QTEST_APPLESS_MAIN(Tst_Protocol)
+
+#include "tst_protocol.moc"
@@ -0,0 +1,17 @@
+QT -= gui
+QT += serialbus testlib
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_protocol
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+        ../../protocol.cpp \
+        tst_protocol.cpp
+
+HEADERS += \
+    ../../protocol.h \
+    ../../request.h
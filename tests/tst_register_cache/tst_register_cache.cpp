@@ -0,0 +1,103 @@
+#include <QTest>
+
+#include "register_cache.h"
+
+using namespace Modbus_Cli;
+
+class Tst_Register_Cache : public QObject
+{
+    Q_OBJECT
+private slots:
+    void get();
+    void age();
+    void invalidate();
+    void broadcast();
+};
+
+namespace {
+
+const qint64 long_ago_ms = 1000000;
+
+} // namespace
+
+void Tst_Register_Cache::get()
+{
+    Register_Cache cache;
+    QVector<quint16> values;
+    QVERIFY(!cache.get(1, QModbusDataUnit::HoldingRegisters, 0, 1, long_ago_ms, values));
+
+    cache.put(1, QModbusDataUnit::HoldingRegisters, 10, {1, 2, 3, 4});
+    QVERIFY(cache.get(1, QModbusDataUnit::HoldingRegisters, 11, 2, long_ago_ms, values));
+    QCOMPARE(values, QVector<quint16>({2, 3}));
+
+    // Every register of the range must be cached
+    QVERIFY(!cache.get(1, QModbusDataUnit::HoldingRegisters, 12, 3, long_ago_ms, values));
+    QVERIFY(!cache.get(1, QModbusDataUnit::InputRegisters, 10, 4, long_ago_ms, values));
+    QVERIFY(!cache.get(2, QModbusDataUnit::HoldingRegisters, 10, 4, long_ago_ms, values));
+    QVERIFY(!cache.get(1, QModbusDataUnit::HoldingRegisters, 0xFFFF, 2, long_ago_ms, values));
+
+    cache.put(1, QModbusDataUnit::HoldingRegisters, 14, {5});
+    QVERIFY(cache.get(1, QModbusDataUnit::HoldingRegisters, 10, 5, long_ago_ms, values));
+    QCOMPARE(values.last(), static_cast<quint16>(5));
+
+    cache.clear();
+    QVERIFY(!cache.get(1, QModbusDataUnit::HoldingRegisters, 10, 1, long_ago_ms, values));
+}
+
+void Tst_Register_Cache::age()
+{
+    Register_Cache cache;
+    QVector<quint16> values;
+    cache.put(1, QModbusDataUnit::Coils, 0, {1, 0, 1});
+    QTest::qSleep(30);
+    QVERIFY(!cache.get(1, QModbusDataUnit::Coils, 0, 3, 10, values));
+    QVERIFY(cache.get(1, QModbusDataUnit::Coils, 0, 3, long_ago_ms, values));
+
+    // A newer read of a part doesn't make the rest fresh
+    cache.put(1, QModbusDataUnit::Coils, 0, {1});
+    QVERIFY(cache.get(1, QModbusDataUnit::Coils, 0, 1, 10, values));
+    QVERIFY(!cache.get(1, QModbusDataUnit::Coils, 0, 3, 10, values));
+}
+
+void Tst_Register_Cache::invalidate()
+{
+    Register_Cache cache;
+    QVector<quint16> values;
+    cache.put(1, QModbusDataUnit::HoldingRegisters, 0, QVector<quint16>(10, 7));
+    cache.put(2, QModbusDataUnit::HoldingRegisters, 0, QVector<quint16>(10, 7));
+
+    cache.invalidate(1, QModbusDataUnit::HoldingRegisters, 4, 2);
+    QVERIFY(!cache.get(1, QModbusDataUnit::HoldingRegisters, 0, 10, long_ago_ms, values));
+    QVERIFY(!cache.get(1, QModbusDataUnit::HoldingRegisters, 5, 1, long_ago_ms, values));
+    QVERIFY(cache.get(1, QModbusDataUnit::HoldingRegisters, 0, 4, long_ago_ms, values));
+    QVERIFY(cache.get(1, QModbusDataUnit::HoldingRegisters, 6, 4, long_ago_ms, values));
+    QVERIFY(cache.get(2, QModbusDataUnit::HoldingRegisters, 0, 10, long_ago_ms, values));
+
+    // Out of range parts are ignored
+    cache.invalidate(2, QModbusDataUnit::HoldingRegisters, -5, 6);
+    QVERIFY(!cache.get(2, QModbusDataUnit::HoldingRegisters, 0, 1, long_ago_ms, values));
+    QVERIFY(cache.get(2, QModbusDataUnit::HoldingRegisters, 1, 9, long_ago_ms, values));
+}
+
+void Tst_Register_Cache::broadcast()
+{
+    // Broadcast write drops the range of every slave, other types stay
+    Register_Cache cache;
+    QVector<quint16> values;
+    for (int slave = 1; slave <= 3; ++slave)
+    {
+        cache.put(slave, QModbusDataUnit::HoldingRegisters, 0, QVector<quint16>(4, 1));
+        cache.put(slave, QModbusDataUnit::InputRegisters, 0, QVector<quint16>(4, 1));
+    }
+
+    cache.invalidate(0, QModbusDataUnit::HoldingRegisters, 0, 4);
+    for (int slave = 1; slave <= 3; ++slave)
+    {
+        QVERIFY(!cache.get(slave, QModbusDataUnit::HoldingRegisters, 0, 1, long_ago_ms, values));
+        QVERIFY(cache.get(slave, QModbusDataUnit::InputRegisters, 0, 4, long_ago_ms, values));
+    }
+}
+
+QTEST_APPLESS_MAIN(Tst_Register_Cache)
+
+#include "tst_register_cache.moc"
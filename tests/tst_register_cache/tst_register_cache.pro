@@ -0,0 +1,16 @@
+QT -= gui
+QT += serialbus testlib
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_register_cache
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+        ../../register_cache.cpp \
+        tst_register_cache.cpp
+
+HEADERS += \
+    ../../register_cache.h
@@ -0,0 +1,83 @@
+#include <QTest>
+
+#include "rtt_estimator.h"
+
+using namespace Modbus_Cli;
+
+class Tst_Rtt_Estimator : public QObject
+{
+    Q_OBJECT
+private slots:
+    void no_sample();
+    void first_sample();
+    void converge();
+    void limits();
+    void backoff();
+};
+
+void Tst_Rtt_Estimator::no_sample()
+{
+    Rtt_Estimator estimator(20, 1000);
+    QCOMPARE(estimator.timeout_ms(), 1000);
+    estimator.backoff();
+    QCOMPARE(estimator.timeout_ms(), 1000);
+}
+
+void Tst_Rtt_Estimator::first_sample()
+{
+    // RTO = SRTT + 4 * RTTVAR, RTTVAR starts at half the sample
+    Rtt_Estimator estimator(0, 1000);
+    estimator.add_sample(10000);
+    QCOMPARE(estimator.srtt_us(), static_cast<qint64>(10000));
+    QCOMPARE(estimator.timeout_ms(), 30);
+}
+
+void Tst_Rtt_Estimator::converge()
+{
+    // Steady round trips leave SRTT plus the 1 ms floor of the deviation term
+    Rtt_Estimator estimator(0, 1000);
+    for (int i = 0; i < 200; ++i)
+        estimator.add_sample(10000);
+    QCOMPARE(estimator.srtt_us(), static_cast<qint64>(10000));
+    QCOMPARE(estimator.timeout_ms(), 11);
+
+    estimator.add_sample(50000);
+    QVERIFY(estimator.srtt_us() > 10000);
+    QVERIFY(estimator.timeout_ms() > 30);
+}
+
+void Tst_Rtt_Estimator::limits()
+{
+    Rtt_Estimator fast(50, 1000);
+    fast.add_sample(100);
+    QCOMPARE(fast.timeout_ms(), 50);
+
+    Rtt_Estimator slow(0, 100);
+    slow.add_sample(500000);
+    QCOMPARE(slow.timeout_ms(), 100);
+
+    // Maximum below minimum is raised to it
+    Rtt_Estimator fixed(200, 100);
+    QCOMPARE(fixed.timeout_ms(), 200);
+}
+
+void Tst_Rtt_Estimator::backoff()
+{
+    Rtt_Estimator estimator(0, 1000);
+    estimator.add_sample(10000);
+    estimator.backoff();
+    QCOMPARE(estimator.timeout_ms(), 60);
+    estimator.backoff();
+    QCOMPARE(estimator.timeout_ms(), 120);
+    for (int i = 0; i < 40; ++i)
+        estimator.backoff();
+    QCOMPARE(estimator.timeout_ms(), 1000);
+
+    // An answer ends the back-off
+    estimator.add_sample(10000);
+    QVERIFY(estimator.timeout_ms() < 60);
+}
+
+QTEST_APPLESS_MAIN(Tst_Rtt_Estimator)
+
+#include "tst_rtt_estimator.moc"
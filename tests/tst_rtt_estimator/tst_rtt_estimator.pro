@@ -0,0 +1,16 @@
+QT -= gui
+QT += testlib
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_rtt_estimator
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+        ../../rtt_estimator.cpp \
+        tst_rtt_estimator.cpp
+
+HEADERS += \
+    ../../rtt_estimator.h
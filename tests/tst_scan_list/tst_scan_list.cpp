@@ -0,0 +1,140 @@
+#include <QTemporaryFile>
+#include <QTest>
+
+#include "scan_list.h"
+
+using namespace Modbus_Cli;
+
+class Tst_Scan_List : public QObject
+{
+    Q_OBJECT
+private slots:
+    void adjacent();
+    void gap_tolerance();
+    void block_limit();
+    void oversized();
+    void overlap();
+    void bits();
+    void separate();
+    void bad_entry();
+};
+
+namespace {
+
+bool load(Scan_List& list, const QByteArray& text)
+{
+    QTemporaryFile file;
+    if (!file.open() || file.write(text) != text.size())
+        return false;
+    file.close();
+    return list.load(file.fileName());
+}
+
+QVector<Scan_Block> plan(const QByteArray& text, int gap_tolerance = 0)
+{
+    Scan_List list;
+    return load(list, text) ? list.plan(gap_tolerance) : QVector<Scan_Block>();
+}
+
+} // namespace
+
+void Tst_Scan_List::adjacent()
+{
+    const QVector<Scan_Block> blocks = plan("1 holding_register 10-19,0-9\n");
+    QCOMPARE(blocks.size(), 1);
+    QCOMPARE(blocks.at(0)._start, 0);
+    QCOMPARE(blocks.at(0)._count, 20);
+    QCOMPARE(blocks.at(0)._ranges.size(), 2);
+    QCOMPARE(blocks.at(0)._ranges.at(0)._start, 0);
+}
+
+void Tst_Scan_List::gap_tolerance()
+{
+    const QByteArray text = "1 holding_register 0-9,15-19\n";
+    QCOMPARE(plan(text, 4).size(), 2);
+
+    const QVector<Scan_Block> blocks = plan(text, 5);
+    QCOMPARE(blocks.size(), 1);
+    QCOMPARE(blocks.at(0)._count, 20);
+}
+
+void Tst_Scan_List::block_limit()
+{
+    // 125 registers fit into one request, 126 don't
+    QCOMPARE(plan("1 input_register 0-99,100-124\n").size(), 1);
+
+    const QVector<Scan_Block> blocks = plan("1 input_register 0-99,100-125\n");
+    QCOMPARE(blocks.size(), 2);
+    QCOMPARE(blocks.at(0)._count, 100);
+    QCOMPARE(blocks.at(1)._start, 100);
+    QCOMPARE(blocks.at(1)._count, 26);
+}
+
+void Tst_Scan_List::oversized()
+{
+    const QVector<Scan_Block> blocks = plan("1 holding_register 0-299\n");
+    QCOMPARE(blocks.size(), 3);
+    QCOMPARE(blocks.at(0)._count, 125);
+    QCOMPARE(blocks.at(1)._start, 125);
+    QCOMPARE(blocks.at(2)._start, 250);
+    QCOMPARE(blocks.at(2)._count, 50);
+    for (const Scan_Block& block: blocks)
+    {
+        QCOMPARE(block._ranges.size(), 1);
+        QCOMPARE(block._ranges.at(0)._start, block._start);
+        QCOMPARE(block._ranges.at(0)._count, block._count);
+    }
+}
+
+void Tst_Scan_List::overlap()
+{
+    // Head of the second range is read by the first block, the rest starts a new one
+    const QVector<Scan_Block> blocks = plan("1 holding_register 0-99,50-199\n");
+    QCOMPARE(blocks.size(), 2);
+    QCOMPARE(blocks.at(0)._count, 100);
+    QCOMPARE(blocks.at(0)._ranges.size(), 2);
+    QCOMPARE(blocks.at(0)._ranges.at(1)._start, 50);
+    QCOMPARE(blocks.at(0)._ranges.at(1)._count, 50);
+    QCOMPARE(blocks.at(1)._start, 100);
+    QCOMPARE(blocks.at(1)._count, 100);
+}
+
+void Tst_Scan_List::bits()
+{
+    QCOMPARE(plan("1 coils 0-1998,1999\n").size(), 1);
+
+    const QVector<Scan_Block> blocks = plan("1 coils 0-1999,2000\n");
+    QCOMPARE(blocks.size(), 2);
+    QCOMPARE(blocks.at(0)._count, 2000);
+    QCOMPARE(blocks.at(1)._start, 2000);
+    QCOMPARE(blocks.at(1)._count, 1);
+}
+
+void Tst_Scan_List::separate()
+{
+    // Device, type, period, priority and trigger each keep ranges apart
+    const QVector<Scan_Block> blocks = plan("1 holding_register 0-9\n"
+                                            "2 holding_register 10-19\n"
+                                            "1 input_register 10-19\n"
+                                            "1 holding_register 10-19 500\n"
+                                            "1 holding_register 20-29 1000 1\n"
+                                            "1 holding_register 30-39 when holding_register:0 changed\n", 100);
+    QCOMPARE(blocks.size(), 6);
+    for (const Scan_Block& block: blocks)
+        QCOMPARE(block._ranges.size(), 1);
+}
+
+void Tst_Scan_List::bad_entry()
+{
+    Scan_List list;
+    QVERIFY(!load(list, "1 holding_register 10-5\n"));
+    QVERIFY(!load(list, "1 holding_register 0-65536\n"));
+    QVERIFY(!load(list, "# nothing\n"));
+    QVERIFY(!load(list, "1 holding_register 0-9 when input_register:0 changed\n"));
+    QVERIFY(load(list, "1 holding_register 0-9\n1 holding_register 20-29 when holding_register:5 > 0x10\n"));
+    QCOMPARE(list.ranges().size(), 2);
+}
+
+QTEST_APPLESS_MAIN(Tst_Scan_List)
+
+#include "tst_scan_list.moc"
@@ -0,0 +1,18 @@
+QT -= gui
+QT += serialbus testlib
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_scan_list
+
+INCLUDEPATH += ../..
+
+SOURCES += \
+        ../../protocol.cpp \
+        ../../scan_list.cpp \
+        tst_scan_list.cpp
+
+HEADERS += \
+    ../../protocol.h \
+    ../../scan_list.h
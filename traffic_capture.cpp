@@ -0,0 +1,149 @@
+#include <cerrno>
+#include <cstring>
+
+#include <QDebug>
+#include <QFile>
+
+#include "traffic_capture.h"
+
+namespace Modbus_Cli {
+
+static_assert(sizeof(Traffic_Capture::File_Header) == 32, "Capture header layout is documented");
+static_assert(sizeof(Traffic_Capture::Record_Header) == 24, "Capture record layout is documented");
+
+namespace {
+
+const char capture_magic[8] = "MBCAP";
+const quint32 capture_version = 1;
+
+} // namespace
+
+/*static*/ Traffic_Capture *Traffic_Capture::open(const QString &file_name)
+{
+    std::FILE* file = std::fopen(QFile::encodeName(file_name).constData(), "wb");
+    if (!file)
+    {
+        qCritical().noquote() << "Can't open capture file" << file_name << std::strerror(errno);
+        return nullptr;
+    }
+    return new Traffic_Capture{file};
+}
+
+Traffic_Capture::Traffic_Capture(std::FILE *file) :
+    _file(file),
+    _start(std::chrono::steady_clock::now()),
+    _endpoint_count(0)
+{
+    _buffer.reserve(flush_size * 2);
+
+    File_Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header._magic, capture_magic, sizeof(header._magic));
+    header._version = capture_version;
+    header._header_size = sizeof(File_Header);
+    header._start_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    _buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+Traffic_Capture::~Traffic_Capture()
+{
+    flush();
+    std::fclose(_file);
+}
+
+int Traffic_Capture::add_endpoint(const QString &conn_string)
+{
+    const QByteArray name = conn_string.toUtf8();
+
+    Record_Header header;
+    std::memset(&header, 0, sizeof(header));
+    header._kind = ENDPOINT;
+    header._size = static_cast<quint32>(name.size());
+
+    // Index and record are taken together, so the index matches the record order
+    std::lock_guard<std::mutex> lock(_mutex);
+    header._time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+    header._endpoint = static_cast<quint16>(_endpoint_count);
+    _buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    _buffer.append(name.constData(), name.size());
+    _buffer.append((alignment - name.size() % alignment) % alignment, '\0');
+    return _endpoint_count++;
+}
+
+void Traffic_Capture::add(int endpoint, Kind kind, quint32 transaction, int unit, const char *payload, int size)
+{
+    Record_Header header;
+    std::memset(&header, 0, sizeof(header));
+    header._time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+    header._size = static_cast<quint32>(size);
+    header._transaction = transaction;
+    header._endpoint = static_cast<quint16>(endpoint);
+    header._kind = kind;
+    header._unit = static_cast<quint8>(unit);
+    append(header, payload);
+}
+
+void Traffic_Capture::flush()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    flush_locked();
+}
+
+/*static*/ bool Traffic_Capture::read(const QString &file_name, const std::function<void(const Record_Header&, const char*)> &handler)
+{
+    QFile file{file_name};
+    if (!file.open(QIODevice::ReadOnly))
+    {
+        qCritical().noquote() << "Can't open capture file" << file_name << file.errorString();
+        return false;
+    }
+
+    const qint64 size = file.size();
+    const uchar* data = size >= static_cast<qint64>(sizeof(File_Header)) ? file.map(0, size) : nullptr;
+    const File_Header* header = reinterpret_cast<const File_Header*>(data);
+    if (!header || std::memcmp(header->_magic, capture_magic, sizeof(header->_magic)) != 0
+        || header->_version != capture_version || header->_header_size < sizeof(File_Header) || header->_header_size > size)
+    {
+        qCritical().noquote() << "Not a capture file:" << file_name;
+        return false;
+    }
+
+    qint64 pos = header->_header_size;
+    while (pos + static_cast<qint64>(sizeof(Record_Header)) <= size)
+    {
+        const Record_Header* record = reinterpret_cast<const Record_Header*>(data + pos);
+        const qint64 payload_pos = pos + sizeof(Record_Header);
+        if (payload_pos + record->_size > size)
+            break;
+
+        handler(*record, reinterpret_cast<const char*>(data + payload_pos));
+        pos = payload_pos + (record->_size + alignment - 1) / alignment * alignment;
+    }
+    return true;
+}
+
+void Traffic_Capture::append(const Record_Header &header, const char *payload)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (header._size)
+    {
+        _buffer.append(payload, header._size);
+        _buffer.append((alignment - header._size % alignment) % alignment, '\0');
+    }
+    if (_buffer.size() >= flush_size)
+        flush_locked();
+}
+
+void Traffic_Capture::flush_locked()
+{
+    if (_buffer.empty())
+        return;
+
+    std::fwrite(_buffer.data(), 1, _buffer.size(), _file);
+    std::fflush(_file);
+    _buffer.clear();
+}
+
+} // namespace Modbus_Cli
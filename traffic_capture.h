@@ -0,0 +1,91 @@
+#ifndef MODBUS_CLI_TRAFFIC_CAPTURE_H
+#define MODBUS_CLI_TRAFFIC_CAPTURE_H
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+
+#include <QString>
+
+namespace Modbus_Cli {
+
+/*
+ * Append-only binary log of every request and its outcome, for replay (see Traffic_Replay and modbus_sim --replay).
+ * All numbers are little-endian (host order):
+ *
+ *   File_Header                                at 0, 32 bytes
+ *   Record_Header, payload, zero padding       repeated, every record starts at a multiple of 8
+ *
+ * A connection is announced once by an ENDPOINT record with the connection string as payload,
+ * its index is the number of ENDPOINT records before it. A REQUEST record holds the request PDU,
+ * the RESPONSE record with the same endpoint and transaction holds the response PDU, also for
+ * exceptions; TIMEOUT and ERROR records have no payload. Every attempt is a transaction of its own.
+ * Safe to use from many threads, records of one thread keep their order.
+ */
+class Traffic_Capture
+{
+public:
+    enum Kind : quint8
+    {
+        ENDPOINT,
+        REQUEST,
+        RESPONSE,
+        TIMEOUT,
+        ERROR
+    };
+
+    struct File_Header
+    {
+        char _magic[8];             ///< "MBCAP" and zeros
+        quint32 _version;           ///< 1
+        quint32 _header_size;       ///< sizeof(File_Header)
+        qint64 _start_us;           ///< Unix epoch of time 0 of the records
+        char _reserved[8];
+    };
+
+    struct Record_Header
+    {
+        quint64 _time_ns;           ///< Monotonic, since _start_us
+        quint32 _size;              ///< Payload bytes, without padding
+        quint32 _transaction;       ///< Unique per endpoint
+        quint16 _endpoint;
+        quint8 _kind;
+        quint8 _unit;               ///< Slave address
+        char _reserved[4];
+    };
+
+    static const int alignment = 8;
+
+    /// Creates or truncates the file, null on failure
+    static Traffic_Capture* open(const QString& file_name);
+    ~Traffic_Capture();
+
+    /// Index for records of the connection, writes its ENDPOINT record
+    int add_endpoint(const QString& conn_string);
+    void add(int endpoint, Kind kind, quint32 transaction, int unit, const char* payload = nullptr, int size = 0);
+    void flush();
+
+    /// Calls handler for every record of a capture file read through a memory map.
+    /// Returns false if the file can't be read or isn't a capture, a truncated last record is ignored.
+    static bool read(const QString& file_name, const std::function<void(const Record_Header&, const char*)>& handler);
+private:
+    explicit Traffic_Capture(std::FILE* file);
+
+    void append(const Record_Header& header, const char* payload);
+    void flush_locked();
+
+    static const std::size_t flush_size = 64 * 1024;
+
+    std::FILE* _file;
+    std::chrono::steady_clock::time_point _start;
+
+    std::mutex _mutex;
+    std::string _buffer;
+    int _endpoint_count;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_TRAFFIC_CAPTURE_H
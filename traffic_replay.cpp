@@ -0,0 +1,177 @@
+#include <algorithm>
+
+#include <QDebug>
+
+#include "traffic_capture.h"
+#include "traffic_replay.h"
+
+namespace Modbus_Cli {
+
+namespace {
+
+/// Every captured attempt is replayed once, retries included
+Job replay_job(Job job)
+{
+    job._number_of_retries = 0;
+    return job;
+}
+
+} // namespace
+
+Traffic_Replay::Traffic_Replay(const QString &conn_string, const Job &job, const QString &file_name, double speed,
+                               QObject *parent) :
+    QObject(parent),
+    _job(job),
+    _file_name(file_name),
+    _speed(speed),
+    _client(make_client(conn_string, replay_job(job))),
+    _next(0),
+    _finished_count(0),
+    _started(false),
+    _finished(false),
+    _answered(0),
+    _timeouts(0),
+    _errors(0),
+    _different(0)
+{
+    _client->set_print_values(false);
+
+    connect(_client.get(), &Client::connected, this, &Traffic_Replay::on_connected);
+    connect(_client.get(), &Client::data_received, this, &Traffic_Replay::data_received);
+    connect(_client.get(), &Client::request_failed, this, &Traffic_Replay::request_failed);
+    connect(_client.get(), &Client::finished, this, &Traffic_Replay::request_finished);
+
+    connect(&_timer, &QTimer::timeout, this, &Traffic_Replay::send_due);
+    _timer.setSingleShot(true);
+    _timer.setTimerType(Qt::PreciseTimer);
+}
+
+bool Traffic_Replay::start()
+{
+    if (!load())
+        return false;
+    if (_items.isEmpty())
+    {
+        qCritical().noquote() << "No requests in" << _file_name;
+        return false;
+    }
+
+    if (!_client->connect_device())
+        finish();
+    return true;
+}
+
+void Traffic_Replay::on_connected()
+{
+    if (_started)
+        return;
+    _started = true;
+    _clock.start();
+    send_due();
+}
+
+bool Traffic_Replay::load()
+{
+    QHash<quint64, int> sent;   // By endpoint and transaction
+    const bool ok = Traffic_Capture::read(_file_name, [this, &sent](const Traffic_Capture::Record_Header& header, const char* payload)
+    {
+        const quint64 id = (static_cast<quint64>(header._endpoint) << 32) | header._transaction;
+        if (header._kind == Traffic_Capture::REQUEST && header._size > 0)
+        {
+            const Request request = Request::raw(header._unit, static_cast<QModbusPdu::FunctionCode>(static_cast<quint8>(payload[0])),
+                                                 QByteArray(payload + 1, static_cast<int>(header._size) - 1));
+            sent.insert(id, _items.size());
+            _items.push_back(Item{header._time_ns, request, QByteArray()});
+        }
+        else if (header._kind == Traffic_Capture::RESPONSE && sent.contains(id))
+            _items[sent.take(id)]._expected = QByteArray(payload, static_cast<int>(header._size));
+    });
+    if (!ok)
+        return false;
+
+    // Threads of the capturing process append in their own order
+    std::stable_sort(_items.begin(), _items.end(), [](const Item& a, const Item& b) { return a._time_ns < b._time_ns; });
+    if (!_items.isEmpty())
+    {
+        const quint64 first = _items.front()._time_ns;
+        for (int i = 0; i < _items.size(); ++i)
+        {
+            _items[i]._time_ns -= first;
+            _items[i]._request._id = i;
+        }
+    }
+    return true;
+}
+
+void Traffic_Replay::send_due()
+{
+    const qint64 now_ns = _clock.nsecsElapsed();
+    while (_next < _items.size() && _items.at(_next)._time_ns / _speed <= now_ns)
+        _client->send(_items.at(_next++)._request);
+
+    if (_next < _items.size())
+        _timer.start(static_cast<int>((_items.at(_next)._time_ns / _speed - now_ns) / 1e6) + 1);
+}
+
+void Traffic_Replay::data_received(const Request &request, const QModbusDataUnit &, const QModbusResponse &response)
+{
+    ++_answered;
+
+    QByteArray pdu(1, static_cast<char>(response.functionCode()));
+    pdu.append(response.data());
+    compare(request._id, pdu);
+}
+
+void Traffic_Replay::request_failed(const Request &request, QModbusDevice::Error error, int exception_code)
+{
+    if (error == QModbusDevice::ProtocolError)
+    {
+        ++_answered;
+        QByteArray pdu(1, static_cast<char>(request._func | 0x80));
+        pdu.append(static_cast<char>(exception_code));
+        compare(request._id, pdu);
+    }
+    else if (error == QModbusDevice::TimeoutError)
+        ++_timeouts;
+    else
+        ++_errors;
+}
+
+void Traffic_Replay::request_finished()
+{
+    if (_finished)
+        return;
+
+    ++_finished_count;
+    if (!_client->is_connected() && _client->pending_count() == 0)
+    {
+        qCritical().noquote() << "Connection lost," << _items.size() - _next << "requests not sent";
+        finish();
+    }
+    else if (_finished_count == _items.size())
+        finish();
+}
+
+void Traffic_Replay::compare(int id, const QByteArray &pdu)
+{
+    if (id >= 0 && id < _items.size() && !_items.at(id)._expected.isEmpty() && _items.at(id)._expected != pdu)
+        ++_different;
+}
+
+void Traffic_Replay::finish()
+{
+    if (_finished)
+        return;
+    _finished = true;
+    _timer.stop();
+
+    const double captured_s = _items.isEmpty() ? 0. : _items.back()._time_ns / 1e9;
+    qInfo().noquote() << QString("Replayed %1 of %2 requests in %3 s, captured in %4 s: %5 answered, %6 timeouts, %7 errors, "
+                                 "%8 answers differ from capture")
+                         .arg(_next).arg(_items.size())
+                         .arg(_clock.isValid() ? _clock.elapsed() / 1e3 : 0., 0, 'f', 3).arg(captured_s, 0, 'f', 3)
+                         .arg(_answered).arg(_timeouts).arg(_errors).arg(_different);
+    emit done();
+}
+
+} // namespace Modbus_Cli
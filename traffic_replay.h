@@ -0,0 +1,68 @@
+#ifndef MODBUS_CLI_TRAFFIC_REPLAY_H
+#define MODBUS_CLI_TRAFFIC_REPLAY_H
+
+#include <memory>
+
+#include <QElapsedTimer>
+#include <QTimer>
+
+#include "session.h"
+
+namespace Modbus_Cli {
+
+/*
+ * Sends the requests of a capture (see Traffic_Capture) to one connection at their captured times
+ * divided by speed, every attempt once, requests of all captured endpoints merged.
+ * Answers are compared with the captured ones. Run it against modbus_sim --replay to reproduce the captured timing.
+ */
+class Traffic_Replay : public QObject
+{
+    Q_OBJECT
+public:
+    Traffic_Replay(const QString& conn_string, const Job& job, const QString& file_name, double speed,
+                   QObject* parent = nullptr);
+
+    bool start();
+signals:
+    void done();
+private slots:
+    void on_connected();
+    void send_due();
+    void data_received(const Request& request, const QModbusDataUnit& unit, const QModbusResponse& response);
+    void request_failed(const Request& request, QModbusDevice::Error error, int exception_code);
+    void request_finished();
+private:
+    struct Item
+    {
+        quint64 _time_ns;           ///< Since the first request
+        Request _request;
+        QByteArray _expected;       ///< Captured response PDU, empty if there was none
+    };
+
+    bool load();
+    void compare(int id, const QByteArray& pdu);
+    void finish();
+
+    Job _job;
+    QString _file_name;
+    double _speed;
+    std::unique_ptr<Client> _client;
+
+    QVector<Item> _items;
+    int _next;
+    int _finished_count;
+    bool _started;
+    bool _finished;
+
+    int _answered;
+    int _timeouts;
+    int _errors;
+    int _different;
+
+    QElapsedTimer _clock;
+    QTimer _timer;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_TRAFFIC_REPLAY_H
@@ -0,0 +1,63 @@
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <QDebug>
+
+#include "unix_signal.h"
+
+namespace Modbus_Cli {
+
+namespace {
+int signal_fd[NSIG];
+} // namespace
+
+Unix_Signal::Unix_Signal(int signal_number, QObject *parent) :
+    QObject(parent),
+    _signal_number(signal_number),
+    _fd{-1, -1},
+    _notifier(nullptr)
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, _fd))
+    {
+        qCritical() << "Couldn't create socket pair for signal" << signal_number;
+        return;
+    }
+
+    signal_fd[signal_number] = _fd[0];
+    _notifier = new QSocketNotifier(_fd[1], QSocketNotifier::Read, this);
+    connect(_notifier, &QSocketNotifier::activated, this, &Unix_Signal::read_socket);
+
+    struct sigaction action = {};
+    action.sa_handler = &Unix_Signal::handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(signal_number, &action, nullptr);
+}
+
+Unix_Signal::~Unix_Signal()
+{
+    if (_fd[0] != -1)
+    {
+        signal(_signal_number, SIG_DFL);
+        signal_fd[_signal_number] = 0;
+        ::close(_fd[0]);
+        ::close(_fd[1]);
+    }
+}
+
+void Unix_Signal::read_socket()
+{
+    char tmp;
+    if (::read(_fd[1], &tmp, sizeof(tmp)) > 0)
+        emit activated();
+}
+
+/*static*/ void Unix_Signal::handler(int signal_number)
+{
+    char tmp = 1;
+    if (signal_fd[signal_number] > 0)
+        (void)!::write(signal_fd[signal_number], &tmp, sizeof(tmp));
+}
+
+} // namespace Modbus_Cli
@@ -0,0 +1,29 @@
+#ifndef MODBUS_CLI_UNIX_SIGNAL_H
+#define MODBUS_CLI_UNIX_SIGNAL_H
+
+#include <QSocketNotifier>
+
+namespace Modbus_Cli {
+
+/// Delivers a unix signal to the event loop. Signal handler only writes to a socket pair.
+class Unix_Signal : public QObject
+{
+    Q_OBJECT
+public:
+    Unix_Signal(int signal_number, QObject* parent = nullptr);
+    ~Unix_Signal();
+signals:
+    void activated();
+private slots:
+    void read_socket();
+private:
+    static void handler(int signal_number);
+
+    int _signal_number;
+    int _fd[2];
+    QSocketNotifier* _notifier;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_UNIX_SIGNAL_H
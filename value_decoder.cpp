@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <QFile>
+#include <QTextStream>
+#include <QDebug>
+
+#include "protocol.h"
+#include "value_decoder.h"
+
+namespace Modbus_Cli {
+
+namespace {
+
+const int max_string_size = 125;
+
+/// Swaps bytes of every register, 8 registers per instruction where possible
+void swap_bytes(const quint16* in, quint16* out, int count)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= count; i += 8)
+        vst1q_u16(out + i, vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(vld1q_u16(in + i)))));
+#endif
+    for (; i < count; ++i)
+        out[i] = static_cast<quint16>(in[i] << 8 | in[i] >> 8);
+}
+
+template<int Words, bool Word_Swap>
+inline quint64 gather(const quint16* registers)
+{
+    quint64 value = 0;
+    for (int i = 0; i < Words; ++i)
+        value = value << 16 | registers[Word_Swap ? Words - 1 - i : i];
+    return value;
+}
+
+template<bool Word_Swap> double to_u16(const quint16* r) { return r[0]; }
+template<bool Word_Swap> double to_i16(const quint16* r) { return static_cast<qint16>(r[0]); }
+template<bool Word_Swap> double to_u32(const quint16* r) { return static_cast<quint32>(gather<2, Word_Swap>(r)); }
+template<bool Word_Swap> double to_i32(const quint16* r) { return static_cast<qint32>(gather<2, Word_Swap>(r)); }
+template<bool Word_Swap> double to_u64(const quint16* r) { return static_cast<double>(gather<4, Word_Swap>(r)); }
+template<bool Word_Swap> double to_i64(const quint16* r) { return static_cast<double>(static_cast<qint64>(gather<4, Word_Swap>(r))); }
+
+template<bool Word_Swap> double to_f32(const quint16* r)
+{
+    const quint32 bits = static_cast<quint32>(gather<2, Word_Swap>(r));
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+template<bool Word_Swap> double to_f64(const quint16* r)
+{
+    const quint64 bits = gather<4, Word_Swap>(r);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+Value_Decoder::Converter converter(Value_Decoder::Value_Type type, bool word_swap)
+{
+    static const Value_Decoder::Converter table[][2] = {
+        { &to_u16<false>, &to_u16<true> },
+        { &to_i16<false>, &to_i16<true> },
+        { &to_u32<false>, &to_u32<true> },
+        { &to_i32<false>, &to_i32<true> },
+        { &to_f32<false>, &to_f32<true> },
+        { &to_u64<false>, &to_u64<true> },
+        { &to_i64<false>, &to_i64<true> },
+        { &to_f64<false>, &to_f64<true> }
+    };
+    return type == Value_Decoder::STRING ? nullptr : table[type][word_swap];
+}
+
+int format_string(const quint16* registers, int size, char* text)
+{
+    int length = 0;
+    for (int i = 0; i < size; ++i)
+    {
+        text[length++] = static_cast<char>(registers[i] >> 8);
+        text[length++] = static_cast<char>(registers[i] & 0xFF);
+    }
+
+    const char* end = static_cast<const char*>(std::memchr(text, 0, static_cast<std::size_t>(length)));
+    if (end)
+        length = static_cast<int>(end - text);
+    while (length > 0 && text[length - 1] == ' ')
+        --length;
+    for (int i = 0; i < length; ++i)
+        if (static_cast<unsigned char>(text[i]) < 0x20)
+            text[i] = '?';
+    return length;
+}
+
+bool parse_value_type(const QString& text, Value_Decoder::Value_Type& type, int& size)
+{
+    static const char* const names[] = { "u16", "i16", "u32", "i32", "f32", "u64", "i64", "f64" };
+    static const int sizes[] = { 1, 1, 2, 2, 2, 4, 4, 4 };
+
+    const QString name = text.toLower();
+    for (int i = 0; i < 8; ++i)
+        if (name == names[i])
+        {
+            type = static_cast<Value_Decoder::Value_Type>(i);
+            size = sizes[i];
+            return true;
+        }
+
+    bool ok = name.startsWith("str");
+    size = ok ? name.mid(3).toInt(&ok) : 0;
+    type = Value_Decoder::STRING;
+    return ok && size > 0 && size <= max_string_size;
+}
+
+} // namespace
+
+bool Value_Decoder::load(const QString &file_name)
+{
+    QFile file(file_name);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        qCritical().noquote() << "Can't open value map" << file_name << file.errorString();
+        return false;
+    }
+
+    _tables.clear();
+
+    QTextStream stream(&file);
+    for (int line_number = 1; !stream.atEnd(); ++line_number)
+        if (!parse_line(stream.readLine(), line_number))
+            return false;
+
+    for (auto it = _tables.begin(); it != _tables.end(); ++it)
+    {
+        Table& table = it.value();
+        std::sort(table._fields.begin(), table._fields.end(), [](const Value_Field& a, const Value_Field& b)
+        {
+            return a._address < b._address;
+        });
+        table._max_size = 1;
+        table._byte_swap = false;
+        for (const Value_Field& field: table._fields)
+        {
+            table._max_size = std::max(table._max_size, field._size);
+            table._byte_swap = table._byte_swap || field._order == BADC || field._order == DCBA;
+        }
+    }
+    return true;
+}
+
+bool Value_Decoder::empty() const
+{
+    return _tables.isEmpty();
+}
+
+bool Value_Decoder::parse_line(const QString &line, int line_number)
+{
+    const QString text = line.left(line.indexOf('#')).simplified();
+    if (text.isEmpty())
+        return true;
+
+    const QStringList fields = text.split(' ');
+    bool ok = fields.size() >= 4 && fields.size() <= 8;
+
+    int server_address = 0;
+    QModbusDataUnit::RegisterType type = QModbusDataUnit::Invalid;
+    Value_Field field{0, 1, UINT16, ABCD, 1, 0, QString(), nullptr};
+    if (ok)
+        server_address = fields.at(0).toInt(&ok);
+    if (ok)
+    {
+        type = register_type_from_string(fields.at(1));
+        ok = type > QModbusDataUnit::Invalid && type <= QModbusDataUnit::HoldingRegisters;
+    }
+    if (ok)
+        field._address = fields.at(2).toInt(&ok);
+    if (ok)
+        ok = parse_value_type(fields.at(3), field._type, field._size) && field._address >= 0
+                && field._address + field._size <= 0x10000;
+    if (ok && fields.size() >= 5)
+    {
+        static const char* const orders[] = { "abcd", "cdab", "badc", "dcba" };
+        const QString order = fields.at(4).toLower();
+        ok = false;
+        for (int i = 0; i < 4; ++i)
+            if (order == orders[i])
+            {
+                field._order = static_cast<Word_Order>(i);
+                ok = true;
+            }
+    }
+    if (ok && fields.size() >= 6)
+        field._scale = fields.at(5).toDouble(&ok);
+    if (ok && fields.size() >= 7)
+        field._offset = fields.at(6).toDouble(&ok);
+    if (fields.size() == 8)
+        field._name = fields.at(7);
+
+    if (!ok)
+    {
+        qCritical().noquote() << QString("Value map line %1: bad entry \"%2\"").arg(line_number).arg(text);
+        return false;
+    }
+
+    field._convert = converter(field._type, field._order == CDAB || field._order == DCBA);
+    _tables[key(server_address, type)]._fields.push_back(field);
+    return true;
+}
+
+void Value_Decoder::decode(int server_address, QModbusDataUnit::RegisterType type, int start, const quint16 *values, int count,
+                           int run_start, int run_count, const Emit &output) const
+{
+    const auto it = _tables.constFind(key(server_address, type));
+    if (it == _tables.constEnd())
+        return;
+
+    const Table& table = it.value();
+    const int end = start + count;
+    const int run_end = run_start + run_count;
+
+    // Whole block at once, fields then read swapped registers like the others
+    thread_local std::vector<quint16> swapped;
+    if (table._byte_swap)
+    {
+        swapped.resize(static_cast<std::size_t>(count));
+        swap_bytes(values, swapped.data(), count);
+    }
+
+    char text[2 * max_string_size + 1];
+    const int from = std::max(start, run_start - table._max_size + 1);
+    auto field = std::lower_bound(table._fields.constBegin(), table._fields.constEnd(), from,
+                                  [](const Value_Field& f, int address) { return f._address < address; });
+    for (; field != table._fields.constEnd() && field->_address < run_end; ++field)
+    {
+        const int field_end = field->_address + field->_size;
+        if (field_end > end || field_end <= run_start)
+            continue;
+
+        const bool byte_swap = field->_order == BADC || field->_order == DCBA;
+        const quint16* registers = (byte_swap ? swapped.data() : values) + (field->_address - start);
+        int size;
+        if (field->_type == STRING)
+            size = format_string(registers, field->_size, text);
+        else if ((field->_type == UINT64 || field->_type == INT64) && field->_scale == 1. && field->_offset == 0.)
+        {
+            // Counters above 2^53 don't survive a double
+            const bool word_swap = field->_order == CDAB || field->_order == DCBA;
+            const quint64 value = word_swap ? gather<4, true>(registers) : gather<4, false>(registers);
+            size = field->_type == UINT64 ? std::snprintf(text, sizeof(text), "%" PRIu64, static_cast<uint64_t>(value))
+                                          : std::snprintf(text, sizeof(text), "%" PRId64, static_cast<int64_t>(value));
+        }
+        else
+        {
+            const double value = field->_convert(registers) * field->_scale + field->_offset;
+            size = std::snprintf(text, sizeof(text), field->_type == FLOAT32 ? "%.9g" : "%.17g", value);
+        }
+        output(*field, text, size);
+    }
+}
+
+/*static*/ int Value_Decoder::key(int server_address, QModbusDataUnit::RegisterType type)
+{
+    return server_address << 8 | type;
+}
+
+} // namespace Modbus_Cli
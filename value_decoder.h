@@ -0,0 +1,89 @@
+#ifndef MODBUS_CLI_VALUE_DECODER_H
+#define MODBUS_CLI_VALUE_DECODER_H
+
+#include <functional>
+
+#include <QHash>
+#include <QModbusDataUnit>
+#include <QVector>
+
+namespace Modbus_Cli {
+
+/*
+ * Typed values over registers, from a map file. One field per line, '#' starts a comment:
+ *   <address> <type> <register> <value_type> [order] [scale] [offset] [name]
+ * Value types: u16 i16 u32 i32 f32 u64 i64 f64 str<registers>, e.g. str8.
+ * Order of bytes A (most significant) to D: abcd (Modbus, default), cdab (words swapped),
+ * badc (bytes swapped in every register), dcba (both). 64-bit values follow the same rules,
+ * strings only swap bytes. Output value is raw * scale + offset, strings end at zero and are trimmed.
+ * 64-bit integers without scale and offset are output exactly, with them through double like the others.
+ * Example:
+ *   1 holding_register 0   f32  cdab 1    0    temperature
+ *   1 holding_register 2   u32  abcd 0.01 0    energy_kwh
+ *   1 input_register   10  str8 badc
+ */
+class Value_Decoder
+{
+public:
+    enum Value_Type
+    {
+        UINT16,
+        INT16,
+        UINT32,
+        INT32,
+        FLOAT32,
+        UINT64,
+        INT64,
+        FLOAT64,
+        STRING
+    };
+
+    enum Word_Order
+    {
+        ABCD,
+        CDAB,
+        BADC,
+        DCBA
+    };
+
+    using Converter = double (*)(const quint16* registers);
+
+    struct Value_Field
+    {
+        int _address;
+        int _size;              ///< Registers
+        Value_Type _type;
+        Word_Order _order;
+        double _scale;
+        double _offset;
+        QString _name;
+        Converter _convert;     ///< Specialized for type and word order, null for strings
+    };
+
+    /// Formatted value of a field, text isn't zero terminated
+    using Emit = std::function<void(const Value_Field& field, const char* text, int size)>;
+
+    bool load(const QString& file_name);
+    bool empty() const;
+
+    /// Emits fields which are whole in the block and have registers in the run.
+    /// A changed low word of a float outputs the float.
+    void decode(int server_address, QModbusDataUnit::RegisterType type, int start, const quint16* values, int count,
+                int run_start, int run_count, const Emit& output) const;
+private:
+    struct Table
+    {
+        QVector<Value_Field> _fields;   ///< By address
+        int _max_size;
+        bool _byte_swap;                ///< Some field has bytes swapped
+    };
+
+    bool parse_line(const QString& line, int line_number);
+    static int key(int server_address, QModbusDataUnit::RegisterType type);
+
+    QHash<int, Table> _tables;
+};
+
+} // namespace Modbus_Cli
+
+#endif // MODBUS_CLI_VALUE_DECODER_H
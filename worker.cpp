@@ -2,7 +2,13 @@
 #include <QDebug>
 #include <QLoggingCategory>
 #include <QCoreApplication>
+#include <QFile>
+#include <QTextStream>
 
+#include <signal.h>
+
+#include "protocol.h"
+#include "stats.h"
 #include "worker.h"
 
 namespace Modbus_Cli {
@@ -22,13 +28,50 @@ enum Option_Type {
 	OT_NUMBER_OF_RETRIES,
     OT_RAW,
     OT_FUNC,
-    OT_FUNC_HEX
+    OT_FUNC_HEX,
+    OT_SCAN,
+    OT_GAP,
+    OT_WINDOW,
+    OT_HOSTS,
+    OT_THREADS,
+    OT_PARALLEL,
+    OT_STATS,
+    OT_OUTPUT,
+    OT_OUTPUT_FILE,
+    OT_ON_CHANGE,
+    OT_DEADBAND,
+    OT_KEYFRAME,
+    OT_ADAPTIVE_TIMEOUT,
+    OT_MIN_TIMEOUT,
+    OT_BATCH,
+    OT_DAEMON,
+    OT_MAX_AGE,
+    OT_IMAGE,
+    OT_UPLOAD,
+    OT_COMPARE,
+    OT_VERIFY,
+    OT_DECODE,
+    OT_DISCOVER,
+    OT_PROBE_TIMEOUT,
+    OT_SERIAL,
+    OT_CONNECT_TIMEOUT,
+    OT_DISCOVER_MAP,
+    OT_METRICS,
+    OT_STATS_INTERVAL,
+    OT_PERIOD,
+    OT_RECONNECT,
+    OT_STANDBY,
+    OT_CAPTURE,
+    OT_REPLAY,
+    OT_SPEED,
+    OT_GATEWAY,
+    OT_MAX_QUEUE
 };
 
 Worker::Worker(QObject *parent) :
     QObject(parent),
     _opt({
-        { { "a", "address" }, QCoreApplication::translate("main", "Device address. Default: 1"), "adr", "1"},
+        { { "a", "address" }, QCoreApplication::translate("main", "Device addresses. Comma separated, ranges allowed, 0 is broadcast write. Example: 1,2,5-8. Default: 1"), "adr", "1"},
         { { "t", "type" }, QCoreApplication::translate("main", "Register type. Default: 4 holding_register"), "type", "4"},
         { { "r", "read" }, QCoreApplication::translate("main", "Read from device.")},
         { { "w", "write" }, QCoreApplication::translate("main", "Write to device. Values comma separated. Example: 1,2,3"), "values"},
@@ -42,7 +85,44 @@ Worker::Worker(QObject *parent) :
 		{ "retries", QCoreApplication::translate("main", "Number of retries. Default: 5"), "retries", "5"},
         { "raw", QCoreApplication::translate("main", "Write raw data (hex)"), "raw"},
         { "func", QCoreApplication::translate("main", "Function code for raw request"), "func"},
-        { "func_hex", QCoreApplication::translate("main", "Function code for raw request (hex)"), "func_hex"}
+        { "func_hex", QCoreApplication::translate("main", "Function code for raw request (hex)"), "func_hex"},
+        { "scan", QCoreApplication::translate("main", "Poll register map from scan list file. Use --repeat for cycles count"), "file"},
+        { "gap", QCoreApplication::translate("main", "Scan list gap tolerance. Unused values read to join ranges. Default: 0"), "gap", "0"},
+        { "window", QCoreApplication::translate("main", "Maximum requests in flight for Modbus TCP. Default: 1"), "window", "1"},
+        { "hosts", QCoreApplication::translate("main", "File with connection strings, one per line"), "file"},
+        { "threads", QCoreApplication::translate("main", "Worker threads for many devices. Default: 0 is CPU count"), "threads", "0"},
+        { "parallel", QCoreApplication::translate("main", "Maximum devices polled at once. Default: 256"), "parallel", "256"},
+        { "stats", QCoreApplication::translate("main", "Print request counters and latency percentiles at exit and on SIGUSR1")},
+        { "output", QCoreApplication::translate("main", "Values output format: text, csv, ndjson or binary. Default: text"), "format", "text"},
+        { "output_file", QCoreApplication::translate("main", "Write values to file instead of stdout. Not for text format"), "file"},
+        { "on_change", QCoreApplication::translate("main", "Output only values changed since last output")},
+        { "deadband", QCoreApplication::translate("main", "Minimal change to output with --on_change. Default: 0"), "deadband", "0"},
+        { "keyframe", QCoreApplication::translate("main", "Output all values once per period with --on_change, ms. Default: 0 is never"), "ms", "0"},
+        { "adaptive_timeout", QCoreApplication::translate("main", "Derive timeout of every device from its response time, --timeout is the maximum")},
+        { "min_timeout", QCoreApplication::translate("main", "Minimum timeout with --adaptive_timeout, ms. Default: 20"), "ms", "20"},
+        { "batch", QCoreApplication::translate("main", "Run commands from file over one connection, - is stdin. See README"), "file"},
+        { "daemon", QCoreApplication::translate("main", "Serve batch commands from local socket clients over one connection, with register cache"), "socket"},
+        { "max_age", QCoreApplication::translate("main", "Default age of cached values answered by --daemon and of read answers shared by --gateway, ms. Default: 0 is always read"), "ms", "0"},
+        { "image", QCoreApplication::translate("main", "Publish read values to memory-mapped file for local readers. See register_image.h"), "file"},
+        { "upload", QCoreApplication::translate("main", "Write values from file from --start on, text or .bin. Uses --window"), "file"},
+        { "compare", QCoreApplication::translate("main", "Read before --upload and write only chunks that differ")},
+        { "verify", QCoreApplication::translate("main", "Read back and compare after --upload")},
+        { "decode", QCoreApplication::translate("main", "Output typed values described in file instead of registers. See value_decoder.h"), "file"},
+        { "discover", QCoreApplication::translate("main", "Find answering devices: read one value from every --address. Default addresses: 1-247 RTU, 1,255 TCP")},
+        { "probe_timeout", QCoreApplication::translate("main", "Response timeout for --discover, ms. Default: 50"), "ms", "50"},
+        { "serial", QCoreApplication::translate("main", "Serial settings to try with --discover. Example: 9600:N,19200:E"), "settings"},
+        { "connect_timeout", QCoreApplication::translate("main", "Connection timeout in milliseconds. Default: 10000"), "ms", "10000"},
+        { "discover_map", QCoreApplication::translate("main", "Find valid addresses of a device, of --type or all types, and write them as scan list"), "file"},
+        { "metrics", QCoreApplication::translate("main", "Serve counters of every connection over HTTP at /metrics in Prometheus format"), "[host:]port"},
+        { "stats_interval", QCoreApplication::translate("main", "Print request counters and latency percentiles periodically, seconds. Default: 0 is never"), "s", "0"},
+        { "period", QCoreApplication::translate("main", "Read at fixed rate with --repeat instead of back to back, ms"), "ms"},
+        { "reconnect", QCoreApplication::translate("main", "Keep the connection: reconnect after 50 ms doubling up to this, resend unanswered requests. Default: 0 is off"), "ms", "0"},
+        { "standby", QCoreApplication::translate("main", "Connection to a redundant gateway kept open to take over at once. Needs --reconnect"), "conn"},
+        { "capture", QCoreApplication::translate("main", "Log every request and answer with timestamps to binary file. See traffic_capture.h"), "file"},
+        { "replay", QCoreApplication::translate("main", "Send requests of a --capture file at their captured times and compare answers"), "file"},
+        { "speed", QCoreApplication::translate("main", "Time factor for --replay, 2 is twice as fast. Default: 1"), "factor", "1"},
+        { "gateway", QCoreApplication::translate("main", "Serve Modbus TCP masters and forward their requests to the connection, e.g. rtu://"), "[host:]port"},
+        { "max_queue", QCoreApplication::translate("main", "Requests of one --gateway master waiting for the line, more get exception 0x06. Default: 32"), "n", "32"}
     })
 {
 }
@@ -53,66 +133,319 @@ bool Worker::process(const QStringList &args)
     _parser.addHelpOption();
     _parser.addOptions(_opt);
 
-    _parser.addPositionalArgument("conn", "Connection string. Example: rtu:///dev/ttyS0?baudRate=9600 mtcp://example.com:502");
+    _parser.addPositionalArgument("conn", "Connection strings. Example: rtu:///dev/ttyS0?baudRate=9600 mtcp://example.com:502", "[conn...]");
 
     _parser.process(args);
 
-    if (_parser.positionalArguments().empty())
+    if (!parse_addresses(option(OT_ADDRESS)))
     {
-		qCritical() << _parser.helpText().constData();
+        qCritical().noquote() << "Bad device address list:" << option(OT_ADDRESS);
         return false;
     }
-
-    _adr = option(OT_ADDRESS).toInt();
     _start = option(OT_START).toInt();
     _count = option(OT_COUNT).toInt();
     _debug = option(OT_DEBUG).toInt();
 	_quiet = option(OT_QUIET).toInt();
-    _repeat = option(OT_REPEAT).toInt();
-    int timeout = option(OT_TIMEOUT).toInt();
-	int number_of_retries = option(OT_NUMBER_OF_RETRIES).toInt();
 
-    _type = get_type(option(OT_REGISTER_TYPE));
+    _type = register_type_from_string(option(OT_REGISTER_TYPE));
     if (_type <= QModbusDataUnit::Invalid || _type > QModbusDataUnit::HoldingRegisters)
     {
         qCritical() << "Unknown register type: " << _type;
         return false;
     }
 
+    QStringList endpoints = _parser.positionalArguments();
+    if (is_set(OT_HOSTS) && !read_endpoints(option(OT_HOSTS), endpoints))
+        return false;
+
+    if (endpoints.empty())
+    {
+		qCritical() << _parser.helpText().constData();
+        return false;
+    }
+
+    const bool discover = is_set(OT_DISCOVER);
+    if (discover)
+    {
+        QStringList expanded;
+        if (!Bus_Prober::expand_endpoints(endpoints, option(OT_SERIAL), expanded))
+            return false;
+        endpoints = expanded;
+
+        if (!is_set(OT_ADDRESS))
+            parse_addresses(endpoints.front().startsWith("rtu", Qt::CaseInsensitive) ? "1-247" : "1,255");
+    }
+
+    Job job;
+    job._repeat = option(OT_REPEAT).toInt();
+    job._window = option(OT_WINDOW).toInt();
+    job._timeout = option(discover ? OT_PROBE_TIMEOUT : OT_TIMEOUT).toInt();
+    job._number_of_retries = discover ? 0 : option(OT_NUMBER_OF_RETRIES).toInt();
+    job._connect_timeout = option(OT_CONNECT_TIMEOUT).toInt();
+    job._reconnect_ms = discover ? 0 : option(OT_RECONNECT).toInt();
+    job._standby = option(OT_STANDBY);
+    if (!job._standby.isEmpty() && (job._reconnect_ms <= 0 || endpoints.size() != 1))
+    {
+        qCritical() << "--standby needs --reconnect and one connection";
+        return false;
+    }
+    job._min_timeout = is_set(OT_ADAPTIVE_TIMEOUT) ? option(OT_MIN_TIMEOUT).toInt() : -1;
+    job._quiet = _quiet || (discover && !_debug); // Silent addresses aren't errors
+    job._tagged = endpoints.size() > 1;
+    job._writer = nullptr;
+    job._image = nullptr;
+    job._decoder = nullptr;
+    job._capture = nullptr;
+    job._discover = discover;
+    job._on_change = is_set(OT_ON_CHANGE);
+    job._deadband = option(OT_DEADBAND).toInt();
+    job._keyframe_ms = option(OT_KEYFRAME).toInt();
+
+    Output_Writer::Format format;
+    if (!Output_Writer::parse_format(option(OT_OUTPUT), format))
+    {
+        qCritical().noquote() << "Unknown output format:" << option(OT_OUTPUT);
+        return false;
+    }
+    if (format != Output_Writer::TEXT)
+    {
+        _writer.reset(Output_Writer::open(format, option(OT_OUTPUT_FILE)));
+        if (!_writer)
+            return false;
+        job._writer = _writer.get();
+
+        Output_Writer* writer = _writer.get();
+        QObject::connect(&_flush_timer, &QTimer::timeout, [writer]() { writer->flush(); });
+        QObject::connect(qApp, &QCoreApplication::aboutToQuit, [writer]() { writer->flush(); });
+        _flush_timer.start(flush_interval_ms);
+    }
+
+    if (is_set(OT_DECODE))
+    {
+        _decoder.reset(new Value_Decoder);
+        if (!_decoder->load(option(OT_DECODE)))
+            return false;
+        job._decoder = _decoder.get();
+    }
+
+    if (is_set(OT_IMAGE))
+    {
+        _image.reset(Register_Image::open(option(OT_IMAGE)));
+        if (!_image)
+            return false;
+        job._image = _image.get();
+    }
+
+    if (is_set(OT_CAPTURE))
+    {
+        _capture.reset(Traffic_Capture::open(option(OT_CAPTURE)));
+        if (!_capture)
+            return false;
+        job._capture = _capture.get();
+
+        Traffic_Capture* capture = _capture.get();
+        QObject::connect(&_flush_timer, &QTimer::timeout, [capture]() { capture->flush(); });
+        QObject::connect(qApp, &QCoreApplication::aboutToQuit, [capture]() { capture->flush(); });
+        _flush_timer.start(flush_interval_ms);
+    }
+
+    if (is_set(OT_REPLAY))
+    {
+        if (endpoints.size() != 1 || option(OT_SPEED).toDouble() <= 0.)
+        {
+            qCritical() << "Replay works with one connection and a positive --speed";
+            return false;
+        }
+    }
+    else if (is_set(OT_BATCH) || is_set(OT_DAEMON) || is_set(OT_GATEWAY))
+    {
+        if (endpoints.size() != 1)
+        {
+            qCritical() << "Batch, daemon and gateway modes work over one connection";
+            return false;
+        }
+    }
+    else if (is_set(OT_DISCOVER_MAP))
+    {
+        if (endpoints.size() != 1 || _addresses.size() != 1 || _addresses.front() == 0)
+        {
+            qCritical() << "Map discovery works with one connection and one device address";
+            return false;
+        }
+    }
+    else if (is_set(OT_UPLOAD))
+    {
+        if (endpoints.size() != 1 || _addresses.size() != 1)
+        {
+            qCritical() << "Upload works with one connection and one device address";
+            return false;
+        }
+        if (_type != QModbusDataUnit::Coils && _type != QModbusDataUnit::HoldingRegisters)
+        {
+            qCritical() << "Upload writes coils or holding registers only";
+            return false;
+        }
+        if (_addresses.front() == 0 && (is_set(OT_COMPARE) || is_set(OT_VERIFY)))
+        {
+            qCritical() << "Broadcast address 0 can't be read for --compare or --verify";
+            return false;
+        }
+    }
+    else if (discover)
+    {
+        _addresses.removeAll(0);
+        job._request = Request::read(1, _type, _start, 1);
+    }
+    else if (is_set(OT_SCAN))
+    {
+        Scan_List scan_list;
+        if (!scan_list.load(option(OT_SCAN)))
+            return false;
+
+        job._blocks = scan_list.plan(option(OT_GAP).toInt());
+        if (_debug)
+            for (const Scan_Block& block: job._blocks)
+                qDebug().noquote() << "Scan block:" << block._server_address << register_type_to_string(block._type)
+                                   << block._start << block._count << "period" << block._period;
+    }
+    else if (is_set(OT_PERIOD))
+    {
+        const int period = option(OT_PERIOD).toInt();
+        if (!is_set(OT_READ) || period <= 0 || _addresses.contains(0))
+        {
+            qCritical() << "--period needs --read, a positive period and no broadcast address";
+            return false;
+        }
+
+        // Every address is a scan block of its own, so a silent slave doesn't delay the others
+        for (int address: _addresses)
+        {
+            const Scan_Range range{address, _type, _start, _count, period, 0, -1, Scan_Trigger{}};
+            job._blocks.push_back(Scan_Block{address, _type, _start, _count, period, 0, {range}});
+        }
+    }
+    else if (!make_request(job._request))
+    {
+		qCritical() << _parser.helpText().constData();
+        return false;
+    }
+    else if (_addresses.contains(0) && (job._request._kind == Request::READ || job._request._kind == Request::READ_WRITE))
+    {
+        qCritical() << "Broadcast address 0 can be used only for writes";
+        return false;
+    }
+    job._addresses = _addresses;
+
     if (_debug) // Or use: export QT_LOGGING_RULES="qt.modbus* = true"
         QLoggingCategory::setFilterRules(QStringLiteral("qt.modbus* = true"));
 
-	_client.reset(new Modbus_Cli::Client{_parser.positionalArguments().front(), timeout, number_of_retries, _quiet});
-    QObject::connect(_client.get(), &Modbus_Cli::Client::connected, this, &Worker::on_connected);
-    QObject::connect(_client.get(), &Modbus_Cli::Client::finished, this, &Worker::on_request_finished);
+    if (is_set(OT_STATS))
+    {
+        _stats_signal.reset(new Unix_Signal{SIGUSR1});
+        QObject::connect(_stats_signal.get(), &Unix_Signal::activated, &Stats::print_summary);
+        QObject::connect(qApp, &QCoreApplication::aboutToQuit, &Stats::print_summary);
+    }
 
-    return _client->connect_device();
-}
+    const int stats_interval = option(OT_STATS_INTERVAL).toInt();
+    if (stats_interval > 0)
+    {
+        QObject::connect(&_stats_timer, &QTimer::timeout, &Stats::print_summary);
+        _stats_timer.start(stats_interval * 1000);
+    }
 
-void Worker::on_connected()
-{
-    doit();
-}
+    if (is_set(OT_METRICS))
+    {
+        _metrics.reset(new Metrics_Server);
+        if (!_metrics->listen(option(OT_METRICS)))
+            return false;
+    }
 
-void Worker::on_request_finished()
-{
-    if (_repeat == -1 || _repeat-- > 0)
+    if (is_set(OT_REPLAY))
+    {
+        _replay.reset(new Traffic_Replay{endpoints.front(), job, option(OT_REPLAY), option(OT_SPEED).toDouble()});
+        QObject::connect(_replay.get(), &Traffic_Replay::done, qApp, &QCoreApplication::quit, Qt::QueuedConnection);
+        if (!_replay->start())
+            return false;
+    }
+    else if (is_set(OT_BATCH))
+    {
+        _batch.reset(new Batch_Runner{endpoints.front(), job, option(OT_BATCH)});
+        QObject::connect(_batch.get(), &Batch_Runner::done, qApp, &QCoreApplication::quit, Qt::QueuedConnection);
+        if (!_batch->start())
+            return false;
+    }
+    else if (is_set(OT_DISCOVER_MAP))
     {
-        if (!_client->connect_device())
-            qApp->quit();
+        QVector<QModbusDataUnit::RegisterType> types;
+        if (is_set(OT_REGISTER_TYPE))
+            types.push_back(_type);
+        else
+            types = { QModbusDataUnit::Coils, QModbusDataUnit::DiscreteInputs,
+                      QModbusDataUnit::InputRegisters, QModbusDataUnit::HoldingRegisters };
+
+        _map_discovery.reset(new Map_Discovery{endpoints.front(), job, _addresses.front(), types, _start,
+                                               is_set(OT_COUNT) ? _count : 0x10000 - _start, option(OT_DISCOVER_MAP)});
+        QObject::connect(_map_discovery.get(), &Map_Discovery::done, qApp, &QCoreApplication::quit, Qt::QueuedConnection);
+        _map_discovery->start();
+    }
+    else if (is_set(OT_UPLOAD))
+    {
+        _upload.reset(new Bulk_Writer{endpoints.front(), job, option(OT_UPLOAD), _addresses.front(), _type, _start,
+                                      is_set(OT_COMPARE), is_set(OT_VERIFY)});
+        QObject::connect(_upload.get(), &Bulk_Writer::done, qApp, &QCoreApplication::exit, Qt::QueuedConnection);
+        if (!_upload->start())
+            return false;
+    }
+    else if (is_set(OT_DAEMON))
+    {
+        _daemon.reset(new Cache_Daemon{endpoints.front(), job, option(OT_DAEMON), option(OT_MAX_AGE).toLongLong()});
+        if (!_daemon->start())
+            return false;
+    }
+    else if (is_set(OT_GATEWAY))
+    {
+        const int max_queue = option(OT_MAX_QUEUE).toInt();
+        if (max_queue <= 0)
+        {
+            qCritical() << "--max_queue must be positive";
+            return false;
+        }
+        _gateway.reset(new Tcp_Gateway{endpoints.front(), job, option(OT_MAX_AGE).toLongLong(), max_queue});
+        if (!_gateway->start(option(OT_GATEWAY)))
+            return false;
+    }
+    else if (endpoints.size() == 1)
+    {
+        _session.reset(new Session{endpoints.front(), job});
+        QObject::connect(_session.get(), &Session::done, qApp, &QCoreApplication::quit, Qt::QueuedConnection);
+        _session->start();
     }
     else
-        qApp->quit();
+    {
+        int thread_count = option(OT_THREADS).toInt();
+        if (thread_count <= 0)
+            thread_count = QThread::idealThreadCount();
+
+        // Settings of one serial port are tried in turn
+        int max_parallel = option(OT_PARALLEL).toInt();
+        if (discover && endpoints.front().startsWith("rtu", Qt::CaseInsensitive))
+            thread_count = max_parallel = 1;
+
+        _fan_out.reset(new Fan_Out{endpoints, job, thread_count, max_parallel});
+        QObject::connect(_fan_out.get(), &Fan_Out::done, qApp, &QCoreApplication::quit, Qt::QueuedConnection);
+        _fan_out->start();
+    }
+    return true;
 }
 
-void Worker::doit()
+bool Worker::make_request(Request &request)
 {
     if (is_set(OT_READ))
-        _client->read(_adr, _type, _start, _count);
+        request = Request::read(_addresses.front(), _type, _start, _count);
     else if (is_set(OT_WRITE))
-        _client->write(_adr, _type, _start, get_values(option(OT_WRITE)));
+        request = Request::write(_addresses.front(), _type, _start, get_values(option(OT_WRITE)));
     else if (is_set(OT_READWRITE))
-        _client->readwrite(_adr, _type, _start, _count, get_values(option(OT_WRITE)));
+        request = Request::read_write(_addresses.front(), _type, _start, _count, get_values(option(OT_WRITE)));
     else if (is_set(OT_RAW) && (is_set(OT_FUNC) || is_set(OT_FUNC_HEX)))
     {
         QString func_str = option(is_set(OT_FUNC) ? OT_FUNC : OT_FUNC_HEX);
@@ -120,13 +453,30 @@ void Worker::doit()
         QModbusPdu::FunctionCode func_code = static_cast<QModbusPdu::FunctionCode>(func_d);
 
         QByteArray data = QByteArray::fromHex(option(OT_RAW).toLocal8Bit());
-        _client->write(_adr, func_code, data);
+        request = Request::raw(_addresses.front(), func_code, data);
     }
     else
+        return false;
+    return true;
+}
+
+bool Worker::read_endpoints(const QString &file_name, QStringList &endpoints)
+{
+    QFile file(file_name);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
     {
-		qCritical() << _parser.helpText().constData();
-        qApp->exit(1);
+        qCritical().noquote() << "Can't open hosts file" << file_name << file.errorString();
+        return false;
+    }
+
+    QTextStream stream(&file);
+    while (!stream.atEnd())
+    {
+        const QString line = stream.readLine().trimmed();
+        if (!line.isEmpty() && !line.startsWith('#'))
+            endpoints.push_back(line);
     }
+    return true;
 }
 
 bool Worker::is_set(int key)
@@ -139,15 +489,25 @@ QString Worker::option(int key)
     return _parser.value(_opt.at(key));
 }
 
-QModbusDataUnit::RegisterType Worker::get_type(QString text)
+bool Worker::parse_addresses(const QString &text)
 {
-    text = text.toLower();
-    if (text == "discrete") return QModbusDataUnit::DiscreteInputs;
-    else if (text == "coils") return QModbusDataUnit::Coils;
-    else if (text == "input_register") return QModbusDataUnit::InputRegisters;
-    else if (text == "holding_register") return QModbusDataUnit::HoldingRegisters;
+    _addresses.clear();
+    for (const QString& item: text.split(','))
+    {
+        if (item.isEmpty())
+            continue;
+        const int sep = item.indexOf('-');
+        bool ok;
+        const int first = item.left(sep).toInt(&ok);
+        const int last = ok && sep != -1 ? item.mid(sep + 1).toInt(&ok) : first;
+        if (!ok || first < 0 || last < first || last > 255)
+            return false;
 
-    return static_cast<QModbusDataUnit::RegisterType>(text.toInt());
+        for (int address = first; address <= last; ++address)
+            if (!_addresses.contains(address))
+                _addresses.push_back(address);
+    }
+    return !_addresses.isEmpty();
 }
 
 QVector<quint16> Worker::get_values(const QString &text)
@@ -5,7 +5,16 @@
 #include <QCommandLineParser>
 
 
-#include "client.h"
+#include "batch_runner.h"
+#include "bulk_writer.h"
+#include "cache_daemon.h"
+#include "fan_out.h"
+#include "map_discovery.h"
+#include "metrics_server.h"
+#include "session.h"
+#include "tcp_gateway.h"
+#include "traffic_replay.h"
+#include "unix_signal.h"
 
 namespace Modbus_Cli {
 
@@ -17,27 +26,43 @@ public:
 
     bool process(const QStringList& args);
 signals:
-private slots:
-    void on_connected();
-    void on_request_finished();
 private:
-    void doit();
+    bool make_request(Request& request);
+    bool read_endpoints(const QString& file_name, QStringList& endpoints);
 
     bool is_set(int key);
     QString option(int key);
 
-    QModbusDataUnit::RegisterType get_type(QString text);
     QVector<quint16> get_values(const QString& text);
+    bool parse_addresses(const QString& text);
 
     bool _debug = false;
 	bool _quiet = false;
-    int _adr, _start, _count, _repeat, _timeout;
+    QVector<int> _addresses;
+    int _start, _count;
     QModbusDataUnit::RegisterType _type;
 
     QCommandLineParser _parser;
     QList<QCommandLineOption> _opt;
 
-    std::unique_ptr<Client> _client;
+    static const int flush_interval_ms = 100;
+    std::unique_ptr<Output_Writer> _writer;
+    std::unique_ptr<Register_Image> _image;
+    std::unique_ptr<Value_Decoder> _decoder;
+    std::unique_ptr<Traffic_Capture> _capture;
+    QTimer _flush_timer;
+
+    std::unique_ptr<Session> _session;
+    std::unique_ptr<Fan_Out> _fan_out;
+    std::unique_ptr<Batch_Runner> _batch;
+    std::unique_ptr<Cache_Daemon> _daemon;
+    std::unique_ptr<Tcp_Gateway> _gateway;
+    std::unique_ptr<Bulk_Writer> _upload;
+    std::unique_ptr<Map_Discovery> _map_discovery;
+    std::unique_ptr<Traffic_Replay> _replay;
+    std::unique_ptr<Unix_Signal> _stats_signal;
+    QTimer _stats_timer;
+    std::unique_ptr<Metrics_Server> _metrics;
 };
 
 } // namespace Modbus_Cli